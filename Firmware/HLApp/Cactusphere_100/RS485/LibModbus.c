@@ -35,6 +35,7 @@
 
 #include "ModbusDev.h"
 #include "ModbusDevConfig.h"
+#include "ModbusSnapshot.h"
 
 #include "vector.h"
 
@@ -42,26 +43,48 @@ const char ModbusDevConfigKey[] = "ModbusDevConfig";
 const char BaudrateKey[] = "baudrate";
 const char ParityBitKey[] = "parity";
 const char StopBitKey[] = "stop";
+const char ReadGapKey[] = "readGap";
+const char CacheTtlKey[] = "cacheTtl";
 
 #define MIN_BAUDRATE 1200
 #define MAX_BAUDRATE 125200
+#define MAX_CACHE_TTL 3600000  // [msec]
 
 static const char ModbusParityKey[PARITY_NUM][5] = {
     "None", "Odd", "Even"
 };
 
 static vector sModbusVec = NULL;
+static ModbusSnapshot* sSnapshot = NULL;  // latest values read from the slaves
+
+// queued write of the bus arbiter
+typedef struct ModbusWriteJob {
+    int devID;
+    int regAddr;
+    int funcCode;
+    int count;
+    int priority;
+    unsigned short* values;
+    ModbusWriteCallback callback;
+    void* context;
+} ModbusWriteJob;
+
+static vector sWriteQueue = NULL;  // vector of ModbusWriteJob, by priority
+static ModbusWriteJob sWriteJob;    // write in progress
+static bool sIsWriting = false;
 
 // Add ModbusDev 
-static void Libmodbus_AddModbusDev(int devID, int boud, uint8_t parity, uint8_t stop) {
+static void Libmodbus_AddModbusDev(int devID, int boud, uint8_t parity, uint8_t stop,
+    uint32_t readGap, uint32_t cacheTtlMs) {
     ModbusDev* modbusDev;
-    modbusDev = ModbusDev_NewModbusRTU(devID, boud, parity, stop);
+    modbusDev = ModbusDev_NewModbusRTU(devID, boud, parity, stop, readGap, cacheTtlMs);
     vector_add_last(sModbusVec, modbusDev);
 }
 
 // Initialization
 void Libmodbus_ModbusDevInitialize(void) {
     sModbusVec = ModbusDev_Initialize();
+    sSnapshot = ModbusSnapshot_New();
 }
 
 // Destroy
@@ -71,6 +94,21 @@ void Libmodbus_ModbusDevDestroy(void) {
         ModbusDev_Destroy(sModbusVec);
         vector_destroy(sModbusVec);
     }
+    if (sSnapshot != NULL) {
+        ModbusSnapshot_Destroy(sSnapshot);
+        sSnapshot = NULL;
+    }
+    if (sWriteQueue != NULL) {
+        ModbusWriteJob job;
+
+        while (! vector_is_empty(sWriteQueue)) {
+            vector_get_first(&job, sWriteQueue);
+            vector_remove_first(sWriteQueue);
+            free(job.values);
+        }
+        vector_destroy(sWriteQueue);
+        sWriteQueue = NULL;
+    }
 }
 
 // Clear
@@ -78,6 +116,9 @@ void Libmodbus_ModbusDevClear(void) {
     if (sModbusVec != NULL) {
         vector_clear(sModbusVec);
     }
+    if (sSnapshot != NULL) {
+        ModbusSnapshot_Clear(sSnapshot);
+    }
 }
 
 // Regist
@@ -102,6 +143,8 @@ bool Libmodbus_LoadFromJSON(const json_value* json) {
         int baudrate = 0;
         uint8_t parity = 0;
         uint8_t stop = 1;
+        uint32_t readGap = 0;
+        uint32_t cacheTtlMs = 0;
         char *e;
         json_value* configItem = configJson->u.object.values[i].value;
 
@@ -138,13 +181,29 @@ bool Libmodbus_LoadFromJSON(const json_value* json) {
                         stop = (uint8_t)value;
                     }
                 }
+            } else if (0 == strcmp(configItem->u.object.values[p].name, ReadGapKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+                uint32_t value;
+
+                if (json_GetNumericValue(item, &value, 10)
+                && value < MODBUS_MAX_READ_REGISTERS) {
+                    readGap = value;
+                }
+            } else if (0 == strcmp(configItem->u.object.values[p].name, CacheTtlKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+                uint32_t value;
+
+                if (json_GetNumericValue(item, &value, 10)
+                && value <= MAX_CACHE_TTL) {
+                    cacheTtlMs = value;
+                }
             }
         }
 
         if (baudrate < MIN_BAUDRATE || baudrate > MAX_BAUDRATE) {
             ret = false;
         } else {
-            Libmodbus_AddModbusDev(devId, baudrate, parity, stop);
+            Libmodbus_AddModbusDev(devId, baudrate, parity, stop, readGap, cacheTtlMs);
         }
     }
 
@@ -152,28 +211,233 @@ end:
     return ret;
 }
 
-ModbusDev* Libmodbus_GetAndConnectLib(int devID) {
+ModbusDev* Libmodbus_GetLib(int devID) {
+    return ModbusDev_GetModbusDev(devID, sModbusVec);
+}
+
+// UART line parameters
+uint32_t Libmodbus_GetLineKey(int devID) {
     ModbusDev* modbusDevP = ModbusDev_GetModbusDev(devID, sModbusVec);
 
+    return (modbusDevP != NULL) ? ModbusDev_GetLineKey(modbusDevP) : 0;
+}
+
+uint32_t Libmodbus_GetCurrentLineKey(void) {
+    return ModbusDev_GetCurrentLineKey();
+}
+
+uint32_t Libmodbus_GetLineReconfigCount(void) {
+    return ModbusDev_GetLineReconfigCount();
+}
+
+int Libmodbus_ReadCachedRegisters(ModbusDev* me, ModbusReadRequest* reqs, int count) {
+    int devID = ModbusDev_GetDevID(me);
+    uint32_t ttlMs = ModbusDev_GetCacheTtl(me);
+    int answered = 0;
+
+    for (int i = 0; i < count; i++) {
+        reqs[i].cached = ttlMs != 0
+            && Libmodbus_ReadSnapshot(devID, reqs[i].regAddr, reqs[i].function,
+                reqs[i].dst, reqs[i].length, ttlMs);
+        if (reqs[i].cached) {
+            reqs[i].result = true;
+            reqs[i].exception = 0;
+            reqs[i].answered = true;
+            reqs[i].elapsedMs = 0;
+            answered++;
+        }
+    }
+
+    return answered;
+}
+bool Libmodbus_ReadRegistersAsync(ModbusDev* me, ModbusReadRequest* reqs, int count,
+    ModbusReadCallback callback, void* context) {
+    return ModbusDev_ReadRegistersAsync(me, reqs, count, callback, context);
+}
+
+// Register snapshot
+void Libmodbus_UpdateSnapshot(int devID, const ModbusReadRequest* reqs, int count, uint32_t ageMs) {
+    if (sSnapshot == NULL) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        if (! reqs[i].cached) {
+            ModbusSnapshot_Update(sSnapshot, devID, &reqs[i], ageMs);
+        }
+    }
+}
+
+bool Libmodbus_ReadSnapshot(int devID, int regAddr, int funcCode,
+    unsigned short* dst, int length, uint32_t maxAgeMs) {
+    return sSnapshot != NULL
+        && ModbusSnapshot_Read(sSnapshot, devID, funcCode, regAddr, length, dst, maxAgeMs);
+}
+
+void Libmodbus_InvalidateSnapshot(int devID, int regAddr, int funcCode, int count) {
+    // the value may be changed even if the write failed
+    if (sSnapshot != NULL) {
+        ModbusSnapshot_Invalidate(sSnapshot, devID, funcCode, regAddr, count);
+    }
+}
+
+// Bus arbiter (write queue)
+static void Libmodbus_StartNextWrite(void);
+
+static void Libmodbus_WriteDoneCallback(void* context, bool result, uint8_t exception) {
+    ModbusWriteJob job = sWriteJob;
+    ModbusWriteStatus status = result ? MODBUS_WRITE_SUCCESS
+        : (exception != 0) ? MODBUS_WRITE_EXCEPTION : MODBUS_WRITE_ERROR;
+
+    sIsWriting = false;
+    free(job.values);
+    if (job.callback != NULL) {
+        job.callback(job.context, status, exception);
+    }
+    Libmodbus_StartNextWrite();
+}
+
+static bool Libmodbus_StartWrite(const ModbusWriteJob* job) {
+    // sent ahead of the scan in progress (RTApp stops the scan list
+    // after the current transaction)
+    ModbusDev* modbusDevP = Libmodbus_GetLib(job->devID);
+
     if (modbusDevP == NULL) {
-        return NULL;
+        return false;
     }
+    Libmodbus_InvalidateSnapshot(job->devID, job->regAddr, job->funcCode, job->count);
+    sWriteJob = *job;
+    sIsWriting = ModbusDev_WriteRegistersAsync(modbusDevP, job->regAddr, job->funcCode,
+        job->values, job->count, Libmodbus_WriteDoneCallback, NULL);
+
+    return sIsWriting;
+}
 
-    if (!ModbusDev_Connect(modbusDevP)) {
-        return NULL;
+static void Libmodbus_StartNextWrite(void) {
+    // one write at a time
+    while (! sIsWriting && sWriteQueue != NULL && ! vector_is_empty(sWriteQueue)) {
+        ModbusWriteJob job;
+
+        vector_get_first(&job, sWriteQueue);
+        vector_remove_first(sWriteQueue);
+        if (! Libmodbus_StartWrite(&job)) {
+            free(job.values);
+            if (job.callback != NULL) {
+                job.callback(job.context, (Libmodbus_GetLib(job.devID) == NULL)
+                    ? MODBUS_WRITE_NO_DEVICE : MODBUS_WRITE_ERROR, 0);
+            }
+        }
     }
+}
+
+bool Libmodbus_QueueWrite(int devID, int regAddr, int funcCode,
+    const unsigned short* values, int count, int priority,
+    ModbusWriteCallback callback, void* context) {
+    ModbusWriteJob newJob;
+    const ModbusWriteJob* curs;
+    int index;
 
-    return modbusDevP;
+    if (count < 1) {
+        return false;
+    }
+    if (sWriteQueue == NULL) {
+        sWriteQueue = vector_init(sizeof(ModbusWriteJob));
+        if (sWriteQueue == NULL) {
+            return false;
+        }
+    }
+    newJob.values = (unsigned short*)malloc(sizeof(unsigned short) * (size_t)count);
+    if (newJob.values == NULL) {
+        return false;
+    }
+    memcpy(newJob.values, values, sizeof(unsigned short) * (size_t)count);
+    newJob.devID = devID;
+    newJob.regAddr = regAddr;
+    newJob.funcCode = funcCode;
+    newJob.count = count;
+    newJob.priority = priority;
+    newJob.callback = callback;
+    newJob.context = context;
+
+    if (! sIsWriting && vector_is_empty(sWriteQueue)) {
+        if (! Libmodbus_StartWrite(&newJob)) {
+            free(newJob.values);
+            return false;
+        }
+        return true;
+    }
+
+    // insert after the jobs of the same or higher priority
+    curs = (const ModbusWriteJob*)vector_get_data(sWriteQueue);
+    for (index = 0; index < vector_size(sWriteQueue); index++, curs++) {
+        if (curs->priority < priority) {
+            break;
+        }
+    }
+    if (0 != vector_add_at(sWriteQueue, index, &newJob)) {
+        free(newJob.values);
+        return false;
+    }
+
+    return true;
 }
 
-bool Libmodbus_ReadRegister(ModbusDev* me, int regAddr, int funcCode, unsigned short* dst, int regCount) {
-    return ModbusDev_ReadRegister(me, regAddr, funcCode, dst, regCount);
+// Poll schedule run by RTApp
+void Libmodbus_FillPollEntry(ModbusDev* me, ModbusPollEntry* entry) {
+    ModbusDev_FillPollEntry(me, entry);
+}
+bool Libmodbus_DownloadPollSchedule(const ModbusPollEntry* entries, int count,
+    ModbusPollConfigCallback callback, void* context) {
+    return ModbusDev_DownloadPollSchedule(entries, count, callback, context);
+}
+bool Libmodbus_FetchPollResultsAsync(ModbusPollCallback callback, void* context) {
+    return ModbusDev_FetchPollResultsAsync(callback, context);
 }
-bool Libmodbus_WriteRegister(ModbusDev* me, int regAddr, int funcCode, unsigned short* data) {
-    return ModbusDev_WriteRegister(me, regAddr, funcCode, *data);
+
+// Health of slaves
+bool Libmodbus_IsPollDue(int devID) {
+    ModbusDev* modbusDevP = ModbusDev_GetModbusDev(devID, sModbusVec);
+
+    return modbusDevP != NULL && ModbusDev_IsPollDue(modbusDevP);
+}
+
+void Libmodbus_UpdateHealth(int devID, const ModbusReadRequest* reqs, int count) {
+    // look up again, the slave may be removed while reading asynchronously
+    ModbusDev* modbusDevP = ModbusDev_GetModbusDev(devID, sModbusVec);
+
+    if (modbusDevP != NULL) {
+        ModbusDev_UpdateHealth(modbusDevP, reqs, count);
+    }
+}
+
+void Libmodbus_AppendHealthJSON(StringBuf* sb) {
+    ModbusDev_AppendHealthJSON(sModbusVec, sb);
+}
+
+// Transaction statistics of slaves
+bool Libmodbus_FetchStatsAsync(ModbusStatsCallback callback, void* context) {
+    return ModbusDev_FetchStatsAsync(callback, context);
+}
+
+bool Libmodbus_AddStats(int devID, const ModbusTransStats* stats) {
+    ModbusDev* modbusDevP = ModbusDev_GetModbusDev(devID, sModbusVec);
+
+    if (modbusDevP == NULL) {
+        return false;
+    }
+    ModbusDev_AddStats(modbusDevP, stats);
+    return true;
+}
+
+void Libmodbus_AppendStatsJSON(StringBuf* sb) {
+    ModbusDev_AppendStatsJSON(sModbusVec, sb);
+}
+
+// Get read block gap
+uint32_t Libmodbus_GetReadGap(ModbusDev* me) {
+    return ModbusDev_GetReadGap(me);
 }
 
-// Get RTApp Version
-bool Libmodbus_GetRTAppVersion(char* rtAppVersion) {
-    return ModbusDev_GetRTAppVersion(rtAppVersion);
+// Get RTApp Version asynchronously
+bool Libmodbus_GetRTAppVersionAsync(ModbusVersionCallback callback, void* context) {
+    return ModbusDev_GetRTAppVersionAsync(callback, context);
 }
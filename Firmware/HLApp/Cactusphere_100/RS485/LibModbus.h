@@ -40,14 +40,68 @@ extern void Libmodbus_ModbusDevClear(void);
 // Regist
 extern bool Libmodbus_LoadFromJSON(const json_value* json);
 
-// Connect
-extern ModbusDev* Libmodbus_GetAndConnectLib(int devID);
+// Get ModbusDev* (the line parameters are set by each request)
+extern ModbusDev* Libmodbus_GetLib(int devID);
+
+// UART line parameters (key is 0 if no such slave)
+extern uint32_t Libmodbus_GetLineKey(int devID);
+extern uint32_t Libmodbus_GetCurrentLineKey(void);
+extern uint32_t Libmodbus_GetLineReconfigCount(void);
 
 // Read/Write register
-extern bool Libmodbus_ReadRegister(ModbusDev* me, int regAddr, int funcCode, unsigned short* dst, int regCount);
-extern bool Libmodbus_WriteRegister(ModbusDev* me, int regAddr, int funcCode, unsigned short* data);
+// answer the requests from the snapshot within TTL of the slave (sets cached
+// of all the requests, returns the count of answered requests)
+extern int Libmodbus_ReadCachedRegisters(ModbusDev* me, ModbusReadRequest* reqs, int count);
+extern bool Libmodbus_ReadRegistersAsync(ModbusDev* me, ModbusReadRequest* reqs, int count,
+    ModbusReadCallback callback, void* context);
+
+// Register snapshot (latest values of the reads)
+//   writes discard the overwritten values
+extern void Libmodbus_UpdateSnapshot(int devID, const ModbusReadRequest* reqs, int count, uint32_t ageMs);
+extern bool Libmodbus_ReadSnapshot(int devID, int regAddr, int funcCode,
+    unsigned short* dst, int length, uint32_t maxAgeMs);
+extern void Libmodbus_InvalidateSnapshot(int devID, int regAddr, int funcCode, int count);
+
+// Bus arbiter (write queue)
+//   queued writes are run one by one in order of priority (higher first,
+//   FIFO in the same priority), each write goes ahead of the scan in
+//   progress at the next transaction boundary. callback is called when
+//   the write is done (not called if queueing failed)
+typedef enum {
+    MODBUS_WRITE_SUCCESS = 0,
+    MODBUS_WRITE_ERROR,
+    MODBUS_WRITE_EXCEPTION,
+    MODBUS_WRITE_NO_DEVICE
+} ModbusWriteStatus;
+
+typedef void (*ModbusWriteCallback)(void* context, ModbusWriteStatus status, uint8_t exception);
+
+extern bool Libmodbus_QueueWrite(int devID, int regAddr, int funcCode,
+    const unsigned short* values, int count, int priority,
+    ModbusWriteCallback callback, void* context);
+
+// Poll schedule run by RTApp
+extern void Libmodbus_FillPollEntry(ModbusDev* me, ModbusPollEntry* entry);
+extern bool Libmodbus_DownloadPollSchedule(const ModbusPollEntry* entries, int count,
+    ModbusPollConfigCallback callback, void* context);
+extern bool Libmodbus_FetchPollResultsAsync(ModbusPollCallback callback, void* context);
+
+// Health of slaves
+//   appended as JSON array of the objects of ModbusDevHealth_AppendJSON()
+extern bool Libmodbus_IsPollDue(int devID);
+extern void Libmodbus_UpdateHealth(int devID, const ModbusReadRequest* reqs, int count);
+extern void Libmodbus_AppendHealthJSON(StringBuf* sb);
+
+// Transaction statistics of slaves (measured by RTApp)
+//   adding returns false if the slave is not configured
+extern bool Libmodbus_FetchStatsAsync(ModbusStatsCallback callback, void* context);
+extern bool Libmodbus_AddStats(int devID, const ModbusTransStats* stats);
+extern void Libmodbus_AppendStatsJSON(StringBuf* sb);
+
+// Get read block gap
+extern uint32_t Libmodbus_GetReadGap(ModbusDev* me);
 
-// Get RTApp Version
-extern bool Libmodbus_GetRTAppVersion(char* rtAppVersion);
+// Get RTApp Version asynchronously
+extern bool Libmodbus_GetRTAppVersionAsync(ModbusVersionCallback callback, void* context);
 
 #endif  // _LIBMODBUS_H_
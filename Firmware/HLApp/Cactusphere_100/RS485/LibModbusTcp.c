@@ -39,14 +39,20 @@
 
 const char ModbusTcpConfigKey[] = "ModbusTcpConfig";
 extern const char PortKey[];
+static const char WindowKey[] = "window";
+static const char TimeoutKey[] = "timeout";
 
 static vector sModbusTcpVec = NULL;
 
 // Add ModbusTcpDev
-static void LibmodbusTcp_AddModbusDev(char* ip, int port) {
+static void LibmodbusTcp_AddModbusDev(char* ip, int port, int window, uint32_t timeoutMs) {
     ModbusTcpDev* modbusDev;
-    modbusDev = ModbusTcpDev_NewModbusTCP(ip, port);
+    modbusDev = ModbusTcpDev_NewModbusTCP(ip, port, window, timeoutMs);
+    if (modbusDev == NULL) {
+        return;
+    }
     vector_add_last(sModbusTcpVec, modbusDev);
+    free(modbusDev);  // copied into the vector
 }
 
 // Initialization
@@ -58,14 +64,15 @@ void LibmodbusTcp_ModbusDevInitialize(void) {
 void LibmodbusTcp_ModbusDevDestroy(void) {
     if (sModbusTcpVec != NULL) {
         LibmodbusTcp_ModbusDevClear();
-        ModbusTcpDev_Destroy(sModbusTcpVec);
         vector_destroy(sModbusTcpVec);
+        sModbusTcpVec = NULL;
     }
 }
 
-// Clear
+// Clear (closes the connections)
 void LibmodbusTcp_ModbusDevClear(void) {
     if (sModbusTcpVec != NULL) {
+        ModbusTcpDev_Destroy(sModbusTcpVec);
         vector_clear(sModbusTcpVec);
     }
 }
@@ -82,7 +89,9 @@ bool LibmodbusTcp_LoadFromJSON(const json_value* json) {
 
     for (unsigned int i = 0, n = configJson->u.object.length; i < n; ++i) {
         char ip[16];
-        int port;
+        int port = 0;
+        int window = 1;
+        uint32_t timeoutMs = MODBUS_TCP_DEFAULT_TIMEOUT_MS;
         char* e;
         json_value* configItem = configJson->u.object.values[i].value;
 
@@ -102,18 +111,48 @@ bool LibmodbusTcp_LoadFromJSON(const json_value* json) {
                 else if (item->type == json_string) {
                     port = strtol(item->u.string.ptr, &e, 16);
                 }
-                break;
+            } else if (0 == strcmp(configItem->u.object.values[p].name, WindowKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+                uint32_t value;
+
+                if (! json_GetNumericValue(item, &value, 10)
+                ||  value < 1 || value > MODBUS_TCP_MAX_WINDOW) {
+                    return false;
+                }
+                window = (int)value;
+            } else if (0 == strcmp(configItem->u.object.values[p].name, TimeoutKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+
+                if (! json_GetNumericValue(item, &timeoutMs, 10)
+                ||  timeoutMs < MODBUS_TCP_MIN_TIMEOUT_MS || timeoutMs > MODBUS_TCP_MAX_TIMEOUT_MS) {
+                    return false;
+                }
             }
         }
         if (port == 0) {
             return false;
         }
-        LibmodbusTcp_AddModbusDev(ip, port);
+        LibmodbusTcp_AddModbusDev(ip, port, window, timeoutMs);
     }
 
     return true;
 }
 
+// Read the servers concurrently in the event loop
+bool LibmodbusTcp_RegisterEventLoop(EventLoop* eventLoop) {
+    return ModbusTCP_RegisterEventLoop(eventLoop);
+}
+
+void LibmodbusTcp_UnregisterEventLoop(void) {
+    ModbusTCP_UnregisterEventLoop();
+}
+
+// Get the server (connected by the asynchronous read)
+ModbusTcpDev* LibmodbusTcp_GetModbusDev(char* id) {
+    return ModbusTcpDev_GetModbusDev(id, sModbusTcpVec);
+}
+
+// Get the server connected (the connection is kept in ModbusTcpDev)
 ModbusTcpDev* LibmodbusTcp_GetAndConnectLib(char* id) {
     ModbusTcpDev* modbusDevP = ModbusTcpDev_GetModbusDev(id, sModbusTcpVec);
 
@@ -134,9 +173,29 @@ LibmodbusTcp_Disconnect(ModbusTcpDev* me)
     ModbusTcpDev_Disconnect(me);
 }
 
-bool LibmodbusTcp_ReadRegister(ModbusTcpDev* me, int unitId, int regAddr, unsigned short* dst) {
-    return ModbusTcpDev_ReadSingleRegister(me, unitId, regAddr, dst);
+// Result of the last request
+ModbusTcpError
+LibmodbusTcp_GetLastError(ModbusTcpDev* me)
+{
+    return ModbusTcpDev_GetLastError(me);
+}
+
+int LibmodbusTcp_ReadRegisters(ModbusTcpDev* me, ModbusTcpReadRequest* reqs, int count) {
+    return ModbusTcpDev_ReadRegisters(me, reqs, count);
+}
+
+bool LibmodbusTcp_ReadRegistersAsync(ModbusTcpDev* me, ModbusTcpReadRequest* reqs, int count,
+    ModbusTcpReadCallback callback, void* context) {
+    return ModbusTcpDev_ReadRegistersAsync(me, reqs, count, callback, context);
+}
+
+bool LibmodbusTcp_ReadRegister(ModbusTcpDev* me, int unitId, int regAddr, int funcCode, unsigned short* dst, int regCount) {
+    return ModbusTcpDev_ReadRegister(me, unitId, regAddr, funcCode, dst, regCount);
+}
+bool LibmodbusTcp_WriteRegister(ModbusTcpDev* me, int unitId, int regAddr, int funcCode, unsigned short* data) {
+    return ModbusTcpDev_WriteRegister(me, unitId, regAddr, funcCode, *data);
 }
-bool LibmodbusTcp_WriteRegister(ModbusTcpDev* me, int unitId, int regAddr, unsigned short* data) {
-    return ModbusTcpDev_WriteSingleRegister(me, unitId, regAddr, *data);
+bool LibmodbusTcp_WriteRegisters(ModbusTcpDev* me, int unitId, int regAddr, int funcCode,
+    const unsigned short* values, int count) {
+    return ModbusTcpDev_WriteRegisters(me, unitId, regAddr, funcCode, values, count);
 }
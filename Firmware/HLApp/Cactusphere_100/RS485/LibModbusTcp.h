@@ -37,15 +37,35 @@ extern void LibmodbusTcp_ModbusDevDestroy(void);
 // Clear
 extern void LibmodbusTcp_ModbusDevClear(void);
 
+// Read the servers concurrently in the event loop
+extern bool LibmodbusTcp_RegisterEventLoop(EventLoop* eventLoop);
+extern void LibmodbusTcp_UnregisterEventLoop(void);
+
 // Regist
 extern bool LibmodbusTcp_LoadFromJSON(const json_value* json);
 
 // Connect/Disconnect
+//   connection to each server is kept across the polling cycles and
+//   reconnected lazily (with backoff) if broken
 extern ModbusTcpDev* LibmodbusTcp_GetAndConnectLib(char* id);
+extern ModbusTcpDev* LibmodbusTcp_GetModbusDev(char* id);
 extern void LibmodbusTcp_Disconnect(ModbusTcpDev* me);
 
+// Result of the last request
+//   a connection error (MODBUS_TCP_IS_CONNECTION_ERROR()) has closed the
+//   connection, the next request connects again
+extern ModbusTcpError LibmodbusTcp_GetLastError(ModbusTcpDev* me);
+
 // Read/Write register
-extern bool LibmodbusTcp_ReadRegister(ModbusTcpDev* me, int unitId, int regAddr, unsigned short* dst);
-extern bool LibmodbusTcp_WriteRegister(ModbusTcpDev* me, int unitId, int regAddr, unsigned short* data);
+//   several requests are read pipelined ("window" of the server config),
+//   each fails unless answered within "timeout" [msec] (default 1000),
+//   each reads up to 125 registers (2000 bits) and bits are packed LSB first
+extern int LibmodbusTcp_ReadRegisters(ModbusTcpDev* me, ModbusTcpReadRequest* reqs, int count);
+extern bool LibmodbusTcp_ReadRegistersAsync(ModbusTcpDev* me, ModbusTcpReadRequest* reqs, int count,
+    ModbusTcpReadCallback callback, void* context);
+extern bool LibmodbusTcp_ReadRegister(ModbusTcpDev* me, int unitId, int regAddr, int funcCode, unsigned short* dst, int regCount);
+extern bool LibmodbusTcp_WriteRegister(ModbusTcpDev* me, int unitId, int regAddr, int funcCode, unsigned short* data);
+extern bool LibmodbusTcp_WriteRegisters(ModbusTcpDev* me, int unitId, int regAddr, int funcCode,
+    const unsigned short* values, int count);
 
 #endif  // _LIBMODBUS_H_
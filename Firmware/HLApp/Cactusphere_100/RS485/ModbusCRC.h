@@ -0,0 +1,49 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _MODBUS_CRC_H_
+#define _MODBUS_CRC_H_
+
+#ifndef _STDBOOL_H
+#include <stdbool.h>
+#endif
+#ifndef _STDINT_H
+#include <stdint.h>
+#endif
+
+// CRC-16/Modbus (polynomial 0xA001 reflected, initial value 0xFFFF)
+extern uint16_t	ModbusCRC_Calc(const uint8_t* data, int length);
+
+// Append CRC to the frame (returns length of the frame including CRC)
+extern int	ModbusCRC_Append(uint8_t* frame, int length);
+
+// Check CRC at the tail of the frame (length doesn't include CRC)
+extern bool	ModbusCRC_Check(const uint8_t* frame, int length);
+
+#ifdef MODBUS_CRC_BENCHMARK
+// Compare bit-at-a-time CRC with table-driven one on 256 bytes frames
+extern void	ModbusCRC_Benchmark(void);
+#endif
+
+#endif  // _MODBUS_CRC_H_
@@ -33,7 +33,9 @@
 
 #include "json.h"
 #include "LibModbus.h"
+#include "ModbusDiagnostics.h"
 #include "ModbusFetchConfig.h"
+#include "ModbusTcpServer.h"
 #include "PropertyItems.h"
 
 typedef struct ModbusConfigMgr {
@@ -86,6 +88,8 @@ ModbusConfigMgr_LoadAndApplyIfChanged(const unsigned char* payload,
         if (modbusConfObj->type == json_null) {
             PropertyItems_AddItem(item, "ModbusDevConfig", TYPE_NULL);
             Libmodbus_ModbusDevClear();
+            ModbusTcpServer_LoadFromJSON(NULL);
+            ModbusDiagnostics_LoadFromJSON(NULL);
         } else {
             if (modbusConfObj->type != json_string) {
                 modbusConfObj = json_GetKeyJson("value", modbusConfObj);
@@ -98,6 +102,14 @@ ModbusConfigMgr_LoadAndApplyIfChanged(const unsigned char* payload,
                     Log_Debug("ModbusDevConfig LoadToJsonError!\n");
                     ret = ILLEGAL_PROPERTY;
                 }
+                if (!ModbusTcpServer_LoadFromJSON(modbusConfObj)) {
+                    Log_Debug("ModbusTcpServer config error!\n");
+                    ret = ILLEGAL_PROPERTY;
+                }
+                if (!ModbusDiagnostics_LoadFromJSON(modbusConfObj)) {
+                    Log_Debug("diagInterval config error!\n");
+                    ret = ILLEGAL_PROPERTY;
+                }
             } else {
                 Log_Debug("ModbusDevConfig parse error!\n");
                 ret = ILLEGAL_PROPERTY;
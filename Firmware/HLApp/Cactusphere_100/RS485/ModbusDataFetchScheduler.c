@@ -22,7 +22,12 @@
  * THE SOFTWARE.
  */
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#include <applibs/log.h>
 
 #include "ModbusDataFetchScheduler.h"
 
@@ -30,16 +35,69 @@
 #include "ModbusFetchItem.h"
 #include "ModbusFetchTargets.h"
 #include "ModbusDevConfig.h"
+#include "ModbusPollSchedule.h"
+#include "ModbusReadPlan.h"
+#include "ModbusScanQueue.h"
+#include "LibCloud.h"
 #include "StringBuf.h"
 #include "TelemetryItems.h"
 
 #define  MODBUS_ONESHOT_COMMAND_PARAM_NUM 4
+#define  MODBUS_BATCH_WRITE_MAX          256  // max count of writes in one command
+#define  MODBUS_SCAN_BUDGET_MS           700  // time to start reading slaves in one period
+
+// one write of batched write command
+typedef struct ModbusWriteOp {
+    uint32_t    devID;
+    uint32_t    regAddr;
+    uint32_t    funcCode;
+    uint16_t    data;
+    int         priority;   // priority in the write queue (higher first)
+} ModbusWriteOp;
+
+typedef struct ModbusWriteCommand ModbusWriteCommand;
+
+// writes grouped into one request, and its result
+typedef struct ModbusWriteGroup {
+    ModbusWriteCommand* command;
+    unsigned int        first;  // index of the first ModbusWriteOp
+    unsigned int        count;
+    ModbusWriteStatus   status;
+    uint8_t             exception;
+} ModbusWriteGroup;
+
+// write command in the write queue
+struct ModbusWriteCommand {
+    ModbusWriteGroup*   groups;
+    unsigned int        groupNum;
+    unsigned int        writeNum;   // count of ModbusWriteOp
+    unsigned int        remaining;  // count of groups not done
+    bool                isBatch;    // reports the result of each write
+    ModbusCommandCallback callback;
+};
 
 typedef struct ModbusDataFetchScheduler {
     DataFetchSchedulerBase	Super;
 
     // data member
     ModbusFetchTargets*	mFetchTargets;  // acquisition targets of Modbus RTU
+    ModbusReadPlan*	mReadPlan;          // read blocks of current slave
+    ModbusPollSchedule*	mPollSchedule;  // poll schedule run by RTApp
+    bool	mUsePollSchedule;   // true if RTApp runs mPollSchedule
+    ModbusReportState*	mReportStates;  // reporting state per item (by itemIndex)
+    int 	mReportStateNum;    // count of mReportStates
+
+    // asynchronous acquisition in progress
+    ModbusScanQueue*	mScanQueue; // slaves to be read, in deadline order
+    uint32_t	mScanStartMs;   // start time of current scan (monotonic)
+    unsigned long	mOverrunCount;  // count of scans which exceeded the budget
+    uint32_t	mReconfigBase;  // line reconfiguration count at the last scan end
+    uint32_t	mScanReconfigs; // line reconfigurations since the scan before
+    unsigned long	mCurDevID;  // slave being read
+    ModbusReadRequest*	mReqs;  // read requests of current slave (per block)
+    ModbusReadRequest*	mBusReqs;   // requests not answered from the snapshot
+    unsigned short*	mReadVal;   // read values of current slave
+    bool	mIsCanceled;        // configuration changed while reading
 } ModbusDataFetchScheduler;
 
 //
@@ -55,15 +113,85 @@ ModbusFetchTimerCallback(void* arg, const FetchItemBase* fetchTarget)
         scheduler->mFetchTargets, (const ModbusFetchItem*)fetchTarget);
 }
 
+static uint32_t
+ModbusDataFetchScheduler_GetMonotonicMs(void)
+{
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000 + (uint32_t)(ts.tv_nsec / 1000000);
+}
+
+static void
+ModbusDataFetchScheduler_FreeReadBuffers(ModbusDataFetchScheduler* self)
+{
+    free(self->mReqs);
+    free(self->mReadVal);
+    self->mReqs    = NULL;
+    self->mBusReqs = NULL;
+    self->mReadVal = NULL;
+}
+
 // Virtual method
 static void
 ModbusDataFetchScheduler_DoDestroy(DataFetchSchedulerBase* me)
 {
     ModbusDataFetchScheduler*	self = (ModbusDataFetchScheduler*)me;
 
+    ModbusDataFetchScheduler_FreeReadBuffers(self);
+    free(self->mReportStates);
+    ModbusScanQueue_Destroy(self->mScanQueue);
+    ModbusPollSchedule_Destroy(self->mPollSchedule);
+    ModbusReadPlan_Destroy(self->mReadPlan);
     ModbusFetchTargets_Destroy(self->mFetchTargets);
 }
 
+static void
+ModbusDataFetchScheduler_PollScheduleCallback(void* context, bool result)
+{
+    // read the slaves by HLApp if RTApp does not run the schedule
+    ModbusDataFetchScheduler*	self = (ModbusDataFetchScheduler*)context;
+
+    if (! result && self->mUsePollSchedule) {
+        Log_Debug("WARNING: poll schedule is not accepted by RTApp\n");
+        self->mUsePollSchedule = false;
+        self->Super.mQueueWhilePending = true;
+    }
+}
+
+static void
+ModbusDataFetchScheduler_DoInit(DataFetchSchedulerBase* me, vector fetchItemPtrs)
+{
+    ModbusDataFetchScheduler*	self = (ModbusDataFetchScheduler*)me;
+
+    // configuration changed, request frames of blocks must be rebuilt
+    ModbusReadPlan_ClearFrameCache(self->mReadPlan);
+    if (DataFetchScheduler_IsAsyncPending(me)) {
+        // fetch items being read are no longer valid, discard the results
+        self->mIsCanceled = true;
+    }
+    ModbusScanQueue_Clear(self->mScanQueue);
+
+    // reporting state restarts with new configuration
+    free(self->mReportStates);
+    self->mReportStateNum = 0;
+    self->mReportStates = (ModbusReportState*)calloc(
+        (size_t)vector_size(fetchItemPtrs) + 1, sizeof(ModbusReportState));
+    if (NULL != self->mReportStates) {
+        self->mReportStateNum = vector_size(fetchItemPtrs);
+    }
+
+    // compile and download poll schedule, RTApp polls the slaves by itself
+    // (read by HLApp as before if RTApp does not accept it)
+    ModbusPollSchedule_Build(self->mPollSchedule, fetchItemPtrs);
+    self->mUsePollSchedule = 0 < ModbusPollSchedule_GetBlockCount(self->mPollSchedule);
+    me->mQueueWhilePending = !self->mUsePollSchedule;
+    if (! ModbusPollSchedule_Download(self->mPollSchedule,
+            ModbusDataFetchScheduler_PollScheduleCallback, self)) {
+        ModbusDataFetchScheduler_PollScheduleCallback(self, false);
+    }
+}
+
 static void
 ModbusDataFetchScheduler_ClearFetchTargets(DataFetchSchedulerBase* me)
 {
@@ -72,89 +200,550 @@ ModbusDataFetchScheduler_ClearFetchTargets(DataFetchSchedulerBase* me)
     ModbusFetchTargets_Clear(self->mFetchTargets);
 }
 
+static void
+ModbusDataFetchScheduler_AddTelemetry(ModbusDataFetchScheduler* self,
+    const ModbusFetchItem* item, const unsigned short* readVal, uint32_t timeStamp)
+{
+    // decode the value and check it by reporting policy before formatting
+    DataFetchSchedulerBase* me = &self->Super;
+    ModbusValue	value;
+
+    ModbusDecode_Execute(&item->decode, readVal, &value);
+    if (item->itemIndex < (uint32_t)self->mReportStateNum
+    &&  !ModbusReportState_Check(&self->mReportStates[item->itemIndex],
+            &item->report, &value, timeStamp)) {
+        return;  // suppressed (deadband etc.)
+    }
+    if (value.isFloat) {
+        StringBuf_AppendByPrintf(me->mStringBuf, "%f", value.floatVal);
+    } else if (value.isUnsigned) {
+        StringBuf_AppendByPrintf(me->mStringBuf, "%llu",
+            (unsigned long long)value.intVal);
+    } else {
+        StringBuf_AppendByPrintf(me->mStringBuf, "%lld",
+            (long long)value.intVal);
+    }
+
+    TelemetryItems_Add(me->mTelemetryItems,
+        item->telemetryName, StringBuf_GetStr(me->mStringBuf));
+    StringBuf_Clear(me->mStringBuf);
+}
+
+static bool	ModbusDataFetchScheduler_ReadNextDevice(ModbusDataFetchScheduler* self);
+
+static void
+ModbusDataFetchScheduler_EndScan(ModbusDataFetchScheduler* self)
+{
+    // count UART reprogramming reported by RTApp (with the statistics)
+    // since the last scan, then send the telemetry
+    uint32_t	reconfigCount = Libmodbus_GetLineReconfigCount();
+
+    self->mScanReconfigs = reconfigCount - self->mReconfigBase;
+    self->mReconfigBase = reconfigCount;
+    if (0 < self->mScanReconfigs) {
+        Log_Debug("Modbus scan: %lu line reconfiguration(s)\n",
+            (unsigned long)self->mScanReconfigs);
+    }
+    DataFetchScheduler_EndAsync(&self->Super, true);
+}
+
+static void
+ModbusDataFetchScheduler_AddBlockTelemetry(ModbusDataFetchScheduler* self,
+    const ModbusReadBlock* block, const ModbusFetchItem** items,
+    const ModbusReadRequest* req, uint32_t timeStamp)
+{
+    // slice the result of a read block into the items
+    if (!req->result) {
+        // error!
+        if (req->exception != 0) {
+            for (int k = 0; k < block->itemCount; ++k) {
+                Log_Debug("ERROR: Modbus exception 0x%02x on %s\n",
+                    req->exception,
+                    items[block->itemIndex + k]->telemetryName);
+            }
+        }
+        return;
+    }
+
+    for (int k = 0; k < block->itemCount; ++k) {
+        const ModbusFetchItem* item = items[block->itemIndex + k];
+        uint32_t index = item->regAddr - block->regAddr;
+
+        if (MODBUS_IS_BIT_READ(block->funcCode)) {
+            // unpack a coil/discrete input
+            unsigned short bitVal = (unsigned short)((req->dst[index >> 4] >> (index & 15)) & 1);
+
+            ModbusDataFetchScheduler_AddTelemetry(self, item, &bitVal, timeStamp);
+        } else {
+            ModbusDataFetchScheduler_AddTelemetry(self, item, &req->dst[index], timeStamp);
+        }
+    }
+}
+
+static void
+ModbusDataFetchScheduler_SliceResults(ModbusDataFetchScheduler* self)
+{
+    // slice the results of current slave (mReqs) into the items
+    vector	blocks = ModbusReadPlan_GetBlocks(self->mReadPlan);
+    const ModbusReadBlock* blkCurs = (const ModbusReadBlock*)vector_get_data(blocks);
+    const ModbusFetchItem** items = (const ModbusFetchItem**)vector_get_data(
+        ModbusReadPlan_GetItems(self->mReadPlan));
+    uint32_t timeStamp = IoT_CentralLib_GetTmeStamp();
+
+    for (int j = 0, n = vector_size(blocks); j < n; ++j, ++blkCurs) {
+        ModbusDataFetchScheduler_AddBlockTelemetry(self, blkCurs, items,
+            &self->mReqs[j], timeStamp);
+    }
+    ModbusDataFetchScheduler_FreeReadBuffers(self);
+}
+
+static void
+ModbusDataFetchScheduler_ReadCallback(void* context,
+    ModbusReadRequest* reqs, int count, int succeeded)
+{
+    // put the results back to the blocks, slice them into the items,
+    // then read next slave
+    ModbusDataFetchScheduler* self = (ModbusDataFetchScheduler*)context;
+    DataFetchSchedulerBase* me = &self->Super;
+    int k = 0;
+
+    if (self->mIsCanceled) {
+        ModbusDataFetchScheduler_FreeReadBuffers(self);
+        self->mIsCanceled = false;
+        DataFetchScheduler_EndAsync(me, false);
+        return;
+    }
+    Libmodbus_UpdateHealth((int)self->mCurDevID, reqs, count);
+    Libmodbus_UpdateSnapshot((int)self->mCurDevID, reqs, count, 0);
+
+    for (int j = 0, n = vector_size(ModbusReadPlan_GetBlocks(self->mReadPlan));
+            j < n && k < count; ++j) {
+        if (! self->mReqs[j].cached) {
+            self->mReqs[j] = reqs[k++];
+        }
+    }
+    ModbusDataFetchScheduler_SliceResults(self);
+
+    if (! ModbusDataFetchScheduler_ReadNextDevice(self)) {
+        ModbusDataFetchScheduler_EndScan(self);
+    }
+}
+
+static bool
+ModbusDataFetchScheduler_ReadNextDevice(ModbusDataFetchScheduler* self)
+{
+    // start reading the slave of the earliest deadline (returns false
+    // if no more slave, or the budget of this period is used up; the
+    // rest is carried over to the next period)
+    const ModbusScanJob*	job;
+
+    while (NULL != (job = ModbusScanQueue_Peek(self->mScanQueue))) {
+        unsigned long	devID = job->devID;
+        uint32_t	now = ModbusDataFetchScheduler_GetMonotonicMs();
+        vector	blocks;
+        const ModbusReadBlock* blkCurs;
+        int blockNum;
+
+        int busNum = 0;
+
+        ModbusDev* modbusdev;
+
+        if (now - self->mScanStartMs >= MODBUS_SCAN_BUDGET_MS) {
+            self->mOverrunCount++;
+            Log_Debug("WARNING: Modbus scan overrun #%lu, %d slave(s) carried over"
+                " (oldest %lu[ms] late)\n", self->mOverrunCount,
+                ModbusScanQueue_Count(self->mScanQueue),
+                (unsigned long)(now - job->dueTimeMs));
+            return false;
+        }
+        if (!Libmodbus_IsPollDue((int)devID)) {
+            ModbusScanQueue_Pop(self->mScanQueue);
+            continue;  // backed off (not responding)
+        }
+        // connected by the scan list (not blocking in the callback of RTApp)
+        modbusdev = Libmodbus_GetLib((int)devID);
+        if (modbusdev == NULL) {
+            ModbusScanQueue_Pop(self->mScanQueue);
+            continue;
+        }
+
+        // coalesce the items into read blocks, read all the blocks
+        // by scan list and slice the results into the items on completion
+        ModbusReadPlan_Build(self->mReadPlan, job->fetchItems,
+            Libmodbus_GetReadGap(modbusdev));
+        ModbusScanQueue_Pop(self->mScanQueue);
+        blocks = ModbusReadPlan_GetBlocks(self->mReadPlan);
+        blockNum = vector_size(blocks);
+        if (blockNum == 0) {
+            continue;
+        }
+
+        self->mReqs = (ModbusReadRequest*)malloc(sizeof(ModbusReadRequest) * (size_t)blockNum * 2);
+        self->mReadVal = (unsigned short*)calloc((size_t)blockNum * MODBUS_MAX_READ_REGISTERS, sizeof(unsigned short));
+        if (self->mReqs == NULL || self->mReadVal == NULL) {
+            ModbusDataFetchScheduler_FreeReadBuffers(self);
+            continue;
+        }
+        blkCurs = (const ModbusReadBlock*)vector_get_data(blocks);
+        for (int j = 0; j < blockNum; ++j, ++blkCurs) {
+            self->mReqs[j].regAddr  = (int)blkCurs->regAddr;
+            self->mReqs[j].function = (int)blkCurs->funcCode;
+            self->mReqs[j].length   = (int)blkCurs->regCount;
+            self->mReqs[j].dst      = &self->mReadVal[j * MODBUS_MAX_READ_REGISTERS];
+            self->mReqs[j].frame    = blkCurs->reqFrame;
+            self->mReqs[j].result   = false;
+        }
+
+        // read only the blocks not in the snapshot (within TTL of the slave)
+        if (blockNum == Libmodbus_ReadCachedRegisters(modbusdev, self->mReqs, blockNum)) {
+            ModbusDataFetchScheduler_SliceResults(self);
+            continue;
+        }
+        self->mBusReqs = &self->mReqs[blockNum];
+        for (int j = 0; j < blockNum; ++j) {
+            if (! self->mReqs[j].cached) {
+                self->mBusReqs[busNum++] = self->mReqs[j];
+            }
+        }
+
+        self->mCurDevID = devID;
+        if (Libmodbus_ReadRegistersAsync(modbusdev, self->mBusReqs, busNum,
+                ModbusDataFetchScheduler_ReadCallback, self)) {
+            return true;
+        }
+        ModbusDataFetchScheduler_FreeReadBuffers(self);
+    }
+
+    return false;
+}
+
+static void
+ModbusDataFetchScheduler_PollCallback(void* context,
+    ModbusPollResult* results, int count, bool hasMore)
+{
+    // slice the results of poll schedule into the items, the items
+    // acquired in the same second are sent as one telemetry
+    ModbusDataFetchScheduler* self = (ModbusDataFetchScheduler*)context;
+    DataFetchSchedulerBase* me = &self->Super;
+    const ModbusFetchItem** items = ModbusPollSchedule_GetItems(self->mPollSchedule);
+    uint32_t now = IoT_CentralLib_GetTmeStamp();
+    uint32_t timeStamp = now;
+
+    if (self->mIsCanceled) {
+        self->mIsCanceled = false;
+        DataFetchScheduler_EndAsync(me, false);
+        return;
+    }
+    for (int i = 0; i < count; ++i) {
+        const ModbusPollBlock* pollBlock =
+            ModbusPollSchedule_GetBlock(self->mPollSchedule, results[i].entryIndex);
+        uint32_t sampleTime = now - (results[i].ageMs + 500) / 1000;
+
+        if (pollBlock == NULL) {
+            continue;
+        }
+        Libmodbus_UpdateHealth((int)pollBlock->devID, &results[i].req, 1);
+        Libmodbus_UpdateSnapshot((int)pollBlock->devID, &results[i].req, 1,
+            results[i].ageMs);
+
+        if (sampleTime != timeStamp
+        &&  0 < TelemetryItems_Count(me->mTelemetryItems)) {
+            DataFetchScheduler_SendTelemetryAt(me, timeStamp);
+        }
+        timeStamp = sampleTime;
+        ModbusDataFetchScheduler_AddBlockTelemetry(self, &pollBlock->block, items,
+            &results[i].req, sampleTime);
+    }
+    if (0 < TelemetryItems_Count(me->mTelemetryItems)) {
+        DataFetchScheduler_SendTelemetryAt(me, timeStamp);
+    }
+
+    // take out the rest
+    if (hasMore
+    &&  Libmodbus_FetchPollResultsAsync(ModbusDataFetchScheduler_PollCallback, self)) {
+        return;
+    }
+    DataFetchScheduler_EndAsync(me, true);
+}
+
+static void
+ModbusDataFetchScheduler_DoQueue(DataFetchSchedulerBase* me)
+{
+    // keep the slaves due while the previous scan is in progress
+    ModbusDataFetchScheduler* self = (ModbusDataFetchScheduler*)me;
+
+    ModbusScanQueue_Merge(self->mScanQueue, self->mFetchTargets,
+        ModbusDataFetchScheduler_GetMonotonicMs());
+}
+
 static void
 ModbusDataFetchScheduler_DoSchedule(DataFetchSchedulerBase* me)
 {
+    // take out the results of poll schedule run by RTApp, or
+    // read the slaves one by one in event loop, the telemetry is
+    // sent when all the slaves are read
     ModbusDataFetchScheduler* self = (ModbusDataFetchScheduler*)me;
-    vector	devIDs;
 
-    devIDs = ModbusFetchTargets_GetDevIDs(self->mFetchTargets);
-    if (!vector_is_empty(devIDs)) {
-        unsigned long* devIDCurs = (unsigned long*)vector_get_data(devIDs);
+    if (self->mUsePollSchedule) {
+        DataFetchScheduler_BeginAsync(me);
+        if (! Libmodbus_FetchPollResultsAsync(ModbusDataFetchScheduler_PollCallback, self)) {
+            DataFetchScheduler_EndAsync(me, true);
+        }
+        return;
+    }
+
+    self->mScanStartMs = ModbusDataFetchScheduler_GetMonotonicMs();
+    ModbusScanQueue_Merge(self->mScanQueue, self->mFetchTargets,
+        self->mScanStartMs);
+    if (0 == ModbusScanQueue_Count(self->mScanQueue)) {
+        return;
+    }
+    self->mIsCanceled = false;
+    DataFetchScheduler_BeginAsync(me);
+    if (! ModbusDataFetchScheduler_ReadNextDevice(self)) {
+        ModbusDataFetchScheduler_EndScan(self);
+    }
+}
 
-        for (int i = 0, n = vector_size(devIDs); i < n; i++) {
-            unsigned long	devID = *devIDCurs++;
-            vector	fetchItems = ModbusFetchTargets_GetFetchItems(
-                self->mFetchTargets, devID);
-            const ModbusFetchItem** fiCurs =
-                (const ModbusFetchItem**)vector_get_data(fetchItems);
+static const char*
+ModbusBatchWrite_ParseOp(const json_value* opJson, ModbusWriteOp* op)
+{
+    // returns error message, or NULL if succeeded
+    bool hasDevID = false, hasRegAddr = false, hasFuncCode = false, hasData = false;
 
-            ModbusDev* modbusdev = Libmodbus_GetAndConnectLib((int)devID);
+    op->priority = 0;
 
-            if (modbusdev == NULL) {
-                continue;
+    if (opJson->type != json_object) {
+        return "Illegal config";
+    }
+    for (unsigned int i = 0, n = opJson->u.object.length; i < n; ++i) {
+        const char* name = opJson->u.object.values[i].name;
+        json_value* item = opJson->u.object.values[i].value;
+        uint32_t value;
+
+        if (0 == strcmp(name, "devID")) {
+            if (!json_GetNumericValue(item, &op->devID, 16) || op->devID == 0) {
+                return "Illegal devID";
             }
-
-            for (int j = 0, m = vector_size(fetchItems); j < m; ++j) {
-                const ModbusFetchItem* item = *fiCurs++;
-                unsigned short readVal[2] = { 0 };
-
-                if (!Libmodbus_ReadRegister(modbusdev, (int)item->regAddr, (int)item->funcCode, readVal, (int)item->regCount)) {
-                    // error!
-                    continue;
-                }
-
-                unsigned long tmpVal  = 0;
-                if (item->regCount == 2) {
-                    if (item->asLittle) {
-                        // Little endian
-                        tmpVal = (unsigned long)((readVal[1] << 16) + readVal[0]);
-                    } else {
-                        // Big endian
-                        tmpVal = (unsigned long)((readVal[0] << 16) + readVal[1]);
-                    }
-                } else {
-                    tmpVal = readVal[0];
-                }
-
-                if (item->asFloat) {
-                    double fVal = tmpVal;
-
-                    fVal += item->offset;
-                    if (item->multiplier != 0) {
-                        fVal *= item->multiplier;
-                    }
-                    if (item->devider != 0) {
-                        fVal /= item->devider;
-                    }
-                    StringBuf_AppendByPrintf(me->mStringBuf, "%f", fVal);
-                } else {
-                    unsigned long ulVal = tmpVal;
-
-                    ulVal += item->offset;
-                    if (item->multiplier != 0) {
-                        ulVal *= item->multiplier;
-                    }
-                    if (item->devider != 0) {
-                        ulVal /= item->devider;
-                    }
-
-                    StringBuf_AppendByPrintf(me->mStringBuf, "%ld", ulVal);
-                }
-
-                TelemetryItems_Add(me->mTelemetryItems,
-                    item->telemetryName, StringBuf_GetStr(me->mStringBuf));
-                StringBuf_Clear(me->mStringBuf);
+            hasDevID = true;
+        } else if (0 == strcmp(name, "registerAddr")) {
+            if (!json_GetNumericValue(item, &op->regAddr, 16)) {
+                return "Illegal regAddr";
+            }
+            hasRegAddr = true;
+        } else if (0 == strcmp(name, "funcCode")) {
+            if (!json_GetNumericValue(item, &op->funcCode, 16)) {
+                return "Illegal funcCode";
+            }
+            hasFuncCode = true;
+        } else if (0 == strcmp(name, "data")) {
+            if (!json_GetNumericValue(item, &value, 16)) {
+                return "Illegal data";
             }
+            op->data = (uint16_t)value;
+            hasData = true;
+        } else if (0 == strcmp(name, "priority")) {
+            if (!json_GetNumericValue(item, &value, 10)) {
+                return "Illegal priority";
+            }
+            op->priority = (int)value;
+        }
+    }
+    if (!(hasDevID && hasRegAddr && hasFuncCode && hasData)) {
+        return "Illegal config";
+    }
+    switch (op->funcCode) {
+    case FC_WRITE_FORCE_SINGLE_COIL:
+    case FC_WRITE_SINGLE_REGISTER:
+    case FC_WRITE_MULTIPLE_COILS:
+    case FC_WRITE_MULTIPLE_REGISTERS:
+        return NULL;
+    default:
+        return "Illegal funcCode";
+    }
+}
+
+static bool
+ModbusBatchWrite_IsCoil(const ModbusWriteOp* op)
+{
+    return op->funcCode == FC_WRITE_FORCE_SINGLE_COIL
+        || op->funcCode == FC_WRITE_MULTIPLE_COILS;
+}
+
+static void
+ModbusWriteCommand_Done(ModbusWriteCommand* command)
+{
+    // report the result of the command (and the result of each write
+    // in the order of the command)
+    StringBuf* results = command->isBatch ? StringBuf_New() : NULL;
+    unsigned int succeeded = 0;
+    char response[32];
+    char result[24];
+
+    for (unsigned int g = 0; g < command->groupNum; ++g) {
+        const ModbusWriteGroup* group = &command->groups[g];
+
+        switch (group->status) {
+        case MODBUS_WRITE_SUCCESS:
+            strcpy(result, "Success");
+            succeeded += group->count;
+            break;
+        case MODBUS_WRITE_EXCEPTION:
+            sprintf(result, "Exception 0x%02x", group->exception);
+            break;
+        case MODBUS_WRITE_NO_DEVICE:
+            strcpy(result, "Illegal devID");
+            break;
+        default:
+            strcpy(result, "Error");
+            break;
+        }
+        for (unsigned int k = 0; NULL != results && k < group->count; ++k) {
+            StringBuf_AppendByPrintf(results, "%s\"%s\"",
+                (group->first + k == 0) ? "[" : ",", result);
+        }
+    }
+    if (NULL != results) {
+        StringBuf_AppendChar(results, ']');
+        strcpy(response, (succeeded == command->writeNum) ? "\"Success\"" : "\"Error\"");
+    } else {
+        sprintf(response, "\"%s\"", result);  // result of the only write
+    }
+
+    command->callback(response, (NULL != results) ? StringBuf_GetStr(results) : NULL);
+    StringBuf_Destroy(results);
+    free(command->groups);
+    free(command);
+}
+
+static void
+ModbusWriteCommand_Callback(void* context, ModbusWriteStatus status, uint8_t exception)
+{
+    ModbusWriteGroup* group = (ModbusWriteGroup*)context;
+    ModbusWriteCommand* command = group->command;
+
+    group->status    = status;
+    group->exception = exception;
+    if (--command->remaining == 0) {
+        ModbusWriteCommand_Done(command);
+    }
+}
+
+static bool
+ModbusWriteCommand_Start(const ModbusWriteOp* ops, unsigned int n, bool isBatch,
+    ModbusCommandCallback callback)
+{
+    // group the writes to the contiguous addresses of the same slave
+    // (in the order of the command) into FC15/FC16 writes and queue them,
+    // the result is reported when all the writes are done
+    ModbusWriteCommand* command;
+
+    command = (ModbusWriteCommand*)malloc(sizeof(ModbusWriteCommand));
+    if (command == NULL) {
+        return false;
+    }
+    command->groups = (ModbusWriteGroup*)malloc(sizeof(ModbusWriteGroup) * n);
+    if (command->groups == NULL) {
+        free(command);
+        return false;
+    }
+    command->groupNum  = 0;
+    command->writeNum  = n;
+    command->remaining = 1;  // until all the groups are queued
+    command->isBatch   = isBatch;
+    command->callback  = callback;
+
+    for (unsigned int i = 0; i < n; ) {
+        const ModbusWriteOp* first = &ops[i];
+        ModbusWriteGroup* group = &command->groups[command->groupNum];
+        bool isCoil = ModbusBatchWrite_IsCoil(first);
+        unsigned int maxCount = isCoil ? MODBUS_MAX_WRITE_COILS : MODBUS_MAX_WRITE_REGISTERS;
+        unsigned int count = 1;
+        unsigned short values[MODBUS_MAX_WRITE_REGISTERS];
+        int funcCode = (int)first->funcCode;
+
+        if (maxCount > MODBUS_MAX_WRITE_REGISTERS) {
+            maxCount = MODBUS_MAX_WRITE_REGISTERS;  // size of values
+        }
+        values[0] = first->data;
+        while (i + count < n && count < maxCount
+        &&  ops[i + count].devID == first->devID
+        &&  ops[i + count].priority == first->priority
+        &&  ModbusBatchWrite_IsCoil(&ops[i + count]) == isCoil
+        &&  ops[i + count].regAddr == first->regAddr + count) {
+            values[count] = ops[i + count].data;
+            ++count;
+        }
+        if (count > 1) {
+            funcCode = isCoil ? FC_WRITE_MULTIPLE_COILS : FC_WRITE_MULTIPLE_REGISTERS;
+        }
+
+        group->command   = command;
+        group->first     = i;
+        group->count     = count;
+        group->status    = MODBUS_WRITE_ERROR;
+        group->exception = 0;
+        if (NULL == Libmodbus_GetLib((int)first->devID)) {
+            group->status = MODBUS_WRITE_NO_DEVICE;
+        } else if (Libmodbus_QueueWrite((int)first->devID, (int)first->regAddr, funcCode,
+                values, (int)count, first->priority, ModbusWriteCommand_Callback, group)) {
+            ++command->remaining;
+        }
+        ++command->groupNum;
+        i += count;
+    }
+    if (--command->remaining == 0) {
+        ModbusWriteCommand_Done(command);  // none queued
+    }
+
+    return true;
+}
+
+static bool
+ModbusBatchWrite(const json_value* writes, char* response, ModbusCommandCallback callback)
+{
+    // run the writes by the write queue and report the result of each write
+    ModbusWriteOp* ops;
+    unsigned int n;
+
+    if (writes->type != json_array
+    ||  writes->u.array.length < 1 || writes->u.array.length > MODBUS_BATCH_WRITE_MAX) {
+        strcpy(response, "\"Illegal config\"");
+        return false;
+    }
+    n = writes->u.array.length;
+    ops = (ModbusWriteOp*)malloc(sizeof(ModbusWriteOp) * n);
+    if (ops == NULL) {
+        strcpy(response, "\"Error\"");
+        return false;
+    }
+    for (unsigned int i = 0; i < n; ++i) {
+        const char* err = ModbusBatchWrite_ParseOp(writes->u.array.values[i], &ops[i]);
+
+        if (err != NULL) {
+            sprintf(response, "\"%s (write %u)\"", err, i);
+            free(ops);
+            return false;
         }
     }
+    if (! ModbusWriteCommand_Start(ops, n, true, callback)) {
+        strcpy(response, "\"Error\"");
+        free(ops);
+        return false;
+    }
+    strcpy(response, "\"Accepted\"");
+    free(ops);
+
+    return true;
 }
 
-void ModbusOneshotcommand(const unsigned char* payload, size_t size, char* response) {
+bool ModbusOneshotcommand(const unsigned char* payload, size_t size, char* response,
+    ModbusCommandCallback callback) {
     const char DevIDkey[]           = "devID";
     const char RegisterAddrKey[]    = "registerAddr";
     const char FuncCodeKey[]        = "funcCode";
     const char DataKey[]            = "data";
+    const char WritesKey[]          = "writes";
 
     uint32_t devID = 0;
     uint32_t regAddr = 0;
@@ -163,9 +752,21 @@ void ModbusOneshotcommand(const unsigned char* payload, size_t size, char* respo
 
     json_value* jsonObj = json_parse(payload, size);
     json_value* configItem = json_parse(jsonObj->u.string.ptr, jsonObj->u.string.length);
+    if (configItem && configItem->type == json_object) {
+        // batched write command ({"writes": [{devID, registerAddr, funcCode, data}, ...]})
+        for (unsigned int i = 0, n = configItem->u.object.length; i < n; ++i) {
+            if (0 == strcmp(configItem->u.object.values[i].name, WritesKey)) {
+                bool ret = ModbusBatchWrite(configItem->u.object.values[i].value, response, callback);
+
+                json_value_free(configItem);
+                json_value_free(jsonObj);
+                return ret;
+            }
+        }
+    }
     if (!configItem || configItem->u.object.length != MODBUS_ONESHOT_COMMAND_PARAM_NUM) {
         strcpy(response, "\"Illegal config\"");
-        return;
+        return false;
     }
 
     for (unsigned int i = 0, n = configItem->u.object.length; i < n; ++i) {
@@ -174,21 +775,21 @@ void ModbusOneshotcommand(const unsigned char* payload, size_t size, char* respo
             bool ret = json_GetNumericValue(item, &devID, 16);
             if (!ret || devID == 0) {
                 strcpy(response, "\"Illegal devID\"");
-                return;
+                return false;
             }
         } else if (0 == strcmp(configItem->u.object.values[i].name, RegisterAddrKey)) {
             json_value* item = configItem->u.object.values[i].value;
             bool ret = json_GetNumericValue(item, &regAddr, 16);
             if (!ret) {
                 strcpy(response, "\"Illegal regAddr\"");
-                return;
+                return false;
             }
         } else if (0 == strcmp(configItem->u.object.values[i].name, FuncCodeKey)) {
             json_value* item = configItem->u.object.values[i].value;
             bool ret = json_GetNumericValue(item, &funcCode, 16);
             if (!ret) {
                 strcpy(response, "\"Illegal funcCode\"");
-                return;
+                return false;
             }
         } else if (0 == strcmp(configItem->u.object.values[i].name, DataKey)) {
             json_value* item = configItem->u.object.values[i].value;
@@ -196,7 +797,7 @@ void ModbusOneshotcommand(const unsigned char* payload, size_t size, char* respo
             bool ret = json_GetNumericValue(item, &value, 16);
             if (!ret) {
                 strcpy(response, "\"Illegal data\"");
-                return;
+                return false;
             } else {
                 data = (uint16_t)value;
             }
@@ -207,22 +808,24 @@ void ModbusOneshotcommand(const unsigned char* payload, size_t size, char* respo
     if ((funcCode != FC_WRITE_FORCE_SINGLE_COIL) &&
         (funcCode != FC_WRITE_SINGLE_REGISTER)) {
         strcpy(response, "\"Illegal funcCode\"");
-        return;
+        return false;
     }
 
-    ModbusDev* modbusdev = Libmodbus_GetAndConnectLib((int)devID);
+    ModbusDev* modbusdev = Libmodbus_GetLib((int)devID);
     if (modbusdev == NULL) {
         strcpy(response, "\"Illegal devID\"");
-        return;
+        return false;
     }
 
-    if (Libmodbus_WriteRegister(modbusdev, (int)regAddr, (int)funcCode, &data)) {
-        strcpy(response, "\"Success\"");
-    } else {
+    ModbusWriteOp op = { devID, regAddr, funcCode, data, 0 };
+
+    if (! ModbusWriteCommand_Start(&op, 1, false, callback)) {
         strcpy(response, "\"Error\"");
+        return false;
     }
+    strcpy(response, "\"Accepted\"");
 
-    return;
+    return true;
 }
 
 DataFetchScheduler*
@@ -242,12 +845,43 @@ ModbusDataFetchScheduler_New(void)
         if (NULL == newObj->mFetchTargets) {
             goto err_delete_super;
         }
+        newObj->mReadPlan = ModbusReadPlan_New();
+        if (NULL == newObj->mReadPlan) {
+            ModbusFetchTargets_Destroy(newObj->mFetchTargets);
+            goto err_delete_super;
+        }
+        newObj->mPollSchedule = ModbusPollSchedule_New();
+        if (NULL == newObj->mPollSchedule) {
+            ModbusReadPlan_Destroy(newObj->mReadPlan);
+            ModbusFetchTargets_Destroy(newObj->mFetchTargets);
+            goto err_delete_super;
+        }
+        newObj->mScanQueue = ModbusScanQueue_New();
+        if (NULL == newObj->mScanQueue) {
+            ModbusPollSchedule_Destroy(newObj->mPollSchedule);
+            ModbusReadPlan_Destroy(newObj->mReadPlan);
+            ModbusFetchTargets_Destroy(newObj->mFetchTargets);
+            goto err_delete_super;
+        }
+        newObj->mUsePollSchedule = false;
+        newObj->mReportStates    = NULL;
+        newObj->mReportStateNum  = 0;
+        newObj->mScanStartMs   = 0;
+        newObj->mOverrunCount  = 0;
+        newObj->mReconfigBase  = 0;
+        newObj->mScanReconfigs = 0;
+        newObj->mCurDevID   = 0;
+        newObj->mReqs       = NULL;
+        newObj->mBusReqs    = NULL;
+        newObj->mReadVal    = NULL;
+        newObj->mIsCanceled = false;
     }
 
     super->DoDestroy = ModbusDataFetchScheduler_DoDestroy;
-//	super->DoInit    = ModbusDataFetchScheduler_DoInit;  // don't override
+    super->DoInit            = ModbusDataFetchScheduler_DoInit;
     super->ClearFetchTargets = ModbusDataFetchScheduler_ClearFetchTargets;
     super->DoSchedule        = ModbusDataFetchScheduler_DoSchedule;
+    super->DoQueue           = ModbusDataFetchScheduler_DoQueue;
 
     return super;
 err_delete_super:
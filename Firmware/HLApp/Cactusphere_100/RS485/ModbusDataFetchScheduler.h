@@ -30,6 +30,15 @@
 #endif
 
 extern DataFetchScheduler* ModbusDataFetchScheduler_New(void);
-extern void ModbusOneshotcommand(const unsigned char* payload, size_t size, char* response);
+
+// Write command (direct method)
+//   returns true if the writes are queued, response is "Accepted" then
+//   (the error otherwise). callback is called with the result when the
+//   writes are done, results is the result of each write (JSON array,
+//   only for batched write command, NULL otherwise)
+typedef void (*ModbusCommandCallback)(const char* response, const char* results);
+
+extern bool ModbusOneshotcommand(const unsigned char* payload, size_t size,
+    char* response, ModbusCommandCallback callback);
 
 #endif  // _MODBUS_DATA_FETCH_SCHEDULER_H_
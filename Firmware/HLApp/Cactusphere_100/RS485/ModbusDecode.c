@@ -0,0 +1,187 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "ModbusDecode.h"
+
+#include <string.h>
+
+// data type table
+static const struct {
+    const char* name;
+    uint8_t     wordCount;
+    bool        isSigned;
+} sDataTypes[MODBUS_TYPE_COUNT] = {
+    [MODBUS_TYPE_UINT16]  = { "uint16",  1, false },
+    [MODBUS_TYPE_INT16]   = { "int16",   1, true  },
+    [MODBUS_TYPE_UINT32]  = { "uint32",  2, false },
+    [MODBUS_TYPE_INT32]   = { "int32",   2, true  },
+    [MODBUS_TYPE_UINT64]  = { "uint64",  4, false },
+    [MODBUS_TYPE_INT64]   = { "int64",   4, true  },
+    [MODBUS_TYPE_FLOAT32] = { "float32", 2, false },
+    [MODBUS_TYPE_FLOAT64] = { "float64", 4, false },
+};
+
+// Look up data type by name
+ModbusDataType
+ModbusDecode_GetDataType(const char* name)
+{
+    for (int i = 0; i < MODBUS_TYPE_COUNT; ++i) {
+        if (0 == strcmp(name, sDataTypes[i].name)) {
+            return (ModbusDataType)i;
+        }
+    }
+    return MODBUS_TYPE_COUNT;
+}
+
+// Register count of data type
+uint32_t
+ModbusDecode_GetWordCount(ModbusDataType dataType)
+{
+    return (dataType < MODBUS_TYPE_COUNT) ? sDataTypes[dataType].wordCount : 0;
+}
+
+// Compile decode descriptor
+bool
+ModbusDecode_Compile(ModbusDecodeDesc* desc, ModbusDataType dataType,
+    bool wordSwap, bool byteSwap, uint32_t bitOffset, uint32_t bitLength,
+    bool asFloat, int64_t offset, uint32_t multiplier, uint32_t devider)
+{
+    bool	isFloatType = (dataType == MODBUS_TYPE_FLOAT32
+                        || dataType == MODBUS_TYPE_FLOAT64);
+    uint32_t	valueBits;
+
+    if (dataType >= MODBUS_TYPE_COUNT) {
+        return false;
+    }
+    valueBits = sDataTypes[dataType].wordCount * 16U;
+    if (bitLength == 0) {
+        bitOffset = 0;
+        bitLength = valueBits;
+    }
+    if (bitOffset + bitLength > valueBits
+    ||  (isFloatType && bitLength != valueBits)) {
+        return false;  // bit field out of range, or bit field of float
+    }
+
+    desc->dataType  = (uint8_t)dataType;
+    desc->wordCount = sDataTypes[dataType].wordCount;
+    desc->bitShift  = (uint8_t)bitOffset;
+    desc->bitMask   = (bitLength == 64) ? UINT64_MAX : ((UINT64_C(1) << bitLength) - 1);
+    desc->signShift = sDataTypes[dataType].isSigned ? (uint8_t)(64 - bitLength) : 0;
+    desc->wordSwap  = wordSwap;
+    desc->byteSwap  = byteSwap;
+    desc->asFloat   = asFloat || isFloatType;
+    desc->offset     = offset;
+    desc->multiplier = multiplier;
+    desc->devider    = devider;
+
+    return true;
+}
+
+// Decode and scale the value from the registers
+void
+ModbusDecode_Execute(const ModbusDecodeDesc* desc,
+    const unsigned short* regs, ModbusValue* outValue)
+{
+    // assemble the registers (high word first), pick up the bit field,
+    // then extend the sign or reinterpret as IEEE-754
+    const int	last = desc->wordCount - 1;
+    uint64_t	raw = 0;
+    double	fVal;
+
+    for (int i = 0; i <= last; ++i) {
+        uint16_t	word = regs[desc->wordSwap ? last - i : i];
+
+        if (desc->byteSwap) {
+            word = (uint16_t)((word << 8) | (word >> 8));
+        }
+        raw = (raw << 16) | word;
+    }
+    raw = (raw >> desc->bitShift) & desc->bitMask;
+
+    outValue->isUnsigned = (desc->dataType == MODBUS_TYPE_UINT64);
+    outValue->intVal = (desc->signShift != 0)
+        ? ((int64_t)(raw << desc->signShift) >> desc->signShift)
+        : (int64_t)raw;
+
+    if (! desc->asFloat) {
+        // integer arithmetic
+        if (outValue->isUnsigned) {
+            uint64_t	uVal = raw + (uint64_t)desc->offset;
+
+            if (desc->multiplier != 0) {
+                uVal *= desc->multiplier;
+            }
+            if (desc->devider != 0) {
+                uVal /= desc->devider;
+            }
+            outValue->intVal = (int64_t)uVal;
+        } else {
+            outValue->intVal += desc->offset;
+            if (desc->multiplier != 0) {
+                outValue->intVal *= desc->multiplier;
+            }
+            if (desc->devider != 0) {
+                outValue->intVal /= desc->devider;
+            }
+        }
+        outValue->isFloat  = false;
+        outValue->floatVal = 0;
+        return;
+    }
+
+    if (desc->dataType == MODBUS_TYPE_FLOAT32) {
+        uint32_t	bits32 = (uint32_t)raw;
+        float	f32;
+
+        memcpy(&f32, &bits32, sizeof(f32));
+        fVal = f32;
+    } else if (desc->dataType == MODBUS_TYPE_FLOAT64) {
+        memcpy(&fVal, &raw, sizeof(fVal));
+    } else if (outValue->isUnsigned) {
+        fVal = (double)raw;
+    } else {
+        fVal = (double)outValue->intVal;
+    }
+    fVal += (double)desc->offset;
+    if (desc->multiplier != 0) {
+        fVal *= desc->multiplier;
+    }
+    if (desc->devider != 0) {
+        fVal /= desc->devider;
+    }
+    outValue->isFloat  = true;
+    outValue->floatVal = fVal;
+}
+
+// Get the value as double
+double
+ModbusDecode_ToDouble(const ModbusValue* value)
+{
+    if (value->isFloat) {
+        return value->floatVal;
+    }
+    return value->isUnsigned
+        ? (double)(uint64_t)value->intVal : (double)value->intVal;
+}
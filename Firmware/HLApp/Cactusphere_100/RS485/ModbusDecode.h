@@ -0,0 +1,91 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _MODBUS_DECODE_H_
+#define _MODBUS_DECODE_H_
+
+#ifndef _STDBOOL_H
+#include <stdbool.h>
+#endif
+#ifndef _STDINT_H
+#include <stdint.h>
+#endif
+
+// data type of a telemetry item
+typedef enum {
+    MODBUS_TYPE_UINT16 = 0,
+    MODBUS_TYPE_INT16,
+    MODBUS_TYPE_UINT32,
+    MODBUS_TYPE_INT32,
+    MODBUS_TYPE_UINT64,
+    MODBUS_TYPE_INT64,
+    MODBUS_TYPE_FLOAT32,  // IEEE-754 single
+    MODBUS_TYPE_FLOAT64,  // IEEE-754 double
+    MODBUS_TYPE_COUNT
+} ModbusDataType;
+
+// decode descriptor (compiled from the item configuration)
+typedef struct ModbusDecodeDesc {
+    uint8_t     dataType;   // ModbusDataType
+    uint8_t     wordCount;  // register count of the value
+    uint8_t     bitShift;   // position of bit field (0: whole value)
+    uint8_t     signShift;  // shift count for sign extension (0: unsigned)
+    bool        wordSwap;   // true: low word first
+    bool        byteSwap;   // true: low byte first in each register
+    bool        asFloat;    // true: output as floating point number
+    uint64_t    bitMask;    // mask of the value after bitShift
+    int64_t     offset;     // added to the raw value
+    uint32_t    multiplier; // 0: not multiplied
+    uint32_t    devider;    // 0: not divided
+} ModbusDecodeDesc;
+
+// decoded value
+typedef struct ModbusValue {
+    bool        isFloat;    // true: floatVal, false: intVal
+    bool        isUnsigned; // intVal holds uint64_t
+    int64_t     intVal;
+    double      floatVal;
+} ModbusValue;
+
+// Look up data type by name ("uint16", "int32", "float32", ...)
+//   returns MODBUS_TYPE_COUNT if unknown
+extern ModbusDataType	ModbusDecode_GetDataType(const char* name);
+
+// Register count of data type
+extern uint32_t	ModbusDecode_GetWordCount(ModbusDataType dataType);
+
+// Compile decode descriptor
+//   bitLength 0 means whole value, returns false if invalid combination
+extern bool	ModbusDecode_Compile(ModbusDecodeDesc* desc, ModbusDataType dataType,
+    bool wordSwap, bool byteSwap, uint32_t bitOffset, uint32_t bitLength,
+    bool asFloat, int64_t offset, uint32_t multiplier, uint32_t devider);
+
+// Decode and scale the value from the registers (wordCount)
+extern void	ModbusDecode_Execute(const ModbusDecodeDesc* desc,
+    const unsigned short* regs, ModbusValue* outValue);
+
+// Get the value as double (for comparison)
+extern double	ModbusDecode_ToDouble(const ModbusValue* value);
+
+#endif  // _MODBUS_DECODE_H_
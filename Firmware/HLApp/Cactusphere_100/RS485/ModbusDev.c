@@ -32,15 +32,20 @@
 #include <stdlib.h>
 
 #include "ModbusDev.h"
+#include "ModbusDevHealth.h"
 #include "ModbusDevRTU.h"
 #include "UartDriveMsg.h"
 #include "SendRTApp.h"
+#include "StringBuf.h"
 #include "vector.h"
 
 // ModbusDev structure
 typedef struct ModbusDev {
     ModbusCtx* ctx;
     int devId;
+    uint32_t readGap;  // unused registers allowed in a read block
+    uint32_t cacheTtlMs;  // max age of the snapshot used instead of reading
+    ModbusDevHealth health;  // health of the slave
 }ModbusDev;
 
 // Initialization and cleanup
@@ -61,13 +66,17 @@ ModbusDev_Destroy(vector modbusDevVec) {
 
 // Create Modbus RTU
 ModbusDev* 
-ModbusDev_NewModbusRTU(int devId, int baud, uint8_t parity, uint8_t stop) {
+ModbusDev_NewModbusRTU(int devId, int baud, uint8_t parity, uint8_t stop,
+    uint32_t readGap, uint32_t cacheTtlMs) {
     ModbusDev* newObj;
 
     newObj = (ModbusDev*)malloc(sizeof(ModbusDev));
     newObj->ctx = ModbusDevRTU_Initialize(devId, baud, parity, stop);
 
     newObj->devId = devId;
+    newObj->readGap = readGap;
+    newObj->cacheTtlMs = cacheTtlMs;
+    ModbusDevHealth_Init(&newObj->health);
 
     return newObj;
 }
@@ -85,26 +94,128 @@ ModbusDev_GetModbusDev(int devID, vector modbusDevVec) {
     return NULL;
 }
 
-// Connect
-bool 
-ModbusDev_Connect(ModbusDev* me) {
-    return ModbusDevRTU_Connect(me->ctx);
+int
+ModbusDev_GetDevID(ModbusDev* me) {
+    return me->devId;
+}
+
+// UART line parameters
+uint32_t
+ModbusDev_GetLineKey(ModbusDev* me) {
+    return ModbusDevRTU_GetLineKey(me->ctx);
+}
+
+uint32_t
+ModbusDev_GetCurrentLineKey(void) {
+    return ModbusDevRTU_GetCurrentLineKey();
+}
+
+uint32_t
+ModbusDev_GetLineReconfigCount(void) {
+    return ModbusDevRTU_GetLineReconfigCount();
 }
 
 // Read status/register
-bool 
-ModbusDev_ReadRegister(ModbusDev* me, int regAddr, int funcCode, unsigned short* dst, int regCount) {
-    return ModbusDevRTU_ReadRegister(me->ctx, regAddr, funcCode, dst, regCount);
+bool
+ModbusDev_ReadRegistersAsync(ModbusDev* me, ModbusReadRequest* reqs, int count,
+    ModbusReadCallback callback, void* context) {
+    // health is updated by ModbusDev_UpdateHealth() in the callback
+    ModbusDevRTU_SetResponseTimeout(me->ctx, me->health.timeoutMs);
+    return ModbusDevRTU_ReadRegistersAsync(me->ctx, reqs, count, callback, context);
+}
+
+// Poll schedule run by RTApp
+void
+ModbusDev_FillPollEntry(ModbusDev* me, ModbusPollEntry* entry) {
+    ModbusDevRTU_FillPollEntry(me->ctx, entry);
+    entry->timeoutMs = me->health.timeoutMs;
+}
+
+bool
+ModbusDev_DownloadPollSchedule(const ModbusPollEntry* entries, int count,
+    ModbusPollConfigCallback callback, void* context) {
+    return ModbusDevRTU_DownloadPollSchedule(entries, count, callback, context);
+}
+
+bool
+ModbusDev_FetchPollResultsAsync(ModbusPollCallback callback, void* context) {
+    return ModbusDevRTU_FetchPollResultsAsync(callback, context);
+}
+
+// Write coils/registers asynchronously
+bool
+ModbusDev_WriteRegistersAsync(ModbusDev* me, int regAddr, int funcCode,
+    const uint16_t* values, int count, ModbusWriteDoneCallback callback, void* context) {
+    return ModbusDevRTU_WriteRegistersAsync(me->ctx, regAddr, funcCode, values, count,
+        callback, context);
+}
+
+// Health of the slave
+bool
+ModbusDev_IsPollDue(ModbusDev* me) {
+    return ModbusDevHealth_IsPollDue(&me->health);
+}
+
+void
+ModbusDev_UpdateHealth(ModbusDev* me, const ModbusReadRequest* reqs, int count) {
+    ModbusDevHealth_Update(&me->health, reqs, count);
 }
 
-// Write 2byte
+void
+ModbusDev_AppendHealthJSON(vector modbusDevVec, StringBuf* sb) {
+    ModbusDev* modbusDev = vector_get_data(modbusDevVec);
+
+    StringBuf_AppendChar(sb, '[');
+    for (int i = 0, n = vector_size(modbusDevVec); i < n; ++i) {
+        if (i != 0) {
+            StringBuf_AppendChar(sb, ',');
+        }
+        ModbusDevHealth_AppendJSON(&modbusDev->health, modbusDev->devId, sb);
+        modbusDev++;
+    }
+    StringBuf_AppendChar(sb, ']');
+}
+
+// Transaction statistics of the slave
 bool
-ModbusDev_WriteRegister(ModbusDev* me, int regAddr, int funcCode, uint16_t value) {
-    return ModbusDevRTU_WriteRegister(me->ctx, regAddr, funcCode, value);
+ModbusDev_FetchStatsAsync(ModbusStatsCallback callback, void* context) {
+    return ModbusDevRTU_FetchStatsAsync(callback, context);
+}
+
+void
+ModbusDev_AddStats(ModbusDev* me, const ModbusTransStats* stats) {
+    ModbusDevHealth_AddStats(&me->health, stats);
+}
+
+void
+ModbusDev_AppendStatsJSON(vector modbusDevVec, StringBuf* sb) {
+    ModbusDev* modbusDev = vector_get_data(modbusDevVec);
+
+    StringBuf_AppendChar(sb, '[');
+    for (int i = 0, n = vector_size(modbusDevVec); i < n; ++i) {
+        if (i != 0) {
+            StringBuf_AppendChar(sb, ',');
+        }
+        ModbusDevHealth_AppendStatsJSON(&modbusDev->health, modbusDev->devId, sb);
+        modbusDev++;
+    }
+    StringBuf_AppendChar(sb, ']');
+}
+
+// Get read block gap
+uint32_t
+ModbusDev_GetReadGap(ModbusDev* me) {
+    return me->readGap;
+}
+
+// Get TTL of the register snapshot
+uint32_t
+ModbusDev_GetCacheTtl(ModbusDev* me) {
+    return me->cacheTtlMs;
 }
 
-// Get RTApp Version
+// Get RTApp Version asynchronously
 bool
-ModbusDev_GetRTAppVersion(char* rtAppVersion) {
-    return ModbusDevRTU_GetRTAppVersion(rtAppVersion);
+ModbusDev_GetRTAppVersionAsync(ModbusVersionCallback callback, void* context) {
+    return ModbusDevRTU_GetRTAppVersionAsync(callback, context);
 }
@@ -30,27 +30,58 @@
 #include "json.h"
 #include "vector.h"
 
+#include "ModbusDevRTU.h"
+
 typedef struct ModbusDev ModbusDev;
+typedef struct StringBuf StringBuf;
 
 // Initialization and cleanup
 extern vector ModbusDev_Initialize(void);
 extern void ModbusDev_Destroy(vector modbusDevVec);
 
 // Create Modbus RTU
-extern ModbusDev* ModbusDev_NewModbusRTU(int devId, int baud, uint8_t parity, uint8_t stop);
+extern ModbusDev* ModbusDev_NewModbusRTU(int devId, int baud, uint8_t parity, uint8_t stop,
+    uint32_t readGap, uint32_t cacheTtlMs);
 
 // Get ModbusDev*
 extern ModbusDev* ModbusDev_GetModbusDev(int devID, vector modbusDevVec);
+extern int ModbusDev_GetDevID(ModbusDev* me);
 
-// Connect
-extern bool ModbusDev_Connect(ModbusDev* me);
+// UART line parameters
+extern uint32_t ModbusDev_GetLineKey(ModbusDev* me);
+extern uint32_t ModbusDev_GetCurrentLineKey(void);
+extern uint32_t ModbusDev_GetLineReconfigCount(void);
 
 // Read status/register
-extern bool ModbusDev_ReadRegister(ModbusDev* me, int regAddr, int funcCode, unsigned short* dst, int regCount);
+extern bool ModbusDev_ReadRegistersAsync(ModbusDev* me, ModbusReadRequest* reqs, int count,
+    ModbusReadCallback callback, void* context);
+
+// Poll schedule run by RTApp
+extern void ModbusDev_FillPollEntry(ModbusDev* me, ModbusPollEntry* entry);
+extern bool ModbusDev_DownloadPollSchedule(const ModbusPollEntry* entries, int count,
+    ModbusPollConfigCallback callback, void* context);
+extern bool ModbusDev_FetchPollResultsAsync(ModbusPollCallback callback, void* context);
+
+// Write coils/registers asynchronously (FC05/FC06 with count 1, FC15/FC16)
+extern bool ModbusDev_WriteRegistersAsync(ModbusDev* me, int regAddr, int funcCode,
+    const uint16_t* values, int count, ModbusWriteDoneCallback callback, void* context);
+
+// Health of the slave
+extern bool ModbusDev_IsPollDue(ModbusDev* me);
+extern void ModbusDev_UpdateHealth(ModbusDev* me, const ModbusReadRequest* reqs, int count);
+extern void ModbusDev_AppendHealthJSON(vector modbusDevVec, StringBuf* sb);
+
+// Transaction statistics of the slave (measured by RTApp)
+extern bool ModbusDev_FetchStatsAsync(ModbusStatsCallback callback, void* context);
+extern void ModbusDev_AddStats(ModbusDev* me, const ModbusTransStats* stats);
+extern void ModbusDev_AppendStatsJSON(vector modbusDevVec, StringBuf* sb);
+
+// Get read block gap
+extern uint32_t ModbusDev_GetReadGap(ModbusDev* me);
 
-// Write 2byte
-extern bool ModbusDev_WriteRegister(ModbusDev* me, int regAddr, int funcCode, uint16_t value);
+// Get TTL of the register snapshot (0: always read)
+extern uint32_t ModbusDev_GetCacheTtl(ModbusDev* me);
 
-// Get RTApp Version
-extern bool ModbusDev_GetRTAppVersion(char* rtAppVersion);
+// Get RTApp Version asynchronously
+extern bool ModbusDev_GetRTAppVersionAsync(ModbusVersionCallback callback, void* context);
 #endif  // _MODBUS_DEV_H_
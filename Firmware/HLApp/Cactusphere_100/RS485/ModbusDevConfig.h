@@ -26,10 +26,39 @@
 #define _MODBUS_DEV_CONFIG_H_
 
 // Allowed function code
+#define FC_READ_COILS               0x01
+#define FC_READ_DISCRETE_INPUTS     0x02
 #define FC_READ_HOLDING_REGISTER    0x03
 #define FC_READ_INPUT_REGISTERS     0x04
 #define FC_WRITE_FORCE_SINGLE_COIL  0x05
 #define FC_WRITE_SINGLE_REGISTER    0x06
+#define FC_WRITE_MULTIPLE_COILS     0x0F
+#define FC_WRITE_MULTIPLE_REGISTERS 0x10
+
+// exception response (function code | MODBUS_EXCEPTION_FLAG, exception code)
+#define MODBUS_EXCEPTION_FLAG       0x80
+#define MODBUS_EXCEPTION_RSP_LENGTH 5
+
+// max register count in one read request (FC03/FC04)
+#define MODBUS_MAX_READ_REGISTERS   125
+
+// max bit count in one read request (FC01/FC02)
+//   read bits are packed into words (LSB first), 2000 bits fit in
+//   MODBUS_MAX_READ_REGISTERS words
+#define MODBUS_MAX_READ_BITS        2000
+
+#define MODBUS_IS_BIT_READ(fc) \
+    ((fc) == FC_READ_COILS || (fc) == FC_READ_DISCRETE_INPUTS)
+#define MODBUS_MAX_READ_LENGTH(fc) \
+    (MODBUS_IS_BIT_READ(fc) ? MODBUS_MAX_READ_BITS : MODBUS_MAX_READ_REGISTERS)
+
+// max count in one write request (FC15/FC16)
+#define MODBUS_MAX_WRITE_COILS      1968
+#define MODBUS_MAX_WRITE_REGISTERS  123
+
+// byte count of read data in the response
+#define MODBUS_READ_DATA_BYTES(fc, length) \
+    (MODBUS_IS_BIT_READ(fc) ? ((length) + 7) / 8 : (length) * 2)
 
 // parity bit
 typedef enum {
@@ -0,0 +1,196 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "ModbusDevHealth.h"
+
+#include <string.h>
+
+#include "StringBuf.h"
+
+#define FAIL_CYCLES_TO_BACKOFF	3    // consecutive failed cycles before backing off
+#define MIN_BACKOFF_SEC	2
+#define MAX_BACKOFF_SEC	300
+#define LATENCY_AVG_WEIGHT	8    // moving average over about 8 samples
+
+static time_t
+MonotonicSec(void)
+{
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static uint32_t
+ModbusDevHealth_CalcTimeout(const ModbusDevHealth* me)
+{
+    // 3 times of average response time plus margin
+    uint32_t	timeoutMs = me->avgLatencyMs * 3 + 30;
+
+    if (timeoutMs < MODBUS_RESPONSE_TIMEOUT_MIN_MS) {
+        timeoutMs = MODBUS_RESPONSE_TIMEOUT_MIN_MS;
+    } else if (timeoutMs > MODBUS_RESPONSE_TIMEOUT_MAX_MS) {
+        timeoutMs = MODBUS_RESPONSE_TIMEOUT_MAX_MS;
+    }
+    return timeoutMs;
+}
+
+// Initialization
+void
+ModbusDevHealth_Init(ModbusDevHealth* me)
+{
+    memset(me, 0, sizeof(*me));
+    me->timeoutMs = MODBUS_RESPONSE_TIMEOUT_MAX_MS;  // until the first response
+}
+
+// Check whether the slave should be polled
+bool
+ModbusDevHealth_IsPollDue(const ModbusDevHealth* me)
+{
+    // while backed off, poll only once per backoff interval (as a probe)
+    return me->backoffSec == 0 || MonotonicSec() >= me->nextPollTime;
+}
+
+// Update by the results of one polling cycle
+void
+ModbusDevHealth_Update(ModbusDevHealth* me,
+    const ModbusReadRequest* reqs, int count)
+{
+    uint32_t	answered = 0;
+
+    for (int i = 0; i < count; i++) {
+        me->requestCount++;
+        if (! reqs[i].answered) {
+            continue;
+        }
+        answered++;
+        me->responseCount++;
+        if (reqs[i].exception != 0) {
+            me->exceptionCount++;
+            me->lastException = reqs[i].exception;
+        }
+        if (me->lastResponseTime == 0) {
+            me->avgLatencyMs = reqs[i].elapsedMs;
+        } else {
+            me->avgLatencyMs = (me->avgLatencyMs * (LATENCY_AVG_WEIGHT - 1)
+                + reqs[i].elapsedMs) / LATENCY_AVG_WEIGHT;
+        }
+        me->lastResponseTime = time(NULL);
+    }
+    if (count == 0) {
+        return;
+    }
+
+    if (answered != 0) {
+        // (recovered) poll at every interval
+        me->failCycles = 0;
+        me->backoffSec = 0;
+        me->timeoutMs  = ModbusDevHealth_CalcTimeout(me);
+    } else if (++me->failCycles >= FAIL_CYCLES_TO_BACKOFF) {
+        // back off exponentially
+        if (me->backoffSec == 0) {
+            me->backoffSec = MIN_BACKOFF_SEC;
+        } else if (me->backoffSec < MAX_BACKOFF_SEC) {
+            me->backoffSec *= 2;
+            if (me->backoffSec > MAX_BACKOFF_SEC) {
+                me->backoffSec = MAX_BACKOFF_SEC;
+            }
+        }
+        me->nextPollTime = MonotonicSec() + me->backoffSec;
+    }
+}
+
+// Append the health of the slave as JSON object
+void
+ModbusDevHealth_AppendJSON(const ModbusDevHealth* me,
+    int devID, StringBuf* sb)
+{
+    StringBuf_AppendByPrintf(sb,
+        "{\"devID\":%d,\"state\":\"%s\",\"req\":%lu,\"rsp\":%lu,\"exc\":%lu,\"lastExc\":%u,"
+        "\"latency\":%lu,\"timeout\":%lu,\"backoff\":%lu,\"lastResponse\":",
+        devID, (me->backoffSec != 0) ? "DOWN" : (me->failCycles != 0) ? "FAILING" : "OK",
+        (unsigned long)me->requestCount, (unsigned long)me->responseCount,
+        (unsigned long)me->exceptionCount, (unsigned int)me->lastException,
+        (unsigned long)me->avgLatencyMs, (unsigned long)me->timeoutMs,
+        (unsigned long)me->backoffSec);
+    if (me->lastResponseTime != 0) {
+        char	lastResponse[32];
+        struct tm	tm;
+
+        gmtime_r(&me->lastResponseTime, &tm);
+        strftime(lastResponse, sizeof(lastResponse), "%Y-%m-%dT%H:%M:%SZ", &tm);
+        StringBuf_AppendByPrintf(sb, "\"%s\"}", lastResponse);
+    } else {
+        StringBuf_Append(sb, "null}");
+    }
+}
+
+// Accumulate transaction statistics
+void
+ModbusDevHealth_AddStats(ModbusDevHealth* me,
+    const ModbusTransStats* stats)
+{
+    ModbusTransStats_Add(&me->stats, stats);
+}
+
+void
+ModbusTransStats_Add(ModbusTransStats* me,
+    const ModbusTransStats* stats)
+{
+    me->requestCount   += stats->requestCount;
+    me->timeoutCount   += stats->timeoutCount;
+    me->shortCount     += stats->shortCount;
+    me->exceptionCount += stats->exceptionCount;
+    me->crcErrorCount  += stats->crcErrorCount;
+    for (int i = 0; i < MODBUS_LATENCY_BINS; i++) {
+        me->latency[i] += stats->latency[i];
+    }
+}
+
+// Append transaction statistics as members of JSON object
+void
+ModbusTransStats_AppendJSON(const ModbusTransStats* me,
+    StringBuf* sb)
+{
+    StringBuf_AppendByPrintf(sb,
+        "\"req\":%lu,\"timeout\":%lu,\"short\":%lu,\"exc\":%lu,\"crc\":%lu,\"latency\":[",
+        (unsigned long)me->requestCount, (unsigned long)me->timeoutCount,
+        (unsigned long)me->shortCount, (unsigned long)me->exceptionCount,
+        (unsigned long)me->crcErrorCount);
+    for (int i = 0; i < MODBUS_LATENCY_BINS; i++) {
+        StringBuf_AppendByPrintf(sb, (i == 0) ? "%lu" : ",%lu",
+            (unsigned long)me->latency[i]);
+    }
+    StringBuf_AppendChar(sb, ']');
+}
+
+// Append transaction statistics of the slave as JSON object
+void
+ModbusDevHealth_AppendStatsJSON(const ModbusDevHealth* me,
+    int devID, StringBuf* sb)
+{
+    StringBuf_AppendByPrintf(sb, "{\"devID\":%d,", devID);
+    ModbusTransStats_AppendJSON(&me->stats, sb);
+    StringBuf_AppendChar(sb, '}');
+}
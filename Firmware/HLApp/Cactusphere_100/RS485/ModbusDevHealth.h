@@ -0,0 +1,91 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _MODBUS_DEV_HEALTH_H_
+#define _MODBUS_DEV_HEALTH_H_
+
+#ifndef _STDBOOL_H
+#include <stdbool.h>
+#endif
+#ifndef _STDINT_H
+#include <stdint.h>
+#endif
+#include <time.h>
+
+#include "ModbusDevRTU.h"
+
+typedef struct StringBuf	StringBuf;
+
+// response timeout of a slave (adaptive) [msec]
+#define MODBUS_RESPONSE_TIMEOUT_MIN_MS  50
+#define MODBUS_RESPONSE_TIMEOUT_MAX_MS  400  // same as RTApp default
+
+// health of a slave device
+typedef struct ModbusDevHealth {
+    uint32_t	requestCount;    // count of requests
+    uint32_t	responseCount;   // count of requests answered (including exception)
+    uint32_t	exceptionCount;  // count of exception responses
+    uint32_t	failCycles;      // consecutive polling cycles without any response
+    uint32_t	avgLatencyMs;    // moving average of response time [msec]
+    uint32_t	timeoutMs;       // current response timeout [msec]
+    uint32_t	backoffSec;      // current backoff interval [sec] (0: not backed off)
+    time_t	nextPollTime;    // polling is skipped until this time (monotonic)
+    time_t	lastResponseTime;  // time of the last response (0: never)
+    uint8_t	lastException;   // last exception code
+    ModbusTransStats	stats;   // transaction statistics measured by RTApp
+} ModbusDevHealth;
+
+// Initialization
+extern void	ModbusDevHealth_Init(ModbusDevHealth* me);
+
+// Check whether the slave should be polled (false while backed off)
+extern bool	ModbusDevHealth_IsPollDue(const ModbusDevHealth* me);
+
+// Update by the results of one polling cycle
+extern void	ModbusDevHealth_Update(ModbusDevHealth* me,
+    const ModbusReadRequest* reqs, int count);
+
+// Append the health of the slave as JSON object
+//   "devID", "state" ("OK", "FAILING" or "DOWN"), "req", "rsp", "exc",
+//   "lastExc", "latency" [msec], "timeout" [msec], "backoff" [sec] and
+//   "lastResponse" (UTC, null if never)
+extern void	ModbusDevHealth_AppendJSON(const ModbusDevHealth* me,
+    int devID, StringBuf* sb);
+
+// Accumulate transaction statistics
+extern void	ModbusDevHealth_AddStats(ModbusDevHealth* me,
+    const ModbusTransStats* stats);
+extern void	ModbusTransStats_Add(ModbusTransStats* me,
+    const ModbusTransStats* stats);
+
+// Append transaction statistics as members of JSON object
+//   "req", "timeout", "short", "exc", "crc" and "latency" (histogram)
+extern void	ModbusTransStats_AppendJSON(const ModbusTransStats* me,
+    StringBuf* sb);
+
+// Append transaction statistics of the slave as JSON object
+extern void	ModbusDevHealth_AppendStatsJSON(const ModbusDevHealth* me,
+    int devID, StringBuf* sb);
+
+#endif  // _MODBUS_DEV_HEALTH_H_
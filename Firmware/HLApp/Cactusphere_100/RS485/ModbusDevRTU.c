@@ -30,9 +30,11 @@
 #include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
-#include <time.h>
+
+#include <applibs/log.h>
 
 #include "ModbusDevRTU.h"
+#include "ModbusCRC.h"
 #include "ModbusDevConfig.h"
 #include "UartDriveMsg.h"
 #include "SendRTApp.h"
@@ -58,54 +60,96 @@ typedef struct ModbusCtx {
     uint8_t stop;
     int     header_length;
     int     checksum_length;
+    uint32_t responseTimeoutMs;  // response timeout (0: RTApp default)
 }ModbusCtx;
 
-static uint16_t 
-ModbusRTU_CalcCRC(uint8_t* req, int req_length) {
-    uint16_t crc = 0xFFFF;
-    for (int i = 0; i < req_length; i++) {
-        crc = (uint16_t)(crc ^ req[i]);
-        for (int j = 0; j < 8; j++) {
-            if ((crc & 1) == 1) {
-                crc = crc >> 1;
-                crc ^= 0xA001;
-            }
-            else {
-                crc = crc >> 1;
-            }
-        }
-    }
-    return crc;
+// UART line parameters of the last request sent to RTApp
+static struct {
+    bool    valid;
+    int     baud;
+    uint8_t parity;
+    uint8_t stop;
+} sLineParams = { false, 0, 0, 0 };
+static uint32_t sLineReconfigCount = 0;  // count of UART reprogramming reported by RTApp
+
+// poll schedule downloaded to RTApp (RTApp may change the line parameters)
+typedef struct ModbusPollFrame {
+    ModbusPollEntry entry;
+    uint8_t frame[MODBUS_RTU_READ_REQ_FRAME_LEN];
+} ModbusPollFrame;
+
+static ModbusPollFrame* sPollFrames = NULL;
+static int sPollFrameCount = 0;
+
+// asynchronous download of ModbusDevRTU_DownloadPollSchedule()
+typedef struct ModbusPollDownload {
+    ModbusPollConfigCallback callback;
+    void* context;
+    uint32_t gen;       // superseded if not sPollDownloadGen
+    int remaining;      // count of messages not answered
+    bool failed;
+} ModbusPollDownload;
+
+static uint32_t sPollDownloadGen = 0;
+
+// asynchronous fetch of ModbusDevRTU_FetchPollResultsAsync()
+typedef struct ModbusPollFetch {
+    ModbusPollCallback callback;
+    void* context;
+} ModbusPollFetch;
+
+// asynchronous fetch of ModbusDevRTU_FetchStatsAsync()
+typedef struct ModbusStatsFetch {
+    ModbusStatsCallback callback;
+    void* context;
+} ModbusStatsFetch;
+
+// asynchronous request of ModbusDevRTU_GetRTAppVersionAsync()
+typedef struct ModbusVersionFetch {
+    ModbusVersionCallback callback;
+    void* context;
+} ModbusVersionFetch;
+
+const uint16_t ModbusDevRTU_LatencyLimitsMs[MODBUS_LATENCY_BINS - 1] = UART_STATS_LATENCY_LIMITS;
+
+// Build request frame (address, function, register, count and CRC)
+int
+ModbusDevRTU_BuildRequestFrame(int devId, int function, int addr, int length, uint8_t* frame) {
+    frame[0] = (uint8_t)devId;
+    frame[1] = (uint8_t)function;
+    frame[2] = (uint8_t)(addr >> 8);
+    frame[3] = (uint8_t)(addr & 0x00ff);
+    frame[4] = (uint8_t)(length >> 8);
+    frame[5] = (uint8_t)(length & 0x00ff);
+
+    return ModbusCRC_Append(frame, MODBUS_RTU_PRESET_READ_REQ_LENGTH);
 }
 
-static int 
-ModbusRTU_AddCRCRequestMsg(uint8_t* req, int req_length) {
-    uint16_t crc = ModbusRTU_CalcCRC(req, req_length);
-
-    req[req_length++] = (uint8_t)crc;
-    req[req_length++] = (uint8_t)(crc >> 8);
-
-    return req_length;
+// Length of read response frame
+int
+ModbusDevRTU_GetReadResponseLength(int function, int length) {
+    return MODBUS_RTU_PRESET_READ_RES_LENGTH + MODBUS_READ_DATA_BYTES(function, length)
+        + MODBUS_RTU_CHECKSUM_LENGTH;
 }
 
-static bool
-ModbusRTU_CheckCRCResponseMsg(uint8_t* rsp, int rsp_length) {
-    uint16_t crc = ModbusRTU_CalcCRC(rsp, rsp_length);
-
-    return (rsp[rsp_length] == (uint8_t)(crc & 0x00ff)) &&
-           (rsp[rsp_length + 1] == (uint8_t)(crc >> 8));
+static void
+ModbusDevRTU_SetLineParams(const ModbusCtx* me, UART_LineParams* line) {
+    // carried by each request, RTApp may change them between requests
+    // (reprograms UART only if they differ from the current ones)
+    line->baudRate = (uint32_t)me->baud;
+    line->parity = (uint8_t)me->parity;
+    line->stop = (uint8_t)me->stop;
+    line->reserved = 0;
+
+    sLineParams.baud = me->baud;
+    sLineParams.parity = me->parity;
+    sLineParams.stop = me->stop;
+    sLineParams.valid = true;
 }
 
 static int
 ModbusRTU_CreateRequestMsg(ModbusCtx* me, int function, int addr, int length, uint8_t *req) {
-    req[0] = (uint8_t)me->devId;
-    req[1] = (uint8_t)function;
-    req[2] = (uint8_t)(addr >> 8);
-    req[3] = (uint8_t)(addr & 0x00ff);
-    req[4] = (uint8_t)(length >> 8);
-    req[5] = (uint8_t)(length & 0x00ff);
-
-    return ModbusRTU_AddCRCRequestMsg(req, MODBUS_RTU_PRESET_READ_REQ_LENGTH);
+    return ModbusDevRTU_BuildRequestFrame(me->devId, function, addr, length, req);
 }
 
 static int 
@@ -126,6 +170,13 @@ ModbusRTU_CheckResponseMsg(ModbusCtx* me, uint8_t* req, uint8_t* rsp){
     }
 
     switch (function) {
+    case FC_READ_COILS:
+    case FC_READ_DISCRETE_INPUTS:
+        req_calc_length = (req[offset + 3] << 8) + req[offset + 4];
+        rsp_calc_length = (rsp[offset + 1] == MODBUS_READ_DATA_BYTES(function, req_calc_length))
+            ? req_calc_length : 0;
+        crc_calc_length = MODBUS_RTU_PRESET_READ_RES_LENGTH + MODBUS_READ_DATA_BYTES(function, req_calc_length);
+        break;
     case FC_READ_HOLDING_REGISTER:
     case FC_READ_INPUT_REGISTERS:
         req_calc_length = (req[offset + 3] << 8) + req[offset + 4];
@@ -137,6 +188,13 @@ ModbusRTU_CheckResponseMsg(ModbusCtx* me, uint8_t* req, uint8_t* rsp){
         req_calc_length = rsp_calc_length = 1;
         crc_calc_length = MODBUS_RTU_PRESET_WRITE_RES_LENGTH + (rsp_calc_length * 2);
         break;
+    case FC_WRITE_MULTIPLE_COILS:
+    case FC_WRITE_MULTIPLE_REGISTERS:
+        // echo of the address and the count
+        req_calc_length = 1;
+        rsp_calc_length = (0 == memcmp(&req[offset + 1], &rsp[offset + 1], 4)) ? 1 : 0;
+        crc_calc_length = MODBUS_RTU_PRESET_WRITE_RES_LENGTH + 2;
+        break;
     default :
         return -1;
     }
@@ -145,69 +203,253 @@ ModbusRTU_CheckResponseMsg(ModbusCtx* me, uint8_t* req, uint8_t* rsp){
         rc = rsp_calc_length;
     }
 
-    if (!(ModbusRTU_CheckCRCResponseMsg(rsp, crc_calc_length))) {
+    if (!(ModbusCRC_Check(rsp, crc_calc_length))) {
         return -1;
     }
 
     return rc;
 }
 
-long ModbusDevRTU_CreateInterval(ModbusCtx* me) {
-    int data = 8;
-    long interval_ns = 1000000000LL * (1 + data
-                  + (me->parity == PARITY_NONE ? 0 : 1)
-                  + me->stop) * 3.5 / me->baud;
+static void
+ModbusRTU_GetReadData(ModbusCtx* me, const uint8_t* rsp, int count, unsigned short* dst) {
+    // registers are big endian, bits are packed into words (LSB first)
+    const int function = rsp[me->header_length];
+    const uint8_t* data = &rsp[me->header_length + 2];
 
-    return interval_ns;
-}
+    if (MODBUS_IS_BIT_READ(function)) {
+        const int bytes = MODBUS_READ_DATA_BYTES(function, count);
 
-// Read register
-bool
-ModbusDevRTU_ReadRegister(ModbusCtx* me, int regAddr, int function, unsigned short* dst, int length) {
-    int rc;
-    int req_length;
-    uint8_t req[MIN_REQ_LENGTH] = {0};
-    uint8_t rsp[MAX_MESSAGE_LENGTH] = {0};
-    unsigned char sendMessage[MAX_MESSAGE_LENGTH];
-    UART_DriverMsg* msg = (UART_DriverMsg*)sendMessage;
+        for (int i = 0; i < bytes; i += 2) {
+            dst[i >> 1] = (unsigned short)(data[i] | ((i + 1 < bytes) ? (data[i + 1] << 8) : 0));
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            dst[i] = (unsigned short)((data[i << 1] << 8) | data[(i << 1) + 1]);
+        }
+    }
+}
 
-    req_length = ModbusRTU_CreateRequestMsg(me, function, regAddr, length, req);
+static uint8_t
+ModbusRTU_GetExceptionCode(ModbusCtx* me, const uint8_t* req, const uint8_t* rsp) {
+    // exception code if rsp is the exception response for req, otherwise 0
+    const int offset = me->header_length;
 
-    msg->header.requestCode = UART_REQ_WRITE_AND_READ;
+    if (req[0] != rsp[0]
+    ||  rsp[offset] != (req[offset] | MODBUS_EXCEPTION_FLAG)
+    ||  !ModbusCRC_Check(rsp, MODBUS_EXCEPTION_RSP_LENGTH - MODBUS_RTU_CHECKSUM_LENGTH)) {
+        return 0;
+    }
+    return rsp[offset + 1];
+}
 
-    memcpy(msg->body.writeAndReadReq.writeData, req, (size_t)req_length);
-    msg->body.writeAndReadReq.writeLen = (uint16_t)req_length;
-    msg->body.writeAndReadReq.readLen = MODBUS_RTU_PRESET_READ_RES_LENGTH + (length * 2) + MODBUS_RTU_CHECKSUM_LENGTH;
+// UART_REQ_SCAN_LIST message and its response
+typedef struct ModbusScanListMsg {
+    uint32_t sendMessage[(sizeof(UART_DriverMsgHdr) + sizeof(UART_LineParams) + sizeof(uint16_t) * 2 + MAX_UART_SCAN_LEN) / sizeof(uint32_t)];
+    uint32_t readMessage[(sizeof(uint16_t) * 2 + MAX_UART_SCAN_LEN) / sizeof(uint32_t)];
+    long     sendSize;
+    long     readSize;
+    int      frameCount;
+} ModbusScanListMsg;
+
+// Asynchronous read of ModbusDevRTU_ReadRegistersAsync()
+typedef struct ModbusAsyncRead {
+    ModbusCtx           ctx;        // copy of the requester
+    ModbusReadRequest*  reqs;
+    int                 count;
+    int                 next;       // index of the first request in scanMsg
+    ModbusReadCallback  callback;
+    void*               context;
+    ModbusScanListMsg   scanMsg;
+} ModbusAsyncRead;
+
+// deadline of scan list message (per frame, and for the inter-core transfer)
+#define SCAN_DEADLINE_PER_FRAME_MS 400
+#define SCAN_DEADLINE_MARGIN_MS 1000
 
-    msg->header.messageLen = sizeof(msg->body.writeAndReadReq.writeLen)
-        + sizeof(msg->body.writeAndReadReq.readLen)
-        + msg->body.writeAndReadReq.writeLen;
+static int
+ModbusDevRTU_BuildScanList(ModbusCtx* me, ModbusReadRequest* reqs, int count, ModbusScanListMsg* scanMsg) {
+    // put as many requests as fit in one UART_REQ_SCAN_LIST message
+    UART_DriverMsg* msg = (UART_DriverMsg*)scanMsg->sendMessage;
+    uint8_t* frames = (uint8_t*)msg->body.scanListReq.frames;
+    uint32_t frameOffset = 0;
+    uint32_t resultOffset = 0;
+    int n = 0;
+
+    for (; n < count; n++) {
+        UART_ScanFrame* frame = (UART_ScanFrame*)(frames + frameOffset);
+        int readLen = ModbusDevRTU_GetReadResponseLength(reqs[n].function, reqs[n].length);
+
+        if (frameOffset + UART_SCAN_FRAME_SIZE(MODBUS_RTU_READ_REQ_FRAME_LEN) > MAX_UART_SCAN_LEN
+        ||  resultOffset + UART_SCAN_RESULT_SIZE(readLen) > MAX_UART_SCAN_LEN) {
+            break;
+        }
+        if (reqs[n].frame != NULL) {
+            // prebuilt request frame
+            memcpy(frame->writeData, reqs[n].frame, MODBUS_RTU_READ_REQ_FRAME_LEN);
+            frame->writeLen = MODBUS_RTU_READ_REQ_FRAME_LEN;
+        } else {
+            frame->writeLen = (uint16_t)ModbusRTU_CreateRequestMsg(me,
+                reqs[n].function, reqs[n].regAddr, reqs[n].length, frame->writeData);
+        }
+        frame->readLen = (uint16_t)readLen;
+        frameOffset += UART_SCAN_FRAME_SIZE(frame->writeLen);
+        resultOffset += UART_SCAN_RESULT_SIZE(readLen);
+    }
+    msg->header.requestCode = UART_REQ_SCAN_LIST;
+    msg->header.messageLen = sizeof(UART_LineParams) + sizeof(uint16_t) * 2 + frameOffset;
+    ModbusDevRTU_SetLineParams(me, &msg->body.scanListReq.line);
+    msg->body.scanListReq.frameCount = (uint16_t)n;
+    msg->body.scanListReq.timeoutMs = (uint16_t)me->responseTimeoutMs;
+
+    scanMsg->sendSize = (long)(sizeof(msg->header) + msg->header.messageLen);
+    scanMsg->readSize = (long)(sizeof(uint16_t) * 2 + resultOffset);
+    scanMsg->frameCount = n;
+    memset(scanMsg->readMessage, 0, sizeof(scanMsg->readMessage));
+
+    return n;
+}
 
-    const struct timespec silentInterval = {.tv_sec = 0, .tv_nsec = ModbusDevRTU_CreateInterval(me)};
-    nanosleep(&silentInterval, NULL);
+static int
+ModbusDevRTU_ParseScanList(ModbusCtx* me, ModbusReadRequest* reqs, const ModbusScanListMsg* scanMsg) {
+    // pick up read values of each request
+    const UART_DriverMsg* msg = (const UART_DriverMsg*)scanMsg->sendMessage;
+    const UART_ScanListReturnMsg* retMsg = (const UART_ScanListReturnMsg*)scanMsg->readMessage;
+    const uint8_t* frames = (const uint8_t*)msg->body.scanListReq.frames;
+    const uint8_t* results = (const uint8_t*)retMsg->results;
+    uint32_t frameOffset = 0;
+    uint32_t resultOffset = 0;
+    int n = retMsg->frameCount;
+
+    // RTApp may stop the scan for an urgent request (e.g. write)
+    if (n < 1 || n > scanMsg->frameCount) {
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        const UART_ScanFrame* frame = (const UART_ScanFrame*)(frames + frameOffset);
+        const UART_ScanResult* result = (const UART_ScanResult*)(results + resultOffset);
+        int rc;
 
-    rc = SendRTApp_SendMessageToRTCoreAndReadMessage((const unsigned char*)msg, 
-        (long)(sizeof(msg->header) + msg->header.messageLen),
-        rsp, 
-        msg->body.writeAndReadReq.readLen);
+        if (resultOffset + UART_SCAN_RESULT_SIZE(result->readLen) > MAX_UART_SCAN_LEN) {
+            return -1;
+        }
+        reqs[i].answered = (result->status == UART_SCAN_OK
+            || result->status == UART_SCAN_EXCEPTION
+            || result->status == UART_SCAN_SHORT);
+        reqs[i].elapsedMs = result->elapsedMs;
+        if (result->status == UART_SCAN_EXCEPTION
+        &&  result->readLen == MODBUS_EXCEPTION_RSP_LENGTH) {
+            reqs[i].exception = ModbusRTU_GetExceptionCode(me, frame->writeData, result->readData);
+        } else if (result->status == UART_SCAN_OK && result->readLen == frame->readLen) {
+            rc = ModbusRTU_CheckResponseMsg(me, (uint8_t*)frame->writeData, (uint8_t*)result->readData);
+            if (rc == reqs[i].length) {
+                ModbusRTU_GetReadData(me, result->readData, rc, reqs[i].dst);
+                reqs[i].result = true;
+            }
+        }
+        frameOffset += UART_SCAN_FRAME_SIZE(frame->writeLen);
+        resultOffset += UART_SCAN_RESULT_SIZE(result->readLen);
+    }
 
-    if (rc > 0) {
-        int offset;
-        int i;
+    return n;
+}
 
-        rc = ModbusRTU_CheckResponseMsg(me, req, rsp);
-        if (rc == -1)
+static bool
+ModbusDevRTU_CheckReadRequests(ModbusReadRequest* reqs, int count) {
+    for (int i = 0; i < count; i++) {
+        reqs[i].result = false;
+        reqs[i].exception = 0;
+        reqs[i].answered = false;
+        reqs[i].elapsedMs = 0;
+        if (reqs[i].length < 1 || reqs[i].length > MODBUS_MAX_READ_LENGTH(reqs[i].function)) {
             return false;
+        }
+    }
+    return true;
+}
 
-        offset = me->header_length;
+static int
+ModbusDevRTU_CountSucceeded(const ModbusReadRequest* reqs, int count) {
+    int succeeded = 0;
 
-        for (i = 0; i < rc; i++) {
-            dst[i] = (unsigned short)((rsp[offset + 2 + (i << 1)] << 8) |
-                rsp[offset + 3 + (i << 1)]);
+    for (int i = 0; i < count; i++) {
+        if (reqs[i].result) {
+            succeeded++;
         }
     }
+    return succeeded;
+}
 
-    return rc;
+static bool ModbusDevRTU_SendNextScanList(ModbusAsyncRead* asyncRead);
+
+static void
+ModbusDevRTU_ScanListCallback(void* context, const unsigned char* rxMessage, long rxMessageSize) {
+    ModbusAsyncRead* asyncRead = (ModbusAsyncRead*)context;
+    int n = -1;
+
+    if (rxMessage != NULL) {
+        memcpy(asyncRead->scanMsg.readMessage, rxMessage, (size_t)rxMessageSize);
+        n = ModbusDevRTU_ParseScanList(&asyncRead->ctx,
+            &asyncRead->reqs[asyncRead->next], &asyncRead->scanMsg);
+    }
+    if (n > 0) {
+        asyncRead->next += n;
+        if (asyncRead->next < asyncRead->count
+        &&  ModbusDevRTU_SendNextScanList(asyncRead)) {
+            return;
+        }
+    }
+
+    // all requests are done (or failed)
+    asyncRead->callback(asyncRead->context, asyncRead->reqs, asyncRead->count,
+        ModbusDevRTU_CountSucceeded(asyncRead->reqs, asyncRead->count));
+    free(asyncRead);
+}
+
+static bool
+ModbusDevRTU_SendNextScanList(ModbusAsyncRead* asyncRead) {
+    uint32_t frameTimeoutMs = asyncRead->ctx.responseTimeoutMs;
+    int n;
+
+    n = ModbusDevRTU_BuildScanList(&asyncRead->ctx,
+        &asyncRead->reqs[asyncRead->next], asyncRead->count - asyncRead->next,
+        &asyncRead->scanMsg);
+
+    if (frameTimeoutMs == 0 || frameTimeoutMs > SCAN_DEADLINE_PER_FRAME_MS) {
+        frameTimeoutMs = SCAN_DEADLINE_PER_FRAME_MS;
+    }
+
+    return SendRTApp_SendMessageToRTCoreAsync(
+        (const unsigned char*)asyncRead->scanMsg.sendMessage, asyncRead->scanMsg.sendSize,
+        asyncRead->scanMsg.readSize,
+        (int)(frameTimeoutMs * (uint32_t)n) + SCAN_DEADLINE_MARGIN_MS,
+        ModbusDevRTU_ScanListCallback, asyncRead);
+}
+
+// Read several status/registers in a row asynchronously
+bool
+ModbusDevRTU_ReadRegistersAsync(ModbusCtx* me, ModbusReadRequest* reqs, int count,
+    ModbusReadCallback callback, void* context) {
+    ModbusAsyncRead* asyncRead;
+
+    if (count < 1 || ! ModbusDevRTU_CheckReadRequests(reqs, count)) {
+        return false;
+    }
+    asyncRead = (ModbusAsyncRead*)malloc(sizeof(ModbusAsyncRead));
+    if (asyncRead == NULL) {
+        return false;
+    }
+    asyncRead->ctx = *me;
+    asyncRead->reqs = reqs;
+    asyncRead->count = count;
+    asyncRead->next = 0;
+    asyncRead->callback = callback;
+    asyncRead->context = context;
+    if (! ModbusDevRTU_SendNextScanList(asyncRead)) {
+        free(asyncRead);
+        return false;
+    }
+
+    return true;
 }
 
 // Initialization and cleanup
@@ -224,6 +466,7 @@ ModbusDevRTU_Initialize(int devId, int baud, uint8_t parity, uint8_t stop) {
 
     newObj->header_length = MODBUS_RTU_HEADER_LENGTH;
     newObj->checksum_length = MODBUS_RTU_CHECKSUM_LENGTH;
+    newObj->responseTimeoutMs = 0;
 
     return newObj;
 }
@@ -233,82 +476,522 @@ ModbusDevRTU_Destroy(ModbusCtx* me) {
     free(me);
 }
 
-// Connect
-bool 
-ModbusDevRTU_Connect(ModbusCtx* me) {
-    unsigned char sendMessage[256];
-    unsigned char readMessage;
+// UART line parameters
+static uint32_t
+ModbusDevRTU_MakeLineKey(int baud, uint8_t parity, uint8_t stop) {
+    return ((uint32_t)baud << 4) | ((uint32_t)(parity & 0x03) << 2) | (uint32_t)(stop & 0x03);
+}
+
+uint32_t
+ModbusDevRTU_GetLineKey(ModbusCtx* me) {
+    return ModbusDevRTU_MakeLineKey(me->baud, me->parity, me->stop);
+}
+
+uint32_t
+ModbusDevRTU_GetCurrentLineKey(void) {
+    // unknown while RTApp runs poll schedule
+    return (sLineParams.valid && sPollFrameCount == 0)
+        ? ModbusDevRTU_MakeLineKey(sLineParams.baud, sLineParams.parity, sLineParams.stop)
+        : 0;
+}
+
+uint32_t
+ModbusDevRTU_GetLineReconfigCount(void) {
+    return sLineReconfigCount;
+}
+
+// Poll schedule run by RTApp
+static void ModbusDevRTU_AbortPollSchedule(void);
+
+static void
+ModbusDevRTU_PollConfigCallback(void* context, const unsigned char* rxMessage, long rxMessageSize) {
+    // the download is done when all messages are answered
+    ModbusPollDownload* download = (ModbusPollDownload*)context;
+    int result = 0;
+
+    if (rxMessage != NULL && rxMessageSize >= (long)sizeof(result)) {
+        memcpy(&result, rxMessage, sizeof(result));
+    }
+    if (result != 1) {
+        download->failed = true;
+    }
+    if (--download->remaining > 0) {
+        return;
+    }
+    if (download->gen == sPollDownloadGen) {
+        if (download->failed) {
+            // make sure RTApp does not run a part of the schedule
+            ModbusDevRTU_AbortPollSchedule();
+        }
+        download->callback(download->context, ! download->failed);
+    }
+    free(download);
+}
+
+static bool
+ModbusDevRTU_SendPollConfig(const ModbusPollEntry* entries, int count, uint16_t flags,
+    ModbusPollDownload* download) {
+    uint32_t sendMessage[(sizeof(UART_DriverMsgHdr) + sizeof(uint16_t) * 2 + MAX_UART_SCAN_LEN) / sizeof(uint32_t)];
     UART_DriverMsg* msg = (UART_DriverMsg*)sendMessage;
-    int msgSize;
+    uint8_t* dst = (uint8_t*)msg->body.pollConfigReq.entries;
+    uint32_t entryOffset = 0;
+
+    for (int i = 0; i < count; i++) {
+        UART_PollEntry* entry = (UART_PollEntry*)(dst + entryOffset);
+
+        entry->baudRate = (uint32_t)entries[i].baud;
+        entry->intervalMs = entries[i].intervalMs;
+        entry->parity = entries[i].parity;
+        entry->stop = entries[i].stop;
+        entry->timeoutMs = (uint16_t)entries[i].timeoutMs;
+        entry->writeLen = MODBUS_RTU_READ_REQ_FRAME_LEN;
+        entry->readLen = (uint16_t)ModbusDevRTU_GetReadResponseLength(entries[i].frame[1], entries[i].length);
+        memcpy(entry->writeData, entries[i].frame, MODBUS_RTU_READ_REQ_FRAME_LEN);
+        entryOffset += UART_POLL_ENTRY_SIZE(MODBUS_RTU_READ_REQ_FRAME_LEN);
+    }
+    msg->header.requestCode = UART_REQ_POLL_CONFIG;
+    msg->header.messageLen = sizeof(uint16_t) * 2 + entryOffset;
+    msg->body.pollConfigReq.entryCount = (uint16_t)count;
+    msg->body.pollConfigReq.flags = flags;
+
+    if (! SendRTApp_SendMessageToRTCoreAsync((const unsigned char*)msg,
+        (long)(sizeof(msg->header) + msg->header.messageLen),
+        (long)sizeof(int), SCAN_DEADLINE_MARGIN_MS,
+        ModbusDevRTU_PollConfigCallback, download)) {
+        return false;
+    }
+    download->remaining++;
+
+    return true;
+}
+
+static void
+ModbusDevRTU_AbortPollSchedule(void) {
+    // stop polling (the running schedule is forgotten)
+    ModbusPollDownload* download;
+
+    free(sPollFrames);
+    sPollFrames = NULL;
+    sPollFrameCount = 0;
+    sLineParams.valid = false;
+    download = (ModbusPollDownload*)calloc(1, sizeof(ModbusPollDownload));
+    if (download == NULL) {
+        return;
+    }
+    download->callback = NULL;
+    download->gen = sPollDownloadGen - 1;  // not reported
+    if (! ModbusDevRTU_SendPollConfig(NULL, 0, UART_POLL_CONFIG_START, download)) {
+        free(download);
+    }
+}
 
-    msg->header.requestCode = UART_REQ_SET_PARAMS;
-    msg->header.messageLen = sizeof(UART_MsgSetParams);
-    msg->body.setParams.baudRate = (uint32_t)me->baud;
-    msg->body.setParams.parity = (uint8_t)me->parity;
-    msg->body.setParams.stop = (uint8_t)me->stop;
-    msgSize = (int)(sizeof(msg->header) + msg->header.messageLen);
+static bool
+ModbusDevRTU_IsSamePollSchedule(const ModbusPollEntry* entries, int count) {
+    if (sPollFrames == NULL || count != sPollFrameCount) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        const ModbusPollEntry* cur = &sPollFrames[i].entry;
+
+        if (cur->devId != entries[i].devId
+        ||  cur->baud != entries[i].baud
+        ||  cur->parity != entries[i].parity
+        ||  cur->stop != entries[i].stop
+        ||  cur->timeoutMs != entries[i].timeoutMs
+        ||  cur->intervalMs != entries[i].intervalMs
+        ||  cur->length != entries[i].length
+        ||  0 != memcmp(sPollFrames[i].frame, entries[i].frame, MODBUS_RTU_READ_REQ_FRAME_LEN)) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    SendRTApp_SendMessageToRTCoreAndReadMessage((const unsigned char*)msg, (long)msgSize, &readMessage, sizeof(readMessage));
-    if (readMessage != 1) {
+bool
+ModbusDevRTU_DownloadPollSchedule(const ModbusPollEntry* entries, int count,
+    ModbusPollConfigCallback callback, void* context) {
+    // send the entries by several messages, RTApp starts at the last one
+    // (nothing to send if same as the running schedule), the schedule is
+    // used for the results from now on and forgotten if RTApp fails it
+    const int entriesPerMsg = (int)(MAX_UART_SCAN_LEN / UART_POLL_ENTRY_SIZE(MODBUS_RTU_READ_REQ_FRAME_LEN));
+    ModbusPollFrame* newFrames = NULL;
+    ModbusPollDownload* download;
+    int i = 0;
+
+    if (ModbusDevRTU_IsSamePollSchedule(entries, count)) {
+        callback(context, true);
+        return true;
+    }
+    sPollDownloadGen++;  // the download in progress is superseded
+    if (count > MAX_UART_POLL_ENTRIES) {
+        ModbusDevRTU_AbortPollSchedule();
+        return false;
+    }
+    download = (ModbusPollDownload*)calloc(1, sizeof(ModbusPollDownload));
+    if (count > 0) {
+        newFrames = (ModbusPollFrame*)malloc(sizeof(ModbusPollFrame) * (size_t)count);
+    }
+    if (download == NULL || (count > 0 && newFrames == NULL)) {
+        free(download);
+        free(newFrames);
+        ModbusDevRTU_AbortPollSchedule();
         return false;
     }
+    download->callback = callback;
+    download->context = context;
+    download->gen = sPollDownloadGen;
+
+    free(sPollFrames);
+    for (i = 0; i < count; i++) {
+        newFrames[i].entry = entries[i];
+        memcpy(newFrames[i].frame, entries[i].frame, MODBUS_RTU_READ_REQ_FRAME_LEN);
+        newFrames[i].entry.frame = newFrames[i].frame;
+    }
+    sPollFrames = newFrames;
+    sPollFrameCount = count;
+    sLineParams.valid = false;
+
+    i = 0;
+    do {
+        int n = (count - i < entriesPerMsg) ? count - i : entriesPerMsg;
+        uint16_t flags = (i != 0) ? UART_POLL_CONFIG_APPEND : 0;
+
+        if (i + n == count) {
+            flags |= UART_POLL_CONFIG_START;
+        }
+        if (! ModbusDevRTU_SendPollConfig(&entries[i], n, flags, download)) {
+            // not reported, the messages sent are answered in vain
+            download->gen = sPollDownloadGen - 1;
+            if (download->remaining == 0) {
+                free(download);
+            }
+            ModbusDevRTU_AbortPollSchedule();
+            return false;
+        }
+        i += n;
+    } while (i < count);
+
     return true;
 }
 
-// Write 2byte
+static void
+ModbusDevRTU_PollFetchCallback(void* context, const unsigned char* rxMessage, long rxMessageSize) {
+    // convert the results into ModbusPollResult
+    ModbusPollFetch* fetch = (ModbusPollFetch*)context;
+    const UART_PollFetchReturnMsg* retMsg = (const UART_PollFetchReturnMsg*)rxMessage;
+    ModbusCtx ctx = { .header_length = MODBUS_RTU_HEADER_LENGTH };
+    ModbusPollResult* results = NULL;
+    const uint8_t* curs;
+    uint32_t offset = 0;
+    int count = 0;
+
+    if (rxMessage == NULL
+    ||  rxMessageSize < (long)(sizeof(uint32_t) * 3)) {
+        fetch->callback(fetch->context, NULL, 0, false);
+        free(fetch);
+        return;
+    }
+    if (retMsg->resultCount > 0) {
+        results = (ModbusPollResult*)malloc(sizeof(ModbusPollResult) * retMsg->resultCount);
+        if (results == NULL) {
+            fetch->callback(fetch->context, NULL, 0, false);
+            free(fetch);
+            return;
+        }
+    }
+    curs = (const uint8_t*)retMsg->results;
+    for (int i = 0; i < retMsg->resultCount; i++) {
+        const UART_PollResult* result = (const UART_PollResult*)(curs + offset);
+        ModbusPollResult* dst = &results[count];
+        const ModbusPollFrame* pollFrame;
+
+        if (sizeof(uint32_t) * 3 + offset + UART_POLL_RESULT_SIZE(0) > (uint32_t)rxMessageSize
+        ||  sizeof(uint32_t) * 3 + offset + UART_POLL_RESULT_SIZE(result->readLen) > (uint32_t)rxMessageSize) {
+            break;  // broken message
+        }
+        offset += UART_POLL_RESULT_SIZE(result->readLen);
+        if (result->entryIndex >= sPollFrameCount) {
+            continue;  // result of the previous schedule
+        }
+        pollFrame = &sPollFrames[result->entryIndex];
+
+        memset(&dst->req, 0, sizeof(dst->req));
+        dst->entryIndex = result->entryIndex;
+        dst->ageMs = retMsg->nowMs - result->timestampMs;
+        dst->req.function = pollFrame->frame[1];
+        dst->req.regAddr = (pollFrame->frame[2] << 8) | pollFrame->frame[3];
+        dst->req.length = pollFrame->entry.length;
+        dst->req.dst = dst->values;
+        dst->req.cached = false;
+        dst->req.frame = pollFrame->frame;
+        dst->req.answered = (result->status == UART_SCAN_OK
+            || result->status == UART_SCAN_EXCEPTION
+            || result->status == UART_SCAN_SHORT);
+        dst->req.elapsedMs = result->elapsedMs;
+        if (result->status == UART_SCAN_EXCEPTION
+        &&  result->readLen == MODBUS_EXCEPTION_RSP_LENGTH) {
+            dst->req.exception = ModbusRTU_GetExceptionCode(&ctx, pollFrame->frame, result->readData);
+        } else if (result->status == UART_SCAN_OK
+               &&  result->readLen == ModbusDevRTU_GetReadResponseLength(pollFrame->frame[1], pollFrame->entry.length)) {
+            int rc = ModbusRTU_CheckResponseMsg(&ctx, (uint8_t*)pollFrame->frame, (uint8_t*)result->readData);
+
+            if (rc == pollFrame->entry.length) {
+                ModbusRTU_GetReadData(&ctx, result->readData, rc, dst->values);
+                dst->req.result = true;
+            }
+        }
+        count++;
+    }
+    if (retMsg->dropped != 0) {
+        Log_Debug("WARNING: %lu poll results dropped in RTApp\n", (unsigned long)retMsg->dropped);
+    }
+
+    fetch->callback(fetch->context, results, count, retMsg->remaining != 0);
+    free(results);
+    free(fetch);
+}
+
 bool
-ModbusDevRTU_WriteRegister(ModbusCtx* me, int regAddr, int funcCode, unsigned short value) {
-    int rc;
-    int req_length;
-    uint8_t req[MIN_REQ_LENGTH] = {0};
+ModbusDevRTU_FetchPollResultsAsync(ModbusPollCallback callback, void* context) {
+    UART_DriverMsgHdr msg = { .requestCode = UART_REQ_POLL_FETCH, .messageLen = 0 };
+    ModbusPollFetch* fetch = (ModbusPollFetch*)malloc(sizeof(ModbusPollFetch));
+
+    if (fetch == NULL) {
+        return false;
+    }
+    fetch->callback = callback;
+    fetch->context = context;
+    if (! SendRTApp_SendMessageToRTCoreAsync((const unsigned char*)&msg, sizeof(msg),
+        (long)(sizeof(uint32_t) * 3 + MAX_UART_SCAN_LEN), SCAN_DEADLINE_MARGIN_MS,
+        ModbusDevRTU_PollFetchCallback, fetch)) {
+        free(fetch);
+        return false;
+    }
+
+    return true;
+}
+
+static void
+ModbusDevRTU_StatsCallback(void* context, const unsigned char* rxMessage, long rxMessageSize) {
+    // convert the statistics into ModbusSlaveStats
+    ModbusStatsFetch* fetch = (ModbusStatsFetch*)context;
+    const UART_StatsReturnMsg* retMsg = (const UART_StatsReturnMsg*)rxMessage;
+    ModbusSlaveStats slaves[MAX_UART_STATS_SLAVES];
+    int count;
+
+    if (rxMessage == NULL
+    ||  rxMessageSize < (long)UART_STATS_RETURN_SIZE(0)
+    ||  retMsg->slaveCount > MAX_UART_STATS_SLAVES
+    ||  rxMessageSize < (long)UART_STATS_RETURN_SIZE(retMsg->slaveCount)) {
+        fetch->callback(fetch->context, NULL, 0, 0);
+        free(fetch);
+        return;
+    }
+    count = retMsg->slaveCount;
+    for (int i = 0; i < count; i++) {
+        const UART_SlaveStats* src = &retMsg->slaves[i];
+        ModbusTransStats* dst = &slaves[i].stats;
+
+        slaves[i].devId = src->devId;
+        dst->requestCount = src->requestCount;
+        dst->timeoutCount = src->timeoutCount;
+        dst->shortCount = src->shortCount;
+        dst->exceptionCount = src->exceptionCount;
+        dst->crcErrorCount = src->crcErrorCount;
+        memcpy(dst->latency, src->latency, sizeof(dst->latency));
+    }
+    sLineReconfigCount += retMsg->reconfigCount;
+
+    fetch->callback(fetch->context, slaves, count, retMsg->untracked);
+    free(fetch);
+}
+
+bool
+ModbusDevRTU_FetchStatsAsync(ModbusStatsCallback callback, void* context) {
+    UART_DriverMsgHdr msg = { .requestCode = UART_REQ_GET_STATS, .messageLen = 0 };
+    ModbusStatsFetch* fetch = (ModbusStatsFetch*)malloc(sizeof(ModbusStatsFetch));
+
+    if (fetch == NULL) {
+        return false;
+    }
+    fetch->callback = callback;
+    fetch->context = context;
+    if (! SendRTApp_SendMessageToRTCoreAsync((const unsigned char*)&msg, sizeof(msg),
+        (long)sizeof(UART_StatsReturnMsg), SCAN_DEADLINE_MARGIN_MS,
+        ModbusDevRTU_StatsCallback, fetch)) {
+        free(fetch);
+        return false;
+    }
+
+    return true;
+}
+
+void
+ModbusDevRTU_FillPollEntry(ModbusCtx* me, ModbusPollEntry* entry) {
+    entry->devId = me->devId;
+    entry->baud = me->baud;
+    entry->parity = me->parity;
+    entry->stop = me->stop;
+}
+
+static int
+ModbusDevRTU_BuildWriteMultipleFrame(ModbusCtx* me, int regAddr, int funcCode,
+    const unsigned short* values, int count, uint8_t* req) {
+    // request frame of FC15/FC16 into req (MAX_UART_WRITE_LEN),
+    // returns its length (0 if invalid)
+    int byteCount;
+
+    if (funcCode == FC_WRITE_MULTIPLE_COILS) {
+        if (count < 1 || count > MODBUS_MAX_WRITE_COILS) {
+            return 0;
+        }
+        byteCount = (count + 7) / 8;
+    } else if (funcCode == FC_WRITE_MULTIPLE_REGISTERS) {
+        if (count < 1 || count > MODBUS_MAX_WRITE_REGISTERS) {
+            return 0;
+        }
+        byteCount = count * 2;
+    } else {
+        return 0;
+    }
+
+    // address, function, register, count, byte count, values and CRC
+    (void)ModbusRTU_CreateRequestMsg(me, funcCode, regAddr, count, req);
+    memset(&req[MODBUS_RTU_PRESET_READ_REQ_LENGTH], 0, MAX_UART_WRITE_LEN - MODBUS_RTU_PRESET_READ_REQ_LENGTH);
+    req[MODBUS_RTU_PRESET_READ_REQ_LENGTH] = (uint8_t)byteCount;
+    for (int i = 0; i < count; i++) {
+        uint8_t* data = &req[MODBUS_RTU_PRESET_READ_REQ_LENGTH + 1];
+
+        if (funcCode == FC_WRITE_MULTIPLE_COILS) {
+            if (values[i] != 0) {
+                data[i >> 3] |= (uint8_t)(1 << (i & 7));
+            }
+        } else {
+            data[i << 1] = (uint8_t)(values[i] >> 8);
+            data[(i << 1) + 1] = (uint8_t)(values[i] & 0x00ff);
+        }
+    }
+    return ModbusCRC_Append(req, MODBUS_RTU_PRESET_READ_REQ_LENGTH + 1 + byteCount);
+}
+
+// Asynchronous write of ModbusDevRTU_WriteRegistersAsync()
+typedef struct ModbusAsyncWrite {
+    ModbusCtx           ctx;        // copy of the requester
+    uint8_t             req[MAX_UART_WRITE_LEN];
+    ModbusWriteDoneCallback callback;
+    void*               context;
+} ModbusAsyncWrite;
+
+static void
+ModbusDevRTU_WriteCallback(void* context, const unsigned char* rxMessage, long rxMessageSize) {
+    ModbusAsyncWrite* asyncWrite = (ModbusAsyncWrite*)context;
     uint8_t rsp[MAX_MESSAGE_LENGTH] = {0};
-    unsigned char sendMessage[MAX_MESSAGE_LENGTH];
+    uint8_t exception = 0;
+    int rc = 0;
+
+    if (rxMessage != NULL) {
+        memcpy(rsp, rxMessage, (size_t)rxMessageSize);
+        rc = ModbusRTU_CheckResponseMsg(&asyncWrite->ctx, asyncWrite->req, rsp);
+        if (rc == -1) {
+            exception = ModbusRTU_GetExceptionCode(&asyncWrite->ctx, asyncWrite->req, rsp);
+        }
+    }
+    asyncWrite->callback(asyncWrite->context, rc > 0, exception);
+    free(asyncWrite);
+}
+
+// Write coils/registers asynchronously (FC05/FC06/FC15/FC16)
+bool
+ModbusDevRTU_WriteRegistersAsync(ModbusCtx* me, int regAddr, int funcCode,
+    const unsigned short* values, int count, ModbusWriteDoneCallback callback, void* context) {
+    uint32_t sendMessage[(sizeof(UART_DriverMsgHdr) + sizeof(UART_LineParams) + sizeof(uint16_t) * 2 + MAX_UART_WRITE_LEN) / sizeof(uint32_t)];
     UART_DriverMsg* msg = (UART_DriverMsg*)sendMessage;
+    ModbusAsyncWrite* asyncWrite;
+    int req_length;
 
-    req_length = ModbusRTU_CreateRequestMsg(me, funcCode, regAddr, (int)value, req);
+    asyncWrite = (ModbusAsyncWrite*)calloc(1, sizeof(ModbusAsyncWrite));
+    if (asyncWrite == NULL) {
+        return false;
+    }
+    asyncWrite->ctx = *me;
+    asyncWrite->callback = callback;
+    asyncWrite->context = context;
+    if (funcCode == FC_WRITE_FORCE_SINGLE_COIL || funcCode == FC_WRITE_SINGLE_REGISTER) {
+        req_length = (count == 1)
+            ? ModbusRTU_CreateRequestMsg(me, funcCode, regAddr, (int)values[0], asyncWrite->req)
+            : 0;
+    } else {
+        req_length = ModbusDevRTU_BuildWriteMultipleFrame(me, regAddr, funcCode,
+            values, count, asyncWrite->req);
+    }
+    if (req_length == 0) {
+        free(asyncWrite);
+        return false;
+    }
 
     msg->header.requestCode = UART_REQ_WRITE_AND_READ;
-
-    memcpy(msg->body.writeAndReadReq.writeData, req, (size_t)req_length);
+    memcpy(msg->body.writeAndReadReq.writeData, asyncWrite->req, (size_t)req_length);
     msg->body.writeAndReadReq.writeLen = (uint16_t)req_length;
     msg->body.writeAndReadReq.readLen = MODBUS_RTU_PRESET_WRITE_REQ_LENGTH + MODBUS_RTU_DATA_WRITE_REQ_LENGTH + MODBUS_RTU_CHECKSUM_LENGTH;
-    msg->header.messageLen = sizeof(msg->body.writeAndReadReq.writeLen)
+    ModbusDevRTU_SetLineParams(me, &msg->body.writeAndReadReq.line);
+    msg->header.messageLen = sizeof(msg->body.writeAndReadReq.line)
+        + sizeof(msg->body.writeAndReadReq.writeLen)
         + sizeof(msg->body.writeAndReadReq.readLen)
         + msg->body.writeAndReadReq.writeLen;
 
-    const struct timespec silentInterval = {.tv_sec = 0, .tv_nsec = ModbusDevRTU_CreateInterval(me)};
-    nanosleep(&silentInterval, NULL);
-
-    rc = SendRTApp_SendMessageToRTCoreAndReadMessage((const unsigned char*)msg, 
+    if (! SendRTApp_SendUrgentMessageToRTCoreAsync((const unsigned char*)msg,
         (long)(sizeof(msg->header) + msg->header.messageLen),
-        rsp, 
-        msg->body.writeAndReadReq.readLen);
-
-    if (rc > 0) {
-        rc = ModbusRTU_CheckResponseMsg(me, req, rsp);
-        if (rc == -1)
-            return false;
+        msg->body.writeAndReadReq.readLen,
+        SCAN_DEADLINE_PER_FRAME_MS + SCAN_DEADLINE_MARGIN_MS,
+        ModbusDevRTU_WriteCallback, asyncWrite)) {
+        free(asyncWrite);
+        return false;
     }
-    return rc;
+
+    return true;
+}
+
+// Response timeout of ModbusDevRTU_ReadRegisters()
+void
+ModbusDevRTU_SetResponseTimeout(ModbusCtx* me, uint32_t timeoutMs) {
+    me->responseTimeoutMs = timeoutMs;
 }
 
 // Get RTApp Version
+static void
+ModbusDevRTU_VersionCallback(void* context, const unsigned char* rxMessage, long rxMessageSize) {
+    ModbusVersionFetch* fetch = (ModbusVersionFetch*)context;
+    UART_ReturnMsg retMsg;
+
+    if (rxMessage == NULL || rxMessageSize < (long)(sizeof(uint32_t) * 2)) {
+        fetch->callback(fetch->context, NULL);
+        free(fetch);
+        return;
+    }
+    memset(&retMsg, 0, sizeof(retMsg));
+    memcpy(&retMsg, rxMessage, (size_t)rxMessageSize);
+    retMsg.message.version[sizeof(retMsg.message.version) - 1] = '\0';
+
+    fetch->callback(fetch->context, retMsg.message.version);
+    free(fetch);
+}
+
 bool
-ModbusDevRTU_GetRTAppVersion(char* rtAppVersion) {
-    unsigned char sendMessage[256];
-    unsigned char readMessage[272];
-    UART_DriverMsg* msg = (UART_DriverMsg*)sendMessage;
-    UART_ReturnMsg* retMsg = (UART_ReturnMsg*)readMessage;
-    int msgSize;
-    bool ret = false;
-
-    memset(msg, 0, sizeof(UART_DriverMsg));
-    msg->header.requestCode = UART_REQ_VERSION;
-    msg->header.messageLen = 0;
-    msgSize = (int)(sizeof(msg->header) + msg->header.messageLen);
-    ret = SendRTApp_SendMessageToRTCoreAndReadMessage((const unsigned char*)msg, msgSize,
-        (unsigned char*)retMsg, sizeof(UART_ReturnMsg));
-    strncpy(rtAppVersion, retMsg->message.version, retMsg->messageLen);
-
-    return ret;
+ModbusDevRTU_GetRTAppVersionAsync(ModbusVersionCallback callback, void* context) {
+    UART_DriverMsgHdr msg = { .requestCode = UART_REQ_VERSION, .messageLen = 0 };
+    ModbusVersionFetch* fetch = (ModbusVersionFetch*)malloc(sizeof(ModbusVersionFetch));
+
+    if (fetch == NULL) {
+        return false;
+    }
+    fetch->callback = callback;
+    fetch->context = context;
+    if (! SendRTApp_SendMessageToRTCoreAsync((const unsigned char*)&msg, sizeof(msg),
+        (long)sizeof(UART_ReturnMsg), SCAN_DEADLINE_MARGIN_MS,
+        ModbusDevRTU_VersionCallback, fetch)) {
+        free(fetch);
+        return false;
+    }
+
+    return true;
 }
@@ -28,21 +28,136 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "ModbusDevConfig.h"
+
 typedef struct ModbusCtx ModbusCtx;
 
+// length of read request frame (address, function, register, count and CRC)
+#define MODBUS_RTU_READ_REQ_FRAME_LEN 8
+
+// read request for ModbusDevRTU_ReadRegistersAsync()
+typedef struct ModbusReadRequest {
+    int             regAddr;   // first register address
+    int             function;  // function code
+    int             length;    // read register count (bit count for FC01/FC02)
+    unsigned short* dst;       // buffer for read values (length, bits are packed LSB first)
+    const uint8_t*  frame;     // prebuilt request frame (NULL if not built)
+    bool            result;    // true if read successfully
+    uint8_t         exception; // exception code (0 if no exception response)
+    bool            answered;  // true if the slave responded (even if invalid)
+    uint16_t        elapsedMs; // response time [msec]
+    bool            cached;    // answered from the register snapshot (not read)
+} ModbusReadRequest;
+
+// entry of poll schedule run by RTApp
+typedef struct ModbusPollEntry {
+    int             devId;      // slave device ID
+    int             baud;       // UART line parameters of the slave
+    uint8_t         parity;
+    uint8_t         stop;
+    uint32_t        timeoutMs;  // response timeout [msec] (0: RTApp default)
+    uint32_t        intervalMs; // polling interval [msec]
+    int             length;     // read register/bit count
+    const uint8_t*  frame;      // prebuilt read request frame
+} ModbusPollEntry;
+
+// result of poll schedule
+typedef struct ModbusPollResult {
+    int                 entryIndex; // index of ModbusPollEntry
+    uint32_t            ageMs;      // time since the response [msec]
+    ModbusReadRequest   req;        // result of the request (req.dst is values)
+    unsigned short      values[MODBUS_MAX_READ_REGISTERS];
+} ModbusPollResult;
+
+// completion callback of ModbusDevRTU_FetchPollResultsAsync()
+//   results is NULL if failed, hasMore is true if RTApp holds more results
+typedef void (*ModbusPollCallback)(void* context, ModbusPollResult* results, int count, bool hasMore);
+
+// completion callback of ModbusDevRTU_ReadRegistersAsync()
+typedef void (*ModbusReadCallback)(void* context, ModbusReadRequest* reqs, int count, int succeeded);
+
+// completion callback of ModbusDevRTU_WriteRegistersAsync()
+//   exception is the exception code if the slave answered so (0 if not)
+typedef void (*ModbusWriteDoneCallback)(void* context, bool result, uint8_t exception);
+
+// completion callback of ModbusDevRTU_DownloadPollSchedule()
+typedef void (*ModbusPollConfigCallback)(void* context, bool result);
+
+// completion callback of ModbusDevRTU_GetRTAppVersionAsync()
+//   rtAppVersion is NULL if failed
+typedef void (*ModbusVersionCallback)(void* context, const char* rtAppVersion);
+
+// transaction statistics measured by RTApp
+#define MODBUS_LATENCY_BINS 8
+typedef struct ModbusTransStats {
+    uint32_t        requestCount;
+    uint32_t        timeoutCount;   // no response
+    uint32_t        shortCount;     // response shorter than expected
+    uint32_t        exceptionCount; // exception response
+    uint32_t        crcErrorCount;  // response with CRC error
+    uint32_t        latency[MODBUS_LATENCY_BINS];  // histogram of response time
+} ModbusTransStats;
+
+// transaction statistics of a slave
+typedef struct ModbusSlaveStats {
+    int                 devId;
+    ModbusTransStats    stats;
+} ModbusSlaveStats;
+
+// upper bound of each bin of the histogram [msec] (the last bin has no bound)
+extern const uint16_t ModbusDevRTU_LatencyLimitsMs[MODBUS_LATENCY_BINS - 1];
+
+// completion callback of ModbusDevRTU_FetchStatsAsync()
+//   slaves is NULL if failed, untracked is count of requests not counted per slave
+typedef void (*ModbusStatsCallback)(void* context, const ModbusSlaveStats* slaves, int count,
+    uint32_t untracked);
+
+// Build read request frame (returns MODBUS_RTU_READ_REQ_FRAME_LEN)
+extern int ModbusDevRTU_BuildRequestFrame(int devId, int function, int addr, int length, uint8_t* frame);
+
+// Length of read response frame
+extern int ModbusDevRTU_GetReadResponseLength(int function, int length);
+
 // Initialization and cleanup
 extern ModbusCtx* ModbusDevRTU_Initialize(int devId, int baud, uint8_t parity, uint8_t stop);
 extern void ModbusDevRTU_Destroy(ModbusCtx* me);
 
-// Connect
-extern bool ModbusDevRTU_Connect(ModbusCtx* me);
+// UART line parameters
+//   slaves of the same key share the line setting, current key is 0 if
+//   not set (or changed by RTApp), count is of the UART reprogramming
+//   reported by RTApp with the statistics (ModbusDevRTU_FetchStatsAsync())
+extern uint32_t ModbusDevRTU_GetLineKey(ModbusCtx* me);
+extern uint32_t ModbusDevRTU_GetCurrentLineKey(void);
+extern uint32_t ModbusDevRTU_GetLineReconfigCount(void);
+
+// Read several status/registers in a row asynchronously
+//   callback is called when all requests are done (reqs must be kept until then),
+//   the line parameters are set by queued request (not connected beforehand)
+extern bool ModbusDevRTU_ReadRegistersAsync(ModbusCtx* me, ModbusReadRequest* reqs, int count,
+    ModbusReadCallback callback, void* context);
+
+// Poll schedule run by RTApp
+//   download replaces the schedule (stops polling if count is 0), callback
+//   is called when RTApp accepted it or not (not called if superseded),
+//   RTApp stops polling if it failed
+extern bool ModbusDevRTU_DownloadPollSchedule(const ModbusPollEntry* entries, int count,
+    ModbusPollConfigCallback callback, void* context);
+extern bool ModbusDevRTU_FetchPollResultsAsync(ModbusPollCallback callback, void* context);
+extern void ModbusDevRTU_FillPollEntry(ModbusCtx* me, ModbusPollEntry* entry);
+
+// Take out transaction statistics counted by RTApp since the previous fetch
+extern bool ModbusDevRTU_FetchStatsAsync(ModbusStatsCallback callback, void* context);
 
-// Read status/register
-extern bool ModbusDevRTU_ReadRegister(ModbusCtx* me, int regAddr, int function, unsigned short* dst, int length);
+// Write coils/registers asynchronously (FC05/FC06 with count 1, FC15/FC16)
+//   values of coils are 0 (OFF) or not 0 (ON) for FC15
+//   sent ahead of the queued reads (RTApp cuts the scan in progress short),
+//   callback is called when done
+extern bool ModbusDevRTU_WriteRegistersAsync(ModbusCtx* me, int regAddr, int funcCode,
+    const unsigned short* values, int count, ModbusWriteDoneCallback callback, void* context);
 
-// Write 2byte
-extern bool ModbusDevRTU_WriteRegister(ModbusCtx* me, int regAddr, int funcCode, unsigned short value);
+// Response timeout of ModbusDevRTU_ReadRegistersAsync() (0: RTApp default)
+extern void ModbusDevRTU_SetResponseTimeout(ModbusCtx* me, uint32_t timeoutMs);
 
-// Get RTApp Version
-extern bool ModbusDevRTU_GetRTAppVersion(char* rtAppVersion);
+// Get RTApp Version asynchronously
+extern bool ModbusDevRTU_GetRTAppVersionAsync(ModbusVersionCallback callback, void* context);
 #endif  // _MODBUS_DEV_RTU_H_
@@ -0,0 +1,225 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "ModbusDiagnostics.h"
+
+#include <string.h>
+
+#include <applibs/eventloop.h>
+#include <applibs/log.h>
+
+#include "eventloop_timer_utilities.h"
+#include "LibCloud.h"
+#include "LibModbus.h"
+#include "ModbusDevHealth.h"
+#include "StringBuf.h"
+
+#define MODBUS_STATS_FETCH_SEC      10     // interval to take out the statistics from RTApp
+#define MODBUS_DIAG_MAX_INTERVAL    86400  // [sec]
+
+static const char DiagIntervalKey[] = "diagInterval";
+
+static struct {
+    // configuration
+    uint32_t	intervalSec;    // interval of the telemetry (0: not sent)
+
+    bool	isConfigured;       // ModbusDevConfig is loaded
+
+    EventLoop*	eventLoop;
+    EventLoopTimer*	timer;      // armed only while configured
+    uint32_t	elapsedSec;     // time since the last telemetry
+    bool	isFetching;         // waiting for the statistics from RTApp
+    ModbusTransStats	busStats;   // transactions of all the slaves
+    uint32_t	untracked;      // requests not counted per slave by RTApp
+} sDiag = { .intervalSec = 0, .isConfigured = false,
+    .eventLoop = NULL, .timer = NULL, .elapsedSec = 0, .isFetching = false };
+
+static void
+ModbusDiagnostics_SendTelemetry(void)
+{
+    StringBuf*	sb;
+    uint32_t	timeStamp;
+
+    if (! IoT_CentralLib_CheckConnection()) {
+        return;  // not cached, the next one has the accumulated counts
+    }
+    sb = StringBuf_New();
+    if (NULL == sb) {
+        return;
+    }
+    StringBuf_Append(sb, "{\"ModbusDiagnostics\":");
+    ModbusDiagnostics_AppendJSONString(sb);
+    StringBuf_AppendChar(sb, '}');
+    if (! IoT_CentralLib_SendTelemetry(StringBuf_GetStr(sb), &timeStamp)) {
+        Log_Debug("WARNING: failed to send Modbus diagnostics\n");
+    }
+    StringBuf_Destroy(sb);
+}
+
+static void
+ModbusDiagnostics_StatsCallback(void* context,
+    const ModbusSlaveStats* slaves, int count, uint32_t untracked)
+{
+    // accumulate, the statistics of RTApp are cleared when taken out
+    sDiag.isFetching = false;
+    if (NULL != slaves) {
+        for (int i = 0; i < count; i++) {
+            ModbusTransStats_Add(&sDiag.busStats, &slaves[i].stats);
+            (void)Libmodbus_AddStats(slaves[i].devId, &slaves[i].stats);
+        }
+        sDiag.untracked += untracked;
+    }
+
+    if (0 != sDiag.intervalSec && sDiag.elapsedSec >= sDiag.intervalSec) {
+        sDiag.elapsedSec = 0;
+        ModbusDiagnostics_SendTelemetry();
+    }
+}
+
+static void
+ModbusDiagnostics_TimerHandler(EventLoopTimer* timer)
+{
+    if (ConsumeEventLoopTimerEvent(timer) != 0) {
+        return;
+    }
+
+    sDiag.elapsedSec += MODBUS_STATS_FETCH_SEC;
+    if (sDiag.isFetching) {
+        return;  // RTApp has not answered yet
+    }
+    sDiag.isFetching = true;
+    if (! Libmodbus_FetchStatsAsync(ModbusDiagnostics_StatsCallback, NULL)) {
+        sDiag.isFetching = false;
+    }
+}
+
+static bool
+ModbusDiagnostics_StartTimer(void)
+{
+    // RTApp is not asked without the slaves to be counted
+    struct timespec	period = { .tv_sec = MODBUS_STATS_FETCH_SEC, .tv_nsec = 0 };
+
+    if (NULL != sDiag.timer || NULL == sDiag.eventLoop || ! sDiag.isConfigured) {
+        return true;
+    }
+    sDiag.timer = CreateEventLoopPeriodicTimer(sDiag.eventLoop,
+        ModbusDiagnostics_TimerHandler, &period);
+
+    return NULL != sDiag.timer;
+}
+
+static void
+ModbusDiagnostics_StopTimer(void)
+{
+    DisposeEventLoopTimer(sDiag.timer);
+    sDiag.timer = NULL;
+}
+
+// Start/stop collecting in the event loop
+bool
+ModbusDiagnostics_RegisterEventLoop(EventLoop* eventLoop)
+{
+    sDiag.eventLoop = eventLoop;
+
+    return ModbusDiagnostics_StartTimer();
+}
+
+void
+ModbusDiagnostics_UnregisterEventLoop(void)
+{
+    ModbusDiagnostics_StopTimer();
+    sDiag.eventLoop = NULL;
+}
+
+// Apply "diagInterval" of ModbusDevConfig
+bool
+ModbusDiagnostics_LoadFromJSON(const json_value* json)
+{
+    uint32_t	intervalSec = 0;
+    bool	ret = true;
+
+    if (json != NULL && json->type == json_object) {
+        for (unsigned int i = 0, n = json->u.object.length; i < n; ++i) {
+            if (0 == strcmp(DiagIntervalKey, json->u.object.values[i].name)) {
+                if (! json_GetNumericValue(json->u.object.values[i].value, &intervalSec, 10)
+                ||  intervalSec > MODBUS_DIAG_MAX_INTERVAL) {
+                    intervalSec = 0;
+                    ret = false;
+                }
+                break;
+            }
+        }
+    }
+    sDiag.intervalSec = intervalSec;
+    sDiag.elapsedSec  = 0;
+
+    sDiag.isConfigured = (NULL != json);
+    if (sDiag.isConfigured) {
+        if (! ModbusDiagnostics_StartTimer()) {
+            Log_Debug("WARNING: Modbus diagnostics is not collected.\n");
+        }
+    } else {
+        ModbusDiagnostics_StopTimer();
+    }
+
+    return ret;
+}
+
+// Append the statistics as JSON object
+void
+ModbusDiagnostics_AppendJSON(StringBuf* sb)
+{
+    // histogram bins are of ModbusDevRTU_LatencyLimitsMs
+    StringBuf_Append(sb, "{\"latencyLimits\":[");
+    for (int i = 0; i < MODBUS_LATENCY_BINS - 1; i++) {
+        StringBuf_AppendByPrintf(sb, (i == 0) ? "%u" : ",%u",
+            (unsigned int)ModbusDevRTU_LatencyLimitsMs[i]);
+    }
+    StringBuf_Append(sb, "],\"bus\":{");
+    ModbusTransStats_AppendJSON(&sDiag.busStats, sb);
+    StringBuf_AppendByPrintf(sb, ",\"untracked\":%lu,\"reconfig\":%lu},\"slaves\":",
+        (unsigned long)sDiag.untracked, (unsigned long)Libmodbus_GetLineReconfigCount());
+    Libmodbus_AppendStatsJSON(sb);
+    StringBuf_AppendChar(sb, '}');
+}
+
+void
+ModbusDiagnostics_AppendJSONString(StringBuf* sb)
+{
+    StringBuf*	json = StringBuf_New();
+    const char*	curs;
+
+    StringBuf_AppendChar(sb, '"');
+    if (NULL != json) {
+        ModbusDiagnostics_AppendJSON(json);
+        for (curs = StringBuf_GetStr(json); *curs != '\0'; curs++) {
+            if (*curs == '"') {
+                StringBuf_AppendChar(sb, '\\');
+            }
+            StringBuf_AppendChar(sb, *curs);
+        }
+        StringBuf_Destroy(json);
+    }
+    StringBuf_AppendChar(sb, '"');
+}
@@ -0,0 +1,57 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _MODBUS_DIAGNOSTICS_H_
+#define _MODBUS_DIAGNOSTICS_H_
+
+#ifndef _STDBOOL_H
+#include <stdbool.h>
+#endif
+
+#include "json.h"
+
+typedef struct EventLoop	EventLoop;
+typedef struct StringBuf	StringBuf;
+
+// Modbus RTU bus diagnostics
+//   transaction statistics counted by RTApp are taken out periodically
+//   and accumulated per slave and for the whole bus
+
+// Start/stop collecting in the event loop
+//   statistics are taken out only while ModbusDevConfig is loaded
+extern bool	ModbusDiagnostics_RegisterEventLoop(EventLoop* eventLoop);
+extern void	ModbusDiagnostics_UnregisterEventLoop(void);
+
+// Apply "diagInterval" [sec] of ModbusDevConfig
+//   statistics are sent as "ModbusDiagnostics" telemetry at this
+//   interval (0 or not present: not sent), json is NULL if
+//   ModbusDevConfig is removed
+extern bool	ModbusDiagnostics_LoadFromJSON(const json_value* json);
+
+// Append the statistics as JSON object, or as a string of it
+//   (quoted, for the string schema of the telemetry and the direct method)
+extern void	ModbusDiagnostics_AppendJSON(StringBuf* sb);
+extern void	ModbusDiagnostics_AppendJSONString(StringBuf* sb);
+
+#endif  // _MODBUS_DIAGNOSTICS_H_
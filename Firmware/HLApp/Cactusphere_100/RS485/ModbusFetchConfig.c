@@ -50,6 +50,15 @@ const char MultiplylKey[]               = "multiply";
 const char DeviderKey[]                 = "devider";
 const char AsFloatKey[]                 = "asFloat";
 const char AsLittleKey[]                = "asLittle";
+const char DataTypeKey[]                = "dataType";
+const char WordSwapKey[]                = "wordSwap";
+const char ByteSwapKey[]                = "byteSwap";
+const char BitOffsetKey[]               = "bitOffset";
+const char BitLengthKey[]               = "bitLength";
+const char DeadbandKey[]                = "deadband";
+const char DeadbandPercentKey[]         = "deadbandPercent";
+const char ReportOnChangeKey[]          = "reportOnChange";
+const char MaxSilenceKey[]              = "maxSilence";
 
 #define SET_TELEMETRYCONF_DEVID    0x01
 #define SET_TELEMETRYCONF_REGADDR  0x02
@@ -58,6 +67,27 @@ const char AsLittleKey[]                = "asLittle";
 #define SET_TELEMETRYCONF_INTERVAL 0x10
 #define SET_TELEMETRYCONF_REQUIRED 0x1F
 
+static bool
+GetDoubleValue(const json_value* item, double* outValue)
+{
+    // number or numeric string
+    char*	endPtr;
+
+    switch (item->type) {
+    case json_integer:
+        *outValue = (double)item->u.integer;
+        return true;
+    case json_double:
+        *outValue = item->u.dbl;
+        return true;
+    case json_string:
+        *outValue = strtod(item->u.string.ptr, &endPtr);
+        return (endPtr != item->u.string.ptr && *endPtr == '\0');
+    default:
+        return false;
+    }
+}
+
 // Initialization and cleanup
 ModbusFetchConfig*
 ModbusFetchConfig_New(void)
@@ -129,6 +159,10 @@ ModbusFetchConfig_LoadFromJSON(ModbusFetchConfig* me,
     for (unsigned int i = 0, n = configJson->u.object.length; i < n; ++i) {
         ModbusFetchItem pseudo;
         int setFlag = 0;
+        ModbusDataType dataType = MODBUS_TYPE_COUNT;
+        bool byteSwap = false;
+        uint32_t bitOffset = 0;
+        uint32_t bitLength = 0;
         json_value* configItem = configJson->u.object.values[i].value;
         size_t	strLen = strlen(configJson->u.object.values[i].name);
 
@@ -148,6 +182,7 @@ ModbusFetchConfig_LoadFromJSON(ModbusFetchConfig* me,
         pseudo.devider = 0;
         pseudo.asFloat = false;
         pseudo.asLittle = false;
+        ModbusReportPolicy_Init(&pseudo.report);
 
         for (unsigned int p = 0, q = configItem->u.object.length; p < q; ++p) {
             if (0 == strcmp(configItem->u.object.values[p].name, DevIDKey)) {
@@ -169,7 +204,8 @@ ModbusFetchConfig_LoadFromJSON(ModbusFetchConfig* me,
             } else if (0 == strcmp(configItem->u.object.values[p].name, RegisterCountKey)) {
                 json_value* item = configItem->u.object.values[p].value;
                 bool ret_parse = json_GetNumericValue(item, &pseudo.regCount, 16);
-                if (!ret_parse || pseudo.regCount < 1 || pseudo.regCount > 2) {
+                if (!ret_parse || pseudo.regCount < 1 || pseudo.regCount > 4
+                ||  pseudo.regCount == 3) {
                     ret = false;
                 } else {
                     setFlag += SET_TELEMETRYCONF_REGCNT;
@@ -182,6 +218,8 @@ ModbusFetchConfig_LoadFromJSON(ModbusFetchConfig* me,
                 } else {
                     switch (pseudo.funcCode)
                     {
+                    case FC_READ_COILS:
+                    case FC_READ_DISCRETE_INPUTS:
                     case FC_READ_HOLDING_REGISTER:
                     case FC_READ_INPUT_REGISTERS:
                         setFlag += SET_TELEMETRYCONF_FUNCCODE;
@@ -214,13 +252,97 @@ ModbusFetchConfig_LoadFromJSON(ModbusFetchConfig* me,
             } else if (0 == strcmp(configItem->u.object.values[p].name, AsFloatKey)) {
                 json_value* item = configItem->u.object.values[p].value;
                 pseudo.asFloat = item->u.boolean;
-            } else if (0 == strcmp(configItem->u.object.values[p].name, AsLittleKey)) {
+            } else if (0 == strcmp(configItem->u.object.values[p].name, AsLittleKey)
+                   ||  0 == strcmp(configItem->u.object.values[p].name, WordSwapKey)) {
                 json_value* item = configItem->u.object.values[p].value;
                 pseudo.asLittle = item->u.boolean;
+            } else if (0 == strcmp(configItem->u.object.values[p].name, ByteSwapKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+                byteSwap = item->u.boolean;
+            } else if (0 == strcmp(configItem->u.object.values[p].name, DataTypeKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+                if (item->type == json_string) {
+                    dataType = ModbusDecode_GetDataType(item->u.string.ptr);
+                }
+                if (dataType == MODBUS_TYPE_COUNT) {
+                    ret = false;
+                }
+            } else if (0 == strcmp(configItem->u.object.values[p].name, BitOffsetKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+                if (!json_GetNumericValue(item, &bitOffset, 10)) {
+                    ret = false;
+                }
+            } else if (0 == strcmp(configItem->u.object.values[p].name, BitLengthKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+                if (!json_GetNumericValue(item, &bitLength, 10)) {
+                    ret = false;
+                }
+            } else if (0 == strcmp(configItem->u.object.values[p].name, DeadbandKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+                if (!GetDoubleValue(item, &pseudo.report.deadband)
+                ||  pseudo.report.deadband < 0) {
+                    pseudo.report.deadband = 0;
+                    ret = false;
+                }
+            } else if (0 == strcmp(configItem->u.object.values[p].name, DeadbandPercentKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+                if (!GetDoubleValue(item, &pseudo.report.deadbandPercent)
+                ||  pseudo.report.deadbandPercent < 0) {
+                    pseudo.report.deadbandPercent = 0;
+                    ret = false;
+                }
+            } else if (0 == strcmp(configItem->u.object.values[p].name, ReportOnChangeKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+                pseudo.report.onChange = item->u.boolean;
+            } else if (0 == strcmp(configItem->u.object.values[p].name, MaxSilenceKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+                if (!json_GetNumericValue(item, &pseudo.report.maxSilenceSec, 10)) {
+                    ret = false;
+                }
+            }
+        }
+
+        // compile the value decoder; without dataType the register count
+        // selects unsigned 16/32/64 bit as before, with dataType the
+        // register count follows the type (a coil/discrete input is one bit
+        // and reported as 0 or 1)
+        if ((setFlag & SET_TELEMETRYCONF_FUNCCODE)
+        &&  MODBUS_IS_BIT_READ(pseudo.funcCode)) {
+            if (dataType != MODBUS_TYPE_COUNT
+            ||  ((setFlag & SET_TELEMETRYCONF_REGCNT) && pseudo.regCount != 1)) {
+                setFlag &= ~SET_TELEMETRYCONF_REGCNT;  // not a bit
+            } else if (!(setFlag & SET_TELEMETRYCONF_REGCNT)) {
+                pseudo.regCount = 1;
+                setFlag += SET_TELEMETRYCONF_REGCNT;
+            }
+            dataType = MODBUS_TYPE_UINT16;
+        } else if (dataType == MODBUS_TYPE_COUNT) {
+            if (setFlag & SET_TELEMETRYCONF_REGCNT) {
+                dataType = (pseudo.regCount == 1) ? MODBUS_TYPE_UINT16
+                         : (pseudo.regCount == 2) ? MODBUS_TYPE_UINT32
+                         : MODBUS_TYPE_UINT64;
+            }
+        } else if (!(setFlag & SET_TELEMETRYCONF_REGCNT)) {
+            pseudo.regCount = ModbusDecode_GetWordCount(dataType);
+            setFlag += SET_TELEMETRYCONF_REGCNT;
+        } else if (pseudo.regCount != ModbusDecode_GetWordCount(dataType)) {
+            setFlag &= ~SET_TELEMETRYCONF_REGCNT;  // mismatch
+        }
+        if (setFlag & SET_TELEMETRYCONF_REGCNT) {
+            if (ModbusDecode_Compile(&pseudo.decode, dataType,
+                    pseudo.asLittle, byteSwap, bitOffset, bitLength, pseudo.asFloat,
+                    pseudo.offset, pseudo.multiplier, pseudo.devider)) {
+                pseudo.asFloat = pseudo.decode.asFloat;
+            } else {
+                setFlag &= ~SET_TELEMETRYCONF_REGCNT;  // invalid bit field
             }
         }
-        
+
         if (setFlag == SET_TELEMETRYCONF_REQUIRED) {
+            // build the request frame in advance (configuration is static)
+            ModbusDevRTU_BuildRequestFrame((int)pseudo.devID, (int)pseudo.funcCode,
+                (int)pseudo.regAddr, (int)pseudo.regCount, pseudo.reqFrame);
+            pseudo.itemIndex = (uint32_t)vector_size(me->mFetchItems);
             vector_add_last(me->mFetchItems, &pseudo);
         } else {
             ret = false;
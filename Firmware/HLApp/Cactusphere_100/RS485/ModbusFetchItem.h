@@ -29,18 +29,26 @@
 
 #include <stdbool.h>
 
+#include "ModbusDecode.h"
+#include "ModbusDevRTU.h"
+#include "ModbusReportFilter.h"
+
 typedef struct ModbusFetchItem {
     char        telemetryName[TELEMETRY_NAME_MAX_LEN + 1];  // telemetry name
     uint32_t    intervalSec;    // periodic acquisition interval (in seconds)
     uint32_t    devID;          // slave device ID
-    uint32_t    regAddr;        // register address
-    uint32_t    regCount;       // read register count
+    uint32_t    regAddr;        // register address (bit address for FC01/FC02)
+    uint32_t    regCount;       // read register count (1 for FC01/FC02)
     uint32_t    funcCode;       // function code
     uint16_t    offset;         // sum value
     uint32_t    multiplier;     // multiply value
     uint32_t    devider;        // divide value
     bool        asFloat;        // true:float, false: not float
     bool        asLittle;       // true:little endian, false:big endian
+    ModbusDecodeDesc    decode; // compiled value decoder
+    ModbusReportPolicy  report; // reporting policy (deadband etc.)
+    uint32_t    itemIndex;      // index in the configuration
+    uint8_t     reqFrame[MODBUS_RTU_READ_REQ_FRAME_LEN];  // prebuilt read request
 } ModbusFetchItem;
 
 #endif  // _MODBUS_FETCH_ITEM_H_
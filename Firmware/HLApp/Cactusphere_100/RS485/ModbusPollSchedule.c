@@ -0,0 +1,237 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "ModbusPollSchedule.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "LibModbus.h"
+#include "ModbusFetchItem.h"
+
+// ModbusPollSchedule data members
+struct ModbusPollSchedule {
+    ModbusReadPlan*	mReadPlan;  // read blocks of current slave and interval
+    vector	mBlocks;    // vector of ModbusPollBlock
+    vector	mItems;     // vector of ModbusFetchItem*, sorted by block
+    vector	mEntries;   // vector of ModbusPollEntry (same order as mBlocks)
+    vector	mGroupItems;  // vector of ModbusFetchItem*, work for Build()
+};
+
+static int
+FetchItem_Comparator(const void* one, const void* two)
+{
+    const ModbusFetchItem*	item1 = *((const ModbusFetchItem**)one);
+    const ModbusFetchItem*	item2 = *((const ModbusFetchItem**)two);
+
+    if (item1->devID != item2->devID) {
+        // slaves of the same line parameters are put side by side
+        uint32_t	key1 = Libmodbus_GetLineKey((int)item1->devID);
+        uint32_t	key2 = Libmodbus_GetLineKey((int)item2->devID);
+
+        if (key1 != key2) {
+            return (key1 < key2) ? -1 : 1;
+        }
+        return (item1->devID < item2->devID) ? -1 : 1;
+    }
+    if (item1->intervalSec != item2->intervalSec) {
+        return (item1->intervalSec < item2->intervalSec) ? -1 : 1;
+    }
+    return 0;
+}
+
+// Initialization and cleanup
+ModbusPollSchedule*
+ModbusPollSchedule_New(void)
+{
+    ModbusPollSchedule*	newObj =
+        (ModbusPollSchedule*)malloc(sizeof(ModbusPollSchedule));
+
+    if (NULL != newObj) {
+        memset(newObj, 0, sizeof(ModbusPollSchedule));
+        newObj->mReadPlan = ModbusReadPlan_New();
+        if (NULL == newObj->mReadPlan) {
+            goto err;
+        }
+        newObj->mBlocks = vector_init(sizeof(ModbusPollBlock));
+        if (NULL == newObj->mBlocks) {
+            goto err_delete_plan;
+        }
+        newObj->mItems = vector_init(sizeof(ModbusFetchItem*));
+        if (NULL == newObj->mItems) {
+            goto err_delete_blocks;
+        }
+        newObj->mEntries = vector_init(sizeof(ModbusPollEntry));
+        if (NULL == newObj->mEntries) {
+            goto err_delete_items;
+        }
+        newObj->mGroupItems = vector_init(sizeof(ModbusFetchItem*));
+        if (NULL == newObj->mGroupItems) {
+            goto err_delete_entries;
+        }
+    }
+
+    return newObj;
+err_delete_entries:
+    vector_destroy(newObj->mEntries);
+err_delete_items:
+    vector_destroy(newObj->mItems);
+err_delete_blocks:
+    vector_destroy(newObj->mBlocks);
+err_delete_plan:
+    ModbusReadPlan_Destroy(newObj->mReadPlan);
+err:
+    free(newObj);
+    return NULL;
+}
+
+void
+ModbusPollSchedule_Destroy(ModbusPollSchedule* me)
+{
+    vector_destroy(me->mGroupItems);
+    vector_destroy(me->mEntries);
+    vector_destroy(me->mItems);
+    vector_destroy(me->mBlocks);
+    ModbusReadPlan_Destroy(me->mReadPlan);
+    free(me);
+}
+
+static void
+ModbusPollSchedule_AddGroup(ModbusPollSchedule* me, uint32_t devID)
+{
+    // coalesce the items of one slave and interval into read blocks
+    ModbusDev*	modbusdev = Libmodbus_GetLib((int)devID);
+    const ModbusReadBlock*	blkCurs;
+    int 	itemBase = vector_size(me->mItems);
+    vector	planItems;
+
+    if (NULL == modbusdev) {
+        return;  // unknown slave
+    }
+    ModbusReadPlan_Build(me->mReadPlan, me->mGroupItems,
+        Libmodbus_GetReadGap(modbusdev));
+
+    blkCurs = (const ModbusReadBlock*)vector_get_data(
+        ModbusReadPlan_GetBlocks(me->mReadPlan));
+    for (int i = 0, n = vector_size(ModbusReadPlan_GetBlocks(me->mReadPlan));
+            i < n; ++i, ++blkCurs) {
+        ModbusPollBlock	pollBlock;
+
+        pollBlock.devID = devID;
+        pollBlock.block = *blkCurs;
+        pollBlock.block.itemIndex += itemBase;
+        vector_add_last(me->mBlocks, &pollBlock);
+    }
+    planItems = ModbusReadPlan_GetItems(me->mReadPlan);
+    vector_add_last_multi(me->mItems,
+        vector_get_data(planItems), vector_size(planItems));
+}
+
+// Compile the acquisition targets into read blocks of each slave and interval
+void
+ModbusPollSchedule_Build(ModbusPollSchedule* me, vector fetchItemPtrs)
+{
+    const ModbusFetchItem**	sorted;
+    const ModbusPollBlock*	blkCurs;
+    int 	itemCount;
+
+    vector_clear(me->mBlocks);
+    vector_clear(me->mItems);
+    vector_clear(me->mEntries);
+    ModbusReadPlan_ClearFrameCache(me->mReadPlan);
+    if (NULL == fetchItemPtrs || vector_is_empty(fetchItemPtrs)) {
+        return;
+    }
+
+    // group the items by (slave, interval)
+    vector_clear(me->mGroupItems);
+    vector_add_last_multi(me->mGroupItems,
+        vector_get_data(fetchItemPtrs), vector_size(fetchItemPtrs));
+    itemCount = vector_size(me->mGroupItems);
+    sorted = (const ModbusFetchItem**)malloc(sizeof(ModbusFetchItem*) * (size_t)itemCount);
+    if (NULL == sorted) {
+        return;
+    }
+    vector_copy_to_array(sorted, me->mGroupItems);
+    qsort(sorted, (size_t)itemCount, sizeof(ModbusFetchItem*), FetchItem_Comparator);
+
+    for (int i = 0; i < itemCount; ) {
+        int 	j = i;
+
+        vector_clear(me->mGroupItems);
+        while (j < itemCount && 0 == FetchItem_Comparator(&sorted[i], &sorted[j])) {
+            vector_add_last(me->mGroupItems, &sorted[j]);
+            ++j;
+        }
+        ModbusPollSchedule_AddGroup(me, sorted[i]->devID);
+        i = j;
+    }
+    free(sorted);
+
+    // make the entries to download (after all blocks are fixed)
+    blkCurs = (const ModbusPollBlock*)vector_get_data(me->mBlocks);
+    for (int i = 0, n = vector_size(me->mBlocks); i < n; ++i, ++blkCurs) {
+        const ModbusFetchItem*	firstItem =
+            ((const ModbusFetchItem**)vector_get_data(me->mItems))[blkCurs->block.itemIndex];
+        ModbusPollEntry	entry;
+
+        Libmodbus_FillPollEntry(Libmodbus_GetLib((int)blkCurs->devID), &entry);
+        entry.intervalMs = firstItem->intervalSec * 1000;
+        entry.length     = (int)blkCurs->block.regCount;
+        entry.frame      = blkCurs->block.reqFrame;
+        vector_add_last(me->mEntries, &entry);
+    }
+}
+
+// Download the compiled schedule to RTApp and start polling
+bool
+ModbusPollSchedule_Download(ModbusPollSchedule* me,
+    ModbusPollConfigCallback callback, void* context)
+{
+    return Libmodbus_DownloadPollSchedule(
+        (const ModbusPollEntry*)vector_get_data(me->mEntries),
+        vector_size(me->mEntries), callback, context);
+}
+
+// Get the result of ModbusPollSchedule_Build()
+int
+ModbusPollSchedule_GetBlockCount(ModbusPollSchedule* me)
+{
+    return vector_size(me->mBlocks);
+}
+
+const ModbusPollBlock*
+ModbusPollSchedule_GetBlock(ModbusPollSchedule* me, int index)
+{
+    if (index < 0 || vector_size(me->mBlocks) <= index) {
+        return NULL;
+    }
+    return &((const ModbusPollBlock*)vector_get_data(me->mBlocks))[index];
+}
+
+const ModbusFetchItem**
+ModbusPollSchedule_GetItems(ModbusPollSchedule* me)
+{
+    return (const ModbusFetchItem**)vector_get_data(me->mItems);
+}
@@ -0,0 +1,71 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _MODBUS_POLL_SCHEDULE_H_
+#define _MODBUS_POLL_SCHEDULE_H_
+
+#ifndef _STDBOOL_H
+#include <stdbool.h>
+#endif
+#ifndef _STDINT_H
+#include <stdint.h>
+#endif
+
+#ifndef CONTAINERS_VECTOR_H
+#include "vector.h"
+#endif
+
+#include "ModbusReadPlan.h"
+
+typedef struct ModbusFetchItem	ModbusFetchItem;
+
+// read block of poll schedule
+typedef struct ModbusPollBlock {
+    uint32_t        devID;      // slave device ID
+    ModbusReadBlock block;      // itemIndex is the index in ModbusPollSchedule_GetItems()
+} ModbusPollBlock;
+
+typedef struct ModbusPollSchedule	ModbusPollSchedule;
+
+// Initialization and cleanup
+extern ModbusPollSchedule*	ModbusPollSchedule_New(void);
+extern void	ModbusPollSchedule_Destroy(ModbusPollSchedule* me);
+
+// Compile the acquisition targets into read blocks of each slave and interval
+extern void	ModbusPollSchedule_Build(ModbusPollSchedule* me, vector fetchItemPtrs);
+
+// Download the compiled schedule to RTApp and start polling
+// (stop polling if the schedule is empty), callback is called with
+// the result of the download (see ModbusDevRTU_DownloadPollSchedule())
+extern bool	ModbusPollSchedule_Download(ModbusPollSchedule* me,
+    ModbusPollConfigCallback callback, void* context);
+
+// Get the result of ModbusPollSchedule_Build()
+//   index of the block is same as ModbusPollResult::entryIndex
+extern int	ModbusPollSchedule_GetBlockCount(ModbusPollSchedule* me);
+extern const ModbusPollBlock*	ModbusPollSchedule_GetBlock(
+    ModbusPollSchedule* me, int index);
+extern const ModbusFetchItem**	ModbusPollSchedule_GetItems(ModbusPollSchedule* me);
+
+#endif  // _MODBUS_POLL_SCHEDULE_H_
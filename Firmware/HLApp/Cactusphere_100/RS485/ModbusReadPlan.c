@@ -0,0 +1,226 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "ModbusReadPlan.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ModbusDevConfig.h"
+#include "ModbusFetchItem.h"
+
+#define MAX_CACHED_FRAMES	256
+
+// cached request frame of a coalesced block
+typedef struct ModbusFrameCacheEntry {
+    uint32_t	devID;
+    uint32_t	funcCode;
+    uint32_t	regAddr;
+    uint32_t	regCount;
+    uint8_t	frame[MODBUS_RTU_READ_REQ_FRAME_LEN];
+} ModbusFrameCacheEntry;
+
+// ModbusReadPlan data members
+struct ModbusReadPlan {
+    vector	mBlocks;	// vector of ModbusReadBlock
+    vector	mItems;		// vector of ModbusFetchItem*, sorted by block
+    vector	mFrameCache;	// vector of ModbusFrameCacheEntry
+};
+
+static int
+FetchItem_Comparator(const void* one, const void* two)
+{
+    const ModbusFetchItem*	item1 = *((const ModbusFetchItem**)one);
+    const ModbusFetchItem*	item2 = *((const ModbusFetchItem**)two);
+
+    if (item1->funcCode != item2->funcCode) {
+        return (item1->funcCode < item2->funcCode) ? -1 : 1;
+    }
+    if (item1->regAddr != item2->regAddr) {
+        return (item1->regAddr < item2->regAddr) ? -1 : 1;
+    }
+    if (item1->regCount != item2->regCount) {
+        return (item1->regCount < item2->regCount) ? -1 : 1;
+    }
+    return 0;
+}
+
+// Initialization and cleanup
+ModbusReadPlan*
+ModbusReadPlan_New(void)
+{
+    ModbusReadPlan*	newObj = (ModbusReadPlan*)malloc(sizeof(ModbusReadPlan));
+
+    if (NULL != newObj) {
+        newObj->mBlocks = vector_init(sizeof(ModbusReadBlock));
+        if (NULL == newObj->mBlocks) {
+            free(newObj);
+            return NULL;
+        }
+        newObj->mItems = vector_init(sizeof(ModbusFetchItem*));
+        if (NULL == newObj->mItems) {
+            vector_destroy(newObj->mBlocks);
+            free(newObj);
+            return NULL;
+        }
+        newObj->mFrameCache = vector_init(sizeof(ModbusFrameCacheEntry));
+        if (NULL == newObj->mFrameCache) {
+            vector_destroy(newObj->mItems);
+            vector_destroy(newObj->mBlocks);
+            free(newObj);
+            return NULL;
+        }
+    }
+
+    return newObj;
+}
+
+void
+ModbusReadPlan_Destroy(ModbusReadPlan* me)
+{
+    vector_destroy(me->mFrameCache);
+    vector_destroy(me->mItems);
+    vector_destroy(me->mBlocks);
+    free(me);
+}
+
+static void
+ModbusReadPlan_SetRequestFrame(ModbusReadPlan* me,
+    ModbusReadBlock* block, const ModbusFetchItem* firstItem)
+{
+    // use prebuilt frame of the item if the block is not coalesced,
+    // otherwise look up (or build and keep) the frame of the block
+    ModbusFrameCacheEntry*	curs;
+    ModbusFrameCacheEntry	newEntry;
+
+    if (block->regAddr == firstItem->regAddr
+    &&  block->regCount == firstItem->regCount) {
+        memcpy(block->reqFrame, firstItem->reqFrame, sizeof(block->reqFrame));
+        return;
+    }
+
+    curs = (ModbusFrameCacheEntry*)vector_get_data(me->mFrameCache);
+    for (int i = 0, n = vector_size(me->mFrameCache); i < n; ++i, ++curs) {
+        if (curs->devID == firstItem->devID
+        &&  curs->funcCode == block->funcCode
+        &&  curs->regAddr == block->regAddr
+        &&  curs->regCount == block->regCount) {
+            memcpy(block->reqFrame, curs->frame, sizeof(block->reqFrame));
+            return;
+        }
+    }
+
+    ModbusDevRTU_BuildRequestFrame((int)firstItem->devID, (int)block->funcCode,
+        (int)block->regAddr, (int)block->regCount, block->reqFrame);
+    if (vector_size(me->mFrameCache) >= MAX_CACHED_FRAMES) {
+        vector_clear(me->mFrameCache);
+    }
+    newEntry.devID    = firstItem->devID;
+    newEntry.funcCode = block->funcCode;
+    newEntry.regAddr  = block->regAddr;
+    newEntry.regCount = block->regCount;
+    memcpy(newEntry.frame, block->reqFrame, sizeof(newEntry.frame));
+    vector_add_last(me->mFrameCache, &newEntry);
+}
+
+// Build read blocks from the acquisition targets of one slave
+void
+ModbusReadPlan_Build(ModbusReadPlan* me, vector fetchItems, uint32_t maxGap)
+{
+    // sort the items by (function code, register address), then
+    // merge neighbouring items into one block while the block fits
+    // in a single request
+    const ModbusFetchItem**	curs;
+    ModbusReadBlock	block;
+    uint32_t	blockEnd = 0;
+
+    vector_clear(me->mBlocks);
+    vector_clear(me->mItems);
+    if (NULL == fetchItems || vector_is_empty(fetchItems)) {
+        return;
+    }
+
+    vector_add_last_multi(me->mItems,
+        vector_get_data(fetchItems), vector_size(fetchItems));
+    qsort(vector_get_data(me->mItems), (size_t)vector_size(me->mItems),
+        sizeof(ModbusFetchItem*), FetchItem_Comparator);
+
+    curs = (const ModbusFetchItem**)vector_get_data(me->mItems);
+    for (int i = 0, n = vector_size(me->mItems); i < n; ++i) {
+        const ModbusFetchItem*	item = *curs++;
+        uint32_t	itemEnd = item->regAddr + item->regCount;
+        // a gap of one register costs as much as 16 bits
+        uint32_t	gap = MODBUS_IS_BIT_READ(item->funcCode) ? maxGap * 16 : maxGap;
+
+        if (i != 0
+        && item->funcCode == block.funcCode
+        && item->regAddr <= blockEnd + gap
+        && (itemEnd <= blockEnd
+            || itemEnd - block.regAddr <= MODBUS_MAX_READ_LENGTH(item->funcCode))) {
+            // extend current block
+            if (itemEnd > blockEnd) {
+                blockEnd = itemEnd;
+            }
+            block.regCount = blockEnd - block.regAddr;
+            block.itemCount++;
+            continue;
+        }
+        if (i != 0) {
+            ModbusReadPlan_SetRequestFrame(me, &block,
+                ((const ModbusFetchItem**)vector_get_data(me->mItems))[block.itemIndex]);
+            vector_add_last(me->mBlocks, &block);
+        }
+
+        // start new block
+        block.funcCode  = item->funcCode;
+        block.regAddr   = item->regAddr;
+        block.regCount  = item->regCount;
+        block.itemIndex = i;
+        block.itemCount = 1;
+        blockEnd = itemEnd;
+    }
+    ModbusReadPlan_SetRequestFrame(me, &block,
+        ((const ModbusFetchItem**)vector_get_data(me->mItems))[block.itemIndex]);
+    vector_add_last(me->mBlocks, &block);
+}
+
+// Discard the cached request frames
+void
+ModbusReadPlan_ClearFrameCache(ModbusReadPlan* me)
+{
+    vector_clear(me->mFrameCache);
+}
+
+// Get the result of ModbusReadPlan_Build()
+vector
+ModbusReadPlan_GetBlocks(ModbusReadPlan* me)
+{
+    return me->mBlocks;
+}
+
+vector
+ModbusReadPlan_GetItems(ModbusReadPlan* me)
+{
+    return me->mItems;
+}
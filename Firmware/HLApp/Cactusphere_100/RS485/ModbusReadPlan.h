@@ -0,0 +1,66 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _MODBUS_READ_PLAN_H_
+#define _MODBUS_READ_PLAN_H_
+
+#ifndef _STDINT_H
+#include <stdint.h>
+#endif
+
+#ifndef CONTAINERS_VECTOR_H
+#include "vector.h"
+#endif
+
+#include "ModbusDevRTU.h"
+
+// read block (one read request which covers several telemetry items)
+typedef struct ModbusReadBlock {
+    uint32_t    funcCode;   // function code
+    uint32_t    regAddr;    // first register address
+    uint32_t    regCount;   // read register count (bit count for FC01/FC02)
+    int         itemIndex;  // index of the first item in ModbusReadPlan_GetItems()
+    int         itemCount;  // count of items sliced from this block
+    uint8_t     reqFrame[MODBUS_RTU_READ_REQ_FRAME_LEN];  // read request of this block
+} ModbusReadBlock;
+
+typedef struct ModbusReadPlan	ModbusReadPlan;
+
+// Initialization and cleanup
+extern ModbusReadPlan*	ModbusReadPlan_New(void);
+extern void	ModbusReadPlan_Destroy(ModbusReadPlan* me);
+
+// Build read blocks from the acquisition targets of one slave
+//   maxGap: count of unused registers allowed between items of the same block
+extern void	ModbusReadPlan_Build(
+    ModbusReadPlan* me, vector fetchItems, uint32_t maxGap);
+
+// Discard the cached request frames (on configuration change)
+extern void	ModbusReadPlan_ClearFrameCache(ModbusReadPlan* me);
+
+// Get the result of ModbusReadPlan_Build()
+extern vector	ModbusReadPlan_GetBlocks(ModbusReadPlan* me);
+extern vector	ModbusReadPlan_GetItems(ModbusReadPlan* me);
+
+#endif  // _MODBUS_READ_PLAN_H_
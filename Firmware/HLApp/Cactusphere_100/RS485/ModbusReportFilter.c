@@ -0,0 +1,112 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "ModbusReportFilter.h"
+
+#include <string.h>
+
+// Initialization
+void
+ModbusReportPolicy_Init(ModbusReportPolicy* policy)
+{
+    policy->deadband        = 0;
+    policy->deadbandPercent = 0;
+    policy->onChange        = false;
+    policy->maxSilenceSec   = 0;
+}
+
+void
+ModbusReportState_Init(ModbusReportState* state)
+{
+    memset(state, 0, sizeof(*state));
+}
+
+// Check whether the policy filters any sample
+bool
+ModbusReportPolicy_IsFiltering(const ModbusReportPolicy* policy)
+{
+    return policy->onChange
+        || policy->deadband > 0 || policy->deadbandPercent > 0;
+}
+
+static bool
+ModbusReportState_IsChanged(const ModbusReportState* state,
+    const ModbusReportPolicy* policy, const ModbusValue* value)
+{
+    // the thresholds are OR-ed, any change passes if only onChange is set
+    const ModbusValue*	last = &state->lastValue;
+    double	lastVal;
+    double	delta;
+
+    if (value->isFloat ? value->floatVal == last->floatVal
+                       : value->intVal == last->intVal) {
+        return false;  // not changed
+    }
+    if (policy->deadband <= 0 && policy->deadbandPercent <= 0) {
+        return true;  // onChange
+    }
+
+    lastVal = ModbusDecode_ToDouble(last);
+    delta   = ModbusDecode_ToDouble(value) - lastVal;
+    if (delta < 0) {
+        delta = -delta;
+    }
+    if (lastVal < 0) {
+        lastVal = -lastVal;
+    }
+    if (policy->deadband > 0 && delta >= policy->deadband) {
+        return true;
+    }
+    if (policy->deadbandPercent > 0
+    &&  delta >= lastVal * policy->deadbandPercent / 100) {
+        return true;
+    }
+    return false;
+}
+
+// Check whether the value should be reported
+bool
+ModbusReportState_Check(ModbusReportState* state,
+    const ModbusReportPolicy* policy, const ModbusValue* value, uint32_t timeStamp)
+{
+    bool	doReport;
+
+    if (! state->hasReported) {
+        doReport = true;
+    } else if (policy->maxSilenceSec != 0
+           &&  timeStamp - state->lastTime >= policy->maxSilenceSec) {
+        doReport = true;  // heartbeat
+    } else if (! ModbusReportPolicy_IsFiltering(policy)) {
+        doReport = true;
+    } else {
+        doReport = ModbusReportState_IsChanged(state, policy, value);
+    }
+
+    if (doReport) {
+        state->hasReported = true;
+        state->lastTime    = timeStamp;
+        state->lastValue   = *value;
+    }
+    return doReport;
+}
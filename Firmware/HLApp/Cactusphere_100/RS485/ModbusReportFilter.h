@@ -0,0 +1,63 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _MODBUS_REPORT_FILTER_H_
+#define _MODBUS_REPORT_FILTER_H_
+
+#ifndef _STDBOOL_H
+#include <stdbool.h>
+#endif
+#ifndef _STDINT_H
+#include <stdint.h>
+#endif
+
+#include "ModbusDecode.h"
+
+// reporting policy of a telemetry item (all zero: report every sample)
+typedef struct ModbusReportPolicy {
+    double      deadband;        // report if changed by this value or more
+    double      deadbandPercent; // report if changed by this percent of the last value or more
+    bool        onChange;        // report only if the value changed
+    uint32_t    maxSilenceSec;   // report at least once in this interval [sec] (0: no heartbeat)
+} ModbusReportPolicy;
+
+// reporting state of a telemetry item
+typedef struct ModbusReportState {
+    bool        hasReported;     // false until the first report
+    uint32_t    lastTime;        // time stamp of the last report [sec]
+    ModbusValue lastValue;       // value of the last report
+} ModbusReportState;
+
+// Initialization
+extern void	ModbusReportPolicy_Init(ModbusReportPolicy* policy);
+extern void	ModbusReportState_Init(ModbusReportState* state);
+
+// Check whether the policy filters any sample
+extern bool	ModbusReportPolicy_IsFiltering(const ModbusReportPolicy* policy);
+
+// Check whether the value should be reported, and update the state if so
+extern bool	ModbusReportState_Check(ModbusReportState* state,
+    const ModbusReportPolicy* policy, const ModbusValue* value, uint32_t timeStamp);
+
+#endif  // _MODBUS_REPORT_FILTER_H_
@@ -0,0 +1,192 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "ModbusScanQueue.h"
+
+#include <stdlib.h>
+
+#include "LibModbus.h"
+#include "ModbusFetchItem.h"
+#include "ModbusFetchTargets.h"
+
+// ModbusScanQueue data members
+struct ModbusScanQueue {
+    vector	mJobs;	// vector of ModbusScanJob, in deadline order
+};
+
+// Initialization and cleanup
+ModbusScanQueue*
+ModbusScanQueue_New(void)
+{
+    ModbusScanQueue*	newObj = (ModbusScanQueue*)malloc(sizeof(ModbusScanQueue));
+
+    if (NULL != newObj) {
+        newObj->mJobs = vector_init(sizeof(ModbusScanJob));
+        if (NULL == newObj->mJobs) {
+            free(newObj);
+            return NULL;
+        }
+    }
+
+    return newObj;
+}
+
+void
+ModbusScanQueue_Destroy(ModbusScanQueue* me)
+{
+    ModbusScanQueue_Clear(me);
+    vector_destroy(me->mJobs);
+    free(me);
+}
+
+void
+ModbusScanQueue_Clear(ModbusScanQueue* me)
+{
+    while (! vector_is_empty(me->mJobs)) {
+        ModbusScanQueue_Pop(me);
+    }
+}
+
+static ModbusScanJob*
+ModbusScanQueue_Find(ModbusScanQueue* me, unsigned long devID)
+{
+    ModbusScanJob*	curs = (ModbusScanJob*)vector_get_data(me->mJobs);
+
+    for (int i = 0, n = vector_size(me->mJobs); i < n; ++i, ++curs) {
+        if (curs->devID == devID) {
+            return curs;
+        }
+    }
+    return NULL;
+}
+
+static void
+ModbusScanQueue_GroupByLine(ModbusScanQueue* me, int first)
+{
+    // reorder the jobs from first so that the slaves of the same line
+    // parameters are read in a row, keep the order within a group
+    ModbusScanJob*	jobs = (ModbusScanJob*)vector_get_data(me->mJobs);
+    int	n = vector_size(me->mJobs);
+    uint32_t	curKey = (first > 0)
+        ? jobs[first - 1].lineKey : Libmodbus_GetCurrentLineKey();
+
+    for (int i = first; i < n; ++i) {
+        int	j = i;
+
+        while (j < n && jobs[j].lineKey != curKey) {
+            ++j;
+        }
+        if (j == n) {
+            curKey = jobs[i].lineKey;  // no more slave of current setting
+            continue;
+        }
+        if (j != i) {
+            ModbusScanJob	job = jobs[j];
+
+            for (int k = j; k > i; --k) {
+                jobs[k] = jobs[k - 1];
+            }
+            jobs[i] = job;
+        }
+    }
+}
+
+// Take in the due targets
+void
+ModbusScanQueue_Merge(ModbusScanQueue* me,
+    ModbusFetchTargets* targets, uint32_t nowMs)
+{
+    // new jobs go to the tail (the latest deadline), a slave still
+    // waiting keeps its deadline and reads the new items together
+    vector	devIDs = ModbusFetchTargets_GetDevIDs(targets);
+    int	oldCount = vector_size(me->mJobs);
+
+    for (int i = 0, n = vector_size(devIDs); i < n; ++i) {
+        unsigned long	devID = ((unsigned long*)vector_get_data(devIDs))[i];
+        vector	items = ModbusFetchTargets_GetFetchItems(targets, devID);
+        ModbusScanJob*	job;
+
+        if (NULL == items || vector_is_empty(items)) {
+            continue;
+        }
+        job = ModbusScanQueue_Find(me, devID);
+        if (NULL == job) {
+            ModbusScanJob	newJob;
+
+            newJob.devID      = devID;
+            newJob.dueTimeMs  = nowMs;
+            newJob.lineKey    = Libmodbus_GetLineKey((int)devID);
+            newJob.fetchItems = vector_init(sizeof(ModbusFetchItem*));
+            if (NULL == newJob.fetchItems) {
+                continue;
+            }
+            vector_add_last_multi(newJob.fetchItems,
+                vector_get_data(items), vector_size(items));
+            vector_add_last(me->mJobs, &newJob);
+            continue;
+        }
+
+        for (int k = 0, m = vector_size(items); k < m; ++k) {
+            const ModbusFetchItem*	item = ((const ModbusFetchItem**)vector_get_data(items))[k];
+            const ModbusFetchItem**	curs =
+                (const ModbusFetchItem**)vector_get_data(job->fetchItems);
+            int	j, l;
+
+            for (j = 0, l = vector_size(job->fetchItems); j < l; ++j) {
+                if (curs[j] == item) {
+                    break;  // already waiting
+                }
+            }
+            if (j == l) {
+                vector_add_last(job->fetchItems, &item);
+            }
+        }
+    }
+    ModbusScanQueue_GroupByLine(me, oldCount);
+}
+
+// Get the job of the earliest deadline
+const ModbusScanJob*
+ModbusScanQueue_Peek(ModbusScanQueue* me)
+{
+    return vector_is_empty(me->mJobs)
+        ? NULL : (const ModbusScanJob*)vector_get_data(me->mJobs);
+}
+
+void
+ModbusScanQueue_Pop(ModbusScanQueue* me)
+{
+    ModbusScanJob	job;
+
+    if (0 == vector_get_first(&job, me->mJobs)) {
+        vector_destroy(job.fetchItems);
+        vector_remove_first(me->mJobs);
+    }
+}
+
+int
+ModbusScanQueue_Count(ModbusScanQueue* me)
+{
+    return vector_size(me->mJobs);
+}
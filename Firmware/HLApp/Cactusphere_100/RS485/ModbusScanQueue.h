@@ -0,0 +1,66 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _MODBUS_SCAN_QUEUE_H_
+#define _MODBUS_SCAN_QUEUE_H_
+
+#ifndef _STDINT_H
+#include <stdint.h>
+#endif
+
+#ifndef CONTAINERS_VECTOR_H
+#include "vector.h"
+#endif
+
+typedef struct ModbusFetchTargets	ModbusFetchTargets;
+
+// read of one slave waiting in the queue
+typedef struct ModbusScanJob {
+    unsigned long	devID;      // slave device ID
+    uint32_t	dueTimeMs;      // time when the items became due (monotonic)
+    uint32_t	lineKey;        // UART line parameters of the slave
+    vector	fetchItems;         // vector of ModbusFetchItem*
+} ModbusScanJob;
+
+typedef struct ModbusScanQueue	ModbusScanQueue;
+
+// Initialization and cleanup
+extern ModbusScanQueue*	ModbusScanQueue_New(void);
+extern void	ModbusScanQueue_Destroy(ModbusScanQueue* me);
+extern void	ModbusScanQueue_Clear(ModbusScanQueue* me);
+
+// Take in the due targets (in deadline order)
+//   items of a slave already in the queue are merged into its job, the
+//   slaves due together are grouped by the line parameters (starting
+//   from the setting in use) to reduce UART reconfigurations
+extern void	ModbusScanQueue_Merge(ModbusScanQueue* me,
+    ModbusFetchTargets* targets, uint32_t nowMs);
+
+// Get the job of the earliest deadline (NULL if empty)
+extern const ModbusScanJob*	ModbusScanQueue_Peek(ModbusScanQueue* me);
+extern void	ModbusScanQueue_Pop(ModbusScanQueue* me);
+
+extern int	ModbusScanQueue_Count(ModbusScanQueue* me);
+
+#endif  // _MODBUS_SCAN_QUEUE_H_
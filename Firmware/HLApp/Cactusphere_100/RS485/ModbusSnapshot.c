@@ -0,0 +1,227 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "ModbusSnapshot.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ModbusDevConfig.h"
+#include "vector.h"
+
+#define MAX_SNAPSHOT_BLOCKS	256
+
+// values of one read block
+typedef struct ModbusSnapshotBlock {
+    int 	devID;
+    int 	funcCode;
+    int 	regAddr;
+    int 	length;         // register count (bit count for FC01/FC02)
+    uint32_t	timeMs;     // time of the response (monotonic)
+    unsigned short*	values; // one value per register/bit
+} ModbusSnapshotBlock;
+
+// ModbusSnapshot data members
+struct ModbusSnapshot {
+    vector	mBlocks;	// vector of ModbusSnapshotBlock
+};
+
+static uint32_t
+ModbusSnapshot_GetMonotonicMs(void)
+{
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000 + (uint32_t)(ts.tv_nsec / 1000000);
+}
+
+// Initialization and cleanup
+ModbusSnapshot*
+ModbusSnapshot_New(void)
+{
+    ModbusSnapshot*	newObj = (ModbusSnapshot*)malloc(sizeof(ModbusSnapshot));
+
+    if (NULL != newObj) {
+        newObj->mBlocks = vector_init(sizeof(ModbusSnapshotBlock));
+        if (NULL == newObj->mBlocks) {
+            free(newObj);
+            return NULL;
+        }
+    }
+
+    return newObj;
+}
+
+void
+ModbusSnapshot_Destroy(ModbusSnapshot* me)
+{
+    ModbusSnapshot_Clear(me);
+    vector_destroy(me->mBlocks);
+    free(me);
+}
+
+static void
+ModbusSnapshot_RemoveAt(ModbusSnapshot* me, int index)
+{
+    ModbusSnapshotBlock	block;
+
+    if (0 == vector_get_at(&block, me->mBlocks, index)) {
+        free(block.values);
+        vector_remove_at(me->mBlocks, index);
+    }
+}
+
+void
+ModbusSnapshot_Clear(ModbusSnapshot* me)
+{
+    while (! vector_is_empty(me->mBlocks)) {
+        ModbusSnapshot_RemoveAt(me, vector_size(me->mBlocks) - 1);
+    }
+}
+
+// Store the result of a read
+void
+ModbusSnapshot_Update(ModbusSnapshot* me, int devID,
+    const ModbusReadRequest* req, uint32_t ageMs)
+{
+    // replace the block of the same range, the blocks inside the new
+    // one are superseded (the oldest block is dropped if full)
+    uint32_t	now = ModbusSnapshot_GetMonotonicMs();
+    ModbusSnapshotBlock	newBlock;
+    ModbusSnapshotBlock*	curs;
+    bool	isBitRead = MODBUS_IS_BIT_READ(req->function);
+    int 	oldest = -1;
+
+    if (! req->result || req->length < 1) {
+        return;
+    }
+    for (int i = vector_size(me->mBlocks) - 1; i >= 0; --i) {
+        curs = (ModbusSnapshotBlock*)vector_get_data(me->mBlocks) + i;
+        if (curs->devID == devID
+        &&  curs->funcCode == req->function
+        &&  curs->regAddr >= req->regAddr
+        &&  curs->regAddr + curs->length <= req->regAddr + req->length) {
+            ModbusSnapshot_RemoveAt(me, i);
+        }
+    }
+    if (vector_size(me->mBlocks) >= MAX_SNAPSHOT_BLOCKS) {
+        uint32_t	oldestTime = 0;
+
+        curs = (ModbusSnapshotBlock*)vector_get_data(me->mBlocks);
+        for (int i = 0, n = vector_size(me->mBlocks); i < n; ++i, ++curs) {
+            if (oldest < 0 || (int32_t)(curs->timeMs - oldestTime) < 0) {
+                oldest = i;
+                oldestTime = curs->timeMs;
+            }
+        }
+        ModbusSnapshot_RemoveAt(me, oldest);
+    }
+
+    newBlock.values = (unsigned short*)malloc(sizeof(unsigned short) * (size_t)req->length);
+    if (NULL == newBlock.values) {
+        return;
+    }
+    for (int i = 0; i < req->length; ++i) {
+        newBlock.values[i] = isBitRead
+            ? (unsigned short)((req->dst[i >> 4] >> (i & 15)) & 1) : req->dst[i];
+    }
+    newBlock.devID    = devID;
+    newBlock.funcCode = req->function;
+    newBlock.regAddr  = req->regAddr;
+    newBlock.length   = req->length;
+    newBlock.timeMs   = now - ageMs;
+    if (0 != vector_add_last(me->mBlocks, &newBlock)) {
+        free(newBlock.values);
+    }
+}
+
+// Read from the latest values
+bool
+ModbusSnapshot_Read(ModbusSnapshot* me, int devID, int funcCode,
+    int regAddr, int length, unsigned short* dst, uint32_t maxAgeMs)
+{
+    uint32_t	now = ModbusSnapshot_GetMonotonicMs();
+    const ModbusSnapshotBlock*	curs = (const ModbusSnapshotBlock*)vector_get_data(me->mBlocks);
+    const ModbusSnapshotBlock*	found = NULL;
+    const unsigned short*	src;
+
+    for (int i = 0, n = vector_size(me->mBlocks); i < n; ++i, ++curs) {
+        if (curs->devID == devID
+        &&  curs->funcCode == funcCode
+        &&  curs->regAddr <= regAddr
+        &&  regAddr + length <= curs->regAddr + curs->length
+        &&  now - curs->timeMs <= maxAgeMs
+        &&  (found == NULL || (int32_t)(curs->timeMs - found->timeMs) > 0)) {
+            found = curs;
+        }
+    }
+    if (found == NULL) {
+        return false;
+    }
+
+    src = &found->values[regAddr - found->regAddr];
+    if (MODBUS_IS_BIT_READ(funcCode)) {
+        memset(dst, 0, sizeof(unsigned short) * (size_t)((length + 15) >> 4));
+        for (int i = 0; i < length; ++i) {
+            dst[i >> 4] |= (unsigned short)((src[i] & 1) << (i & 15));
+        }
+    } else {
+        memcpy(dst, src, sizeof(unsigned short) * (size_t)length);
+    }
+
+    return true;
+}
+
+// Discard the values overwritten by a write
+void
+ModbusSnapshot_Invalidate(ModbusSnapshot* me, int devID, int funcCode,
+    int regAddr, int count)
+{
+    int 	readFuncCode;
+
+    switch (funcCode) {
+    case FC_WRITE_FORCE_SINGLE_COIL:
+    case FC_WRITE_MULTIPLE_COILS:
+        readFuncCode = FC_READ_COILS;
+        break;
+    case FC_WRITE_SINGLE_REGISTER:
+    case FC_WRITE_MULTIPLE_REGISTERS:
+        readFuncCode = FC_READ_HOLDING_REGISTER;
+        break;
+    default:
+        return;
+    }
+    for (int i = vector_size(me->mBlocks) - 1; i >= 0; --i) {
+        const ModbusSnapshotBlock*	curs =
+            (const ModbusSnapshotBlock*)vector_get_data(me->mBlocks) + i;
+
+        if (curs->devID == devID
+        &&  curs->funcCode == readFuncCode
+        &&  curs->regAddr < regAddr + count
+        &&  regAddr < curs->regAddr + curs->length) {
+            ModbusSnapshot_RemoveAt(me, i);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _MODBUS_SNAPSHOT_H_
+#define _MODBUS_SNAPSHOT_H_
+
+#ifndef _STDBOOL_H
+#include <stdbool.h>
+#endif
+#ifndef _STDINT_H
+#include <stdint.h>
+#endif
+
+#include "ModbusDevRTU.h"
+
+typedef struct ModbusSnapshot	ModbusSnapshot;
+
+// Initialization and cleanup
+extern ModbusSnapshot*	ModbusSnapshot_New(void);
+extern void	ModbusSnapshot_Destroy(ModbusSnapshot* me);
+extern void	ModbusSnapshot_Clear(ModbusSnapshot* me);
+
+// Store the result of a read (ignored if failed)
+//   ageMs: time since the response
+extern void	ModbusSnapshot_Update(ModbusSnapshot* me, int devID,
+    const ModbusReadRequest* req, uint32_t ageMs);
+
+// Read from the latest values (returns false if not stored or older than maxAgeMs)
+//   dst is in the same format as ModbusReadRequest (bits are packed LSB first)
+extern bool	ModbusSnapshot_Read(ModbusSnapshot* me, int devID, int funcCode,
+    int regAddr, int length, unsigned short* dst, uint32_t maxAgeMs);
+
+// Discard the values overwritten by a write (funcCode is of the write)
+extern void	ModbusSnapshot_Invalidate(ModbusSnapshot* me, int devID, int funcCode,
+    int regAddr, int count);
+
+#endif  // _MODBUS_SNAPSHOT_H_
@@ -31,50 +31,251 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
 
+#include <applibs/eventloop.h>
+
+#include "eventloop_timer_utilities.h"
+#include "ModbusDevConfig.h"
 #include "ModbusTCP.h"
 #include "vector.h"
 
+# include <sys/socket.h>
 # include <netinet/in.h>
 # include <netinet/ip.h>
 # include <netinet/tcp.h>
 # include <arpa/inet.h>
 
-#define MODBUS_TCP_HEADER_LENGTH 7
+#define MODBUS_TCP_HEADER_LENGTH MODBUS_TCP_MBAP_LENGTH
 #define MODBUS_TCP_CHECKSUM_LENGTH 0
 
 #define MIN_REQ_LENGTH 12
-#define MAX_MESSAGE_LENGTH 256
+#define MAX_MESSAGE_LENGTH MODBUS_TCP_MAX_ADU_LENGTH
 
 #define MODBUS_TCP_PRESET_REQ_LENGTH 12
 
-// function
-#define FC_READ_HOLDING_REGISTER 0x03
-#define FC_READ_INPUT_REGISTERS 0x04
-#define FC_WRITE_SINGLE_REGISTER 0x06
+// reconnect interval after connection failure (doubled up to max) [sec]
+#define MODBUS_TCP_RECONNECT_MIN_SEC 1
+#define MODBUS_TCP_RECONNECT_MAX_SEC 60
+
+// TCP keepalive (detects the server gone while idle)
+#define MODBUS_TCP_KEEPALIVE_IDLE_SEC 30
+#define MODBUS_TCP_KEEPALIVE_INTVL_SEC 5
+#define MODBUS_TCP_KEEPALIVE_COUNT 3
+
+// timeout of connect [msec]
+#define MODBUS_TCP_CONNECT_TIMEOUT_MS 3000
 
 typedef enum {
-    PARSE_FUNCTION,
-    PARSE_META,
-    PARSE_DATA
+    PARSE_HEADER,
+    PARSE_PDU
 
 }PARSE_STEP;
 
+typedef enum {
+    ASYNC_IDLE,
+    ASYNC_CONNECTING,
+    ASYNC_TRANSACTING
+
+}ASYNC_STATE;
+
+// request in flight of ModbusTCP_ReadRegisters()
+typedef struct ModbusTcpInFlight {
+    int index;      // index of the request (-1: not used)
+    uint64_t deadlineMs;  // the response must be complete by this time (monotonic)
+    uint8_t req[MIN_REQ_LENGTH];
+}ModbusTcpInFlight;
+
 // ModbusTCP structure
 typedef struct ModbusTcpCtx {
-    int socket;
+    int socket;     // -1 if not connected
     uint16_t t_id;
     char ip[16];
     int port;
     int header_length;
     int checksum_length;
+    uint32_t reconnectSec;   // current reconnect interval (0: not backed off)
+    time_t nextConnectTime;  // connect is not tried until this time (monotonic)
+    int window;     // count of requests in flight (1: one by one)
+    uint32_t responseTimeoutMs;
+    ModbusTcpError lastError;  // result of the last request
+
+    // asynchronous transaction (ModbusTCP_ReadRegistersAsync())
+    ASYNC_STATE asyncState;
+    EventRegistration* reg;
+    uint64_t deadlineMs;     // connect or the earliest response fails at this time
+    ModbusTcpReadRequest* asyncReqs;
+    int asyncCount;
+    int asyncNext;           // index of the request to be sent next
+    int asyncPending;        // count of requests in flight
+    int asyncSucceeded;
+    ModbusTcpInFlight inFlight[MODBUS_TCP_MAX_WINDOW];
+    uint8_t rxBuf[MODBUS_TCP_MAX_ADU_LENGTH];
+    int rxLen;
+    uint8_t txBuf[MODBUS_TCP_MAX_WINDOW * MIN_REQ_LENGTH];  // not sent yet (send buffer full)
+    int txLen;
+    ModbusTcpReadCallback asyncCallback;
+    void* asyncContext;
+    struct ModbusTcpCtx* nextActive;  // list of contexts in transaction
 }ModbusTcpCtx;
 
+// event loop for the asynchronous transactions
+static struct {
+    EventLoop* eventLoop;
+    EventLoopTimer* timer;   // fires at the earliest deadline
+    uint64_t timerMs;        // deadline the timer is armed at (0: disarmed)
+    ModbusTcpCtx* active;    // contexts in transaction
+} sAsync = { NULL, NULL, 0, NULL };
+
+static time_t
+ModbusTCP_MonotonicSec(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static uint64_t
+ModbusTCP_MonotonicMs(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)(ts.tv_nsec / 1000000);
+}
+
+static bool
+ModbusTCP_WaitUntil(ModbusTcpCtx* me, short events, uint64_t deadlineMs) {
+    // wait for the non-blocking socket (synchronous transaction),
+    // returns false if the deadline has passed
+    struct pollfd pfd = { .fd = me->socket, .events = events, .revents = 0 };
+    int rc;
+
+    do {
+        uint64_t now = ModbusTCP_MonotonicMs();
+
+        if (now >= deadlineMs) {
+            return false;
+        }
+        rc = poll(&pfd, 1, (int)(deadlineMs - now));
+    } while (rc == -1 && errno == EINTR);
+
+    return rc == 1;
+}
+
+static void
+ModbusTCP_FailRequests(ModbusTcpReadRequest* reqs, int count, ModbusTcpError err) {
+    // requests not answered fail with the error of the connection
+    for (int i = 0; i < count; i++) {
+        if (! reqs[i].result && reqs[i].error == MODBUS_TCP_SUCCESS) {
+            reqs[i].error = err;
+        }
+    }
+}
+
+static void
+ModbusTCP_ArmAsyncTimer(void) {
+    // one-shot at the earliest deadline of the contexts in transaction
+    uint64_t deadlineMs = UINT64_MAX;
+    ModbusTcpCtx* curs;
+
+    for (curs = sAsync.active; curs != NULL; curs = curs->nextActive) {
+        if (curs->deadlineMs < deadlineMs) {
+            deadlineMs = curs->deadlineMs;
+        }
+    }
+    if (deadlineMs == UINT64_MAX) {
+        if (sAsync.timerMs != 0) {
+            DisarmEventLoopTimer(sAsync.timer);
+            sAsync.timerMs = 0;
+        }
+    } else if (deadlineMs != sAsync.timerMs) {
+        uint64_t now = ModbusTCP_MonotonicMs();
+        uint64_t delayMs = (deadlineMs > now) ? deadlineMs - now : 1;  // 0 disarms
+        const struct timespec delay = {
+            .tv_sec = (time_t)(delayMs / 1000), .tv_nsec = (long)(delayMs % 1000) * 1000000 };
+
+        SetEventLoopTimerOneShot(sAsync.timer, &delay);
+        sAsync.timerMs = deadlineMs;
+    }
+}
+
+static void
+ModbusTCP_DetachAsync(ModbusTcpCtx* me) {
+    // stop watching the socket and the timeout
+    ModbusTcpCtx** link;
+
+    if (me->reg != NULL) {
+        EventLoop_UnregisterIo(sAsync.eventLoop, me->reg);
+        me->reg = NULL;
+    }
+    for (link = &sAsync.active; *link != NULL; link = &(*link)->nextActive) {
+        if (*link == me) {
+            *link = me->nextActive;
+            break;
+        }
+    }
+    me->nextActive = NULL;
+    me->asyncState = ASYNC_IDLE;
+    ModbusTCP_ArmAsyncTimer();
+}
+
+static void
+ModbusTCP_CompleteAsync(ModbusTcpCtx* me, bool disconnect) {
+    // the requests not answered yet fail if disconnected
+    ModbusTCP_DetachAsync(me);
+    if (disconnect && me->socket != -1) {
+        close(me->socket);
+        me->socket = -1;
+    }
+    me->asyncCallback(me->asyncContext, me->asyncReqs, me->asyncCount, me->asyncSucceeded);
+}
+
+static void
+ModbusTCP_Fail(ModbusTcpCtx* me, ModbusTcpError err) {
+    // the stream can not be trusted any more, close the connection
+    me->lastError = err;
+    if (me->asyncState != ASYNC_IDLE) {
+        ModbusTCP_FailRequests(me->asyncReqs, me->asyncCount, err);
+    }
+    ModbusTCP_Disconnect(me);
+}
+
+// MBAP header
+void
+ModbusTCP_SetMbapHeader(uint8_t* adu, uint16_t transactionId, uint8_t unitId, int pduLength) {
+    // length field counts the unit identifier and the PDU
+    int mbap_length = pduLength + 1;
+
+    adu[0] = (uint8_t)(transactionId >> 8);
+    adu[1] = (uint8_t)(transactionId & 0x00ff);
+    adu[2] = 0;
+    adu[3] = 0;
+    adu[4] = (uint8_t)(mbap_length >> 8);
+    adu[5] = (uint8_t)(mbap_length & 0x00ff);
+    adu[6] = unitId;
+}
+
+int
+ModbusTCP_GetAduLength(const uint8_t* adu, int size) {
+    int mbap_length;
+
+    if (size < MODBUS_TCP_MBAP_LENGTH) {
+        return 0;
+    }
+    mbap_length = (adu[4] << 8) | adu[5];
+    if (adu[2] != 0 || adu[3] != 0
+    ||  mbap_length < 2 || mbap_length + 6 > MODBUS_TCP_MAX_ADU_LENGTH) {
+        return -1;  // not Modbus protocol, or no function code
+    }
+
+    return mbap_length + 6;
+}
+
 static int
 ModbusTCP_CreateRequestMsg(ModbusTcpCtx* me, uint8_t unitId, int function, int addr, int nb, uint8_t *req) {
 
-    int mbap_length = MODBUS_TCP_PRESET_REQ_LENGTH - 6;
-
     if (me->t_id < UINT16_MAX) {
         me->t_id++;
     }
@@ -82,140 +283,364 @@ ModbusTCP_CreateRequestMsg(ModbusTcpCtx* me, uint8_t unitId, int function, int a
         me->t_id = 0;
     }
 
-    req[0] = (uint8_t)(me->t_id >> 8);
-    req[1] = (uint8_t)(me->t_id & 0x00ff);
-    req[2] = 0;
-    req[3] = 0;
-    // [4][5] skip
-    req[6] = unitId;
+    ModbusTCP_SetMbapHeader(req, me->t_id, unitId,
+        MODBUS_TCP_PRESET_REQ_LENGTH - MODBUS_TCP_MBAP_LENGTH);
     req[7] = (uint8_t)function;
     req[8] = (uint8_t)(addr >> 8);
     req[9] = (uint8_t)(addr & 0x00ff);
     req[10] = (uint8_t)(nb >> 8);
     req[11] = (uint8_t)(nb & 0x00ff);
 
-    req[4] = (uint8_t)(mbap_length >> 8);
-    req[5] = (uint8_t)(mbap_length & 0x00FF);
-
     return MODBUS_TCP_PRESET_REQ_LENGTH;
 }
 
 static int 
 ModbusTCP_CheckResponseMsg(ModbusTcpCtx* me, uint8_t* req, uint8_t* rsp){
+    // returns count of read/written values, -1 if failed
     int rc = 0;
     const int offset = me->header_length;
     const int function = rsp[offset];
+    const int pdu_length = ((rsp[4] << 8) | rsp[5]) - 1;
     int req_calc_length = 0;
     int rsp_calc_length = 0;
 
     if (req[0] != rsp[0] || req[1] != rsp[1]) {
+        // out of sync with the server, start over with new connection
+        ModbusTCP_Fail(me, MODBUS_TCP_ERR_SYNC);
+        return -1;
+    }
+
+    if (function == (req[offset] | MODBUS_EXCEPTION_FLAG)) {
+        me->lastError = MODBUS_TCP_ERR_EXCEPTION;
         return -1;
     }
+    me->lastError = MODBUS_TCP_ERR_RESPONSE;
 
     if (rsp[2] != 0x0 && rsp[3] != 0x0) {
         return -1;
     }
 
-    if (function >= 0x80) {
+    if (function >= 0x80 || function != req[offset]) {
         return -1;
     }
 
     switch (function) {
+    case FC_READ_COILS:
+    case FC_READ_DISCRETE_INPUTS:
     case FC_READ_HOLDING_REGISTER:
     case FC_READ_INPUT_REGISTERS:
+        // byte count must agree with the request and the MBAP length
         req_calc_length = (req[offset + 3] << 8) + req[offset + 4];
-        rsp_calc_length = (rsp[offset + 1] / 2);
+        rsp_calc_length = (rsp[offset + 1] == MODBUS_READ_DATA_BYTES(function, req_calc_length)
+            && pdu_length == 2 + rsp[offset + 1]) ? req_calc_length : 0;
         break;
-    default:
-        req_calc_length = rsp_calc_length = 1;
+    case FC_WRITE_FORCE_SINGLE_COIL:
+    case FC_WRITE_SINGLE_REGISTER:
+    case FC_WRITE_MULTIPLE_COILS:
+    case FC_WRITE_MULTIPLE_REGISTERS:
+        // echo of the address and the value/count
+        req_calc_length = 1;
+        rsp_calc_length = (pdu_length == 5
+            && 0 == memcmp(&req[offset + 1], &rsp[offset + 1], 4)) ? 1 : 0;
         break;
+    default:
+        return -1;
     }
 
-    if (req_calc_length == rsp_calc_length) {
+    if (req_calc_length == rsp_calc_length && rsp_calc_length > 0) {
         rc = rsp_calc_length;
+        me->lastError = MODBUS_TCP_SUCCESS;
     }
 
     return rc;
 }
 
+static bool
+ModbusTCP_SendMsg(ModbusTcpCtx* me, const uint8_t* req, int length, uint64_t deadlineMs) {
+    // the connection is closed if broken (reconnected by ModbusTCP_Connect()),
+    // waits until deadlineMs at most if the send buffer is full
+    int sent = 0;
+
+    if (me->socket == -1) {
+        me->lastError = MODBUS_TCP_ERR_CONNECT;
+        return false;
+    }
+    while (sent < length) {
+        ssize_t rc = send(me->socket, (const char*)req + sent, (size_t)(length - sent), MSG_NOSIGNAL);
+
+        if (rc < 0 && (errno == EAGAIN || errno == EINTR)) {
+            if (ModbusTCP_WaitUntil(me, POLLOUT, deadlineMs)) {
+                continue;
+            }
+        }
+        if (rc <= 0) {
+            ModbusTCP_Fail(me, MODBUS_TCP_ERR_SEND);
+            return false;
+        }
+        sent += (int)rc;
+    }
+    return true;
+}
+
+static bool
+ModbusTCP_FlushAsync(ModbusTcpCtx* me) {
+    // send what the send buffer takes, the rest is sent when the
+    // socket gets writable again; false if closed by the failure
+    const bool wasWaiting = (me->txLen > 0);
+
+    while (me->txLen > 0) {
+        ssize_t rc = send(me->socket, (const char*)me->txBuf, (size_t)me->txLen, MSG_NOSIGNAL);
+
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rc < 0 && errno == EAGAIN) {
+            break;
+        }
+        if (rc <= 0) {
+            ModbusTCP_Fail(me, MODBUS_TCP_ERR_SEND);
+            return false;
+        }
+        me->txLen -= (int)rc;
+        memmove(me->txBuf, me->txBuf + rc, (size_t)me->txLen);
+    }
+    if (wasWaiting != (me->txLen > 0)
+    &&  0 != EventLoop_ModifyIoEvents(sAsync.eventLoop, me->reg,
+            (me->txLen > 0) ? (EventLoop_Input | EventLoop_Output) : EventLoop_Input)) {
+        ModbusTCP_Fail(me, MODBUS_TCP_ERR_SEND);
+        return false;
+    }
+    return true;
+}
+
+static bool
+ModbusTCP_SendMsgAsync(ModbusTcpCtx* me, const uint8_t* req, int length) {
+    // queue behind the bytes not sent yet, never waits
+    if (me->socket == -1) {
+        me->lastError = MODBUS_TCP_ERR_CONNECT;
+        return false;
+    }
+    if (me->txLen + length > (int)sizeof(me->txBuf)) {
+        ModbusTCP_Fail(me, MODBUS_TCP_ERR_SEND);
+        return false;
+    }
+    memcpy(me->txBuf + me->txLen, req, (size_t)length);
+    me->txLen += length;
+
+    return ModbusTCP_FlushAsync(me);
+}
+
 static int
-ModbusTCP_RecieveMsg(ModbusTcpCtx* me, uint8_t* msg) {
+ModbusTCP_RecieveMsg(ModbusTcpCtx* me, uint8_t* msg, uint64_t deadlineMs) {
+    // read MBAP header, then exactly the rest of the ADU of its length
+    // field, all by deadlineMs; returns the ADU length, or -1 with the
+    // connection closed (lastError tells why)
     int rc = 0;
     int rsp_length = 0;
     int msg_length = 0;
-    PARSE_STEP step = PARSE_FUNCTION;
+    PARSE_STEP step = PARSE_HEADER;
 
-    rsp_length = me->header_length + 1;
+    rsp_length = me->header_length;
 
     while (rsp_length != 0) {
+        if (! ModbusTCP_WaitUntil(me, POLLIN, deadlineMs)) {
+            ModbusTCP_Fail(me, MODBUS_TCP_ERR_TIMEOUT);
+            return -1;
+        }
         rc = recv(me->socket, (char*)msg + msg_length, (size_t)rsp_length, 0);
+        if (rc < 0 && (errno == EAGAIN || errno == EINTR)) {
+            continue;
+        }
+        if (rc <= 0) {
+            ModbusTCP_Fail(me, MODBUS_TCP_ERR_CLOSED);
+            return -1;
+        }
         msg_length += rc;
         rsp_length -= rc;
 
-        if (rsp_length == 0) {
-            switch (step) {
-            case PARSE_FUNCTION:
-                if (msg[me->header_length] == FC_WRITE_SINGLE_REGISTER) {
-                    rsp_length = 4;
-                }
-                else {
-                    rsp_length = 1;
-                }
-                step = PARSE_META;
-                break;
-            case PARSE_META:
-                if (msg[me->header_length] == FC_READ_HOLDING_REGISTER) {
-                    rsp_length = msg[me->header_length + 1];
-                }
-                else {
-                    rsp_length = 0;
-                }
-                step = PARSE_DATA;
-                break;
-            default:
-                break;
+        if (rsp_length == 0 && step == PARSE_HEADER) {
+            int adu_length = ModbusTCP_GetAduLength(msg, msg_length);
+
+            if (adu_length < 0) {
+                ModbusTCP_Fail(me, MODBUS_TCP_ERR_FRAME);
+                return -1;
             }
+            rsp_length = adu_length - msg_length;
+            step = PARSE_PDU;
         }
     }
     return msg_length;
 }
 
+static void
+ModbusTCP_GetReadData(ModbusTcpCtx* me, const uint8_t* rsp, int count, unsigned short* dst) {
+    // registers are big endian, bits are packed into words (LSB first)
+    const int function = rsp[me->header_length];
+    const uint8_t* data = &rsp[me->header_length + 2];
+
+    if (MODBUS_IS_BIT_READ(function)) {
+        const int bytes = MODBUS_READ_DATA_BYTES(function, count);
+
+        for (int i = 0; i < bytes; i += 2) {
+            dst[i >> 1] = (unsigned short)(data[i] | ((i + 1 < bytes) ? (data[i + 1] << 8) : 0));
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            dst[i] = (unsigned short)((data[i << 1] << 8) | data[(i << 1) + 1]);
+        }
+    }
+}
+
 static bool
-ModbusTCP_ReadRegister(ModbusTcpCtx* me, int unitId, int regAddr, int function, unsigned short* dst) {
+ModbusTCP_Transact(ModbusTcpCtx* me, uint8_t* req, int req_length, uint8_t* rsp, int* count) {
+    // send a request and take its response (synchronous)
+    const uint64_t deadlineMs = ModbusTCP_MonotonicMs() + me->responseTimeoutMs;
     int rc;
-    int req_length;
-    uint8_t req[MIN_REQ_LENGTH];
-    uint8_t rsp[MAX_MESSAGE_LENGTH];
-    int length = 1;
-    int sendSize = 0;
 
-    req_length = ModbusTCP_CreateRequestMsg(me, (uint8_t)unitId, function, regAddr, length, req);
-    rc = req_length;
+    if (! ModbusTCP_SendMsg(me, req, req_length, deadlineMs)) {
+        return false;
+    }
+
+    rc = ModbusTCP_RecieveMsg(me, rsp, deadlineMs);
+    if (rc == -1) {
+        return false;
+    }
 
-    while (rc > 0) {
-        sendSize = send(me->socket, (const char*)req + sendSize, (size_t)rc, MSG_NOSIGNAL);
-        rc -= sendSize;
+    rc = ModbusTCP_CheckResponseMsg(me, req, rsp);
+    if (rc <= 0) {
+        return false;
     }
+    *count = rc;
 
-    if (rc >= 0) {
-        int offset;
-        int i;
+    return true;
+}
 
-        rc = ModbusTCP_RecieveMsg(me, rsp);
+static bool
+ModbusTCP_CheckReadRequests(ModbusTcpReadRequest* reqs, int count) {
+    for (int i = 0; i < count; i++) {
+        reqs[i].result = false;
+        reqs[i].error = MODBUS_TCP_SUCCESS;
+        if (reqs[i].length < 1 || reqs[i].length > MODBUS_MAX_READ_LENGTH(reqs[i].function)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool
+ModbusTCP_SendRequests(ModbusTcpCtx* me, ModbusTcpInFlight* inFlight,
+    ModbusTcpReadRequest* reqs, int count, int* next, int* pending, bool wait) {
+    // fill the window with the requests not sent yet, the deadline of
+    // each request starts when it is sent
+    for (int slot = 0; slot < me->window && *next < count; slot++) {
+        bool sent;
 
-        rc = ModbusTCP_CheckResponseMsg(me, req, rsp);
-        if (rc == -1)
+        if (inFlight[slot].index != -1) {
+            continue;
+        }
+        (void)ModbusTCP_CreateRequestMsg(me, (uint8_t)reqs[*next].unitId, reqs[*next].function,
+            reqs[*next].regAddr, reqs[*next].length, inFlight[slot].req);
+        inFlight[slot].deadlineMs = ModbusTCP_MonotonicMs() + me->responseTimeoutMs;
+        if (wait) {
+            sent = ModbusTCP_SendMsg(me, inFlight[slot].req, MODBUS_TCP_PRESET_REQ_LENGTH,
+                inFlight[slot].deadlineMs);
+        } else {
+            sent = ModbusTCP_SendMsgAsync(me, inFlight[slot].req, MODBUS_TCP_PRESET_REQ_LENGTH);
+        }
+        if (! sent) {
             return false;
+        }
+        inFlight[slot].index = (*next)++;
+        (*pending)++;
+    }
+    return true;
+}
 
-        offset = me->header_length;
+static uint64_t
+ModbusTCP_GetEarliestDeadline(ModbusTcpCtx* me, const ModbusTcpInFlight* inFlight) {
+    uint64_t deadlineMs = UINT64_MAX;
 
-        for (i = 0; i < rc; i++) {
-            dst[i] = (unsigned short)((rsp[offset + 2 + (i << 1)] << 8) |
-                rsp[offset + 3 + (i << 1)]);
+    for (int slot = 0; slot < me->window; slot++) {
+        if (inFlight[slot].index != -1 && inFlight[slot].deadlineMs < deadlineMs) {
+            deadlineMs = inFlight[slot].deadlineMs;
         }
     }
+    return deadlineMs;
+}
 
-    return rc;
+static int
+ModbusTCP_TakeResponse(ModbusTcpCtx* me, ModbusTcpInFlight* inFlight,
+    ModbusTcpReadRequest* reqs, uint8_t* rsp) {
+    // returns 1 if read, 0 if failed, -1 if not of the requests in flight
+    uint16_t tid = (uint16_t)((rsp[0] << 8) | rsp[1]);
+    int slot;
+    int rc;
+
+    for (slot = 0; slot < me->window; slot++) {
+        if (inFlight[slot].index != -1
+        &&  tid == (uint16_t)((inFlight[slot].req[0] << 8) | inFlight[slot].req[1])) {
+            break;
+        }
+    }
+    if (slot == me->window) {
+        me->lastError = MODBUS_TCP_ERR_SYNC;
+        return -1;
+    }
+
+    rc = ModbusTCP_CheckResponseMsg(me, inFlight[slot].req, rsp);
+    if (rc > 0) {
+        ModbusTCP_GetReadData(me, rsp, rc, reqs[inFlight[slot].index].dst);
+        reqs[inFlight[slot].index].result = true;
+    } else {
+        reqs[inFlight[slot].index].error = me->lastError;
+    }
+    inFlight[slot].index = -1;
+
+    return (rc > 0) ? 1 : 0;
+}
+
+// Read several registers, pipelined in the window of the connection
+int
+ModbusTCP_ReadRegisters(ModbusTcpCtx* me, ModbusTcpReadRequest* reqs, int count) {
+    // send requests back-to-back up to the window, then take the
+    // responses in order of arrival and send the next request for each,
+    // the rest fails if the connection is broken or a response is late
+    ModbusTcpInFlight inFlight[MODBUS_TCP_MAX_WINDOW];
+    uint8_t rsp[MAX_MESSAGE_LENGTH];
+    int next = 0;
+    int pending = 0;
+    int succeeded = 0;
+
+    if (! ModbusTCP_CheckReadRequests(reqs, count)) {
+        return 0;
+    }
+    for (int i = 0; i < me->window; i++) {
+        inFlight[i].index = -1;
+    }
+
+    while (next < count || pending > 0) {
+        int rc;
+
+        if (! ModbusTCP_SendRequests(me, inFlight, reqs, count, &next, &pending, true)) {
+            break;
+        }
+
+        rc = ModbusTCP_RecieveMsg(me, rsp, ModbusTCP_GetEarliestDeadline(me, inFlight));
+        if (rc == -1) {
+            break;
+        }
+        rc = ModbusTCP_TakeResponse(me, inFlight, reqs, rsp);
+        if (rc == -1) {
+            // not of the requests in flight, out of sync
+            ModbusTCP_Fail(me, MODBUS_TCP_ERR_SYNC);
+            break;
+        }
+        succeeded += rc;
+        pending--;
+    }
+    ModbusTCP_FailRequests(reqs, count, me->lastError);
+
+    return succeeded;
 }
 
 // Initialization and cleanup
@@ -225,10 +650,21 @@ ModbusTCP_Initialize(const char* ip, int port) {
     size_t dest_size;
 
     newObj = (ModbusTcpCtx*)malloc(sizeof(ModbusTcpCtx));
+    if (newObj == NULL) {
+        return NULL;
+    }
 
-    newObj->socket = 0;
+    newObj->socket = -1;
     newObj->port = port;
     newObj->t_id = 0;
+    newObj->reconnectSec = 0;
+    newObj->nextConnectTime = 0;
+    newObj->window = 1;
+    newObj->responseTimeoutMs = MODBUS_TCP_DEFAULT_TIMEOUT_MS;
+    newObj->lastError = MODBUS_TCP_SUCCESS;
+    newObj->asyncState = ASYNC_IDLE;
+    newObj->reg = NULL;
+    newObj->nextActive = NULL;
 
     dest_size = sizeof(char) * 16;
     strncpy(newObj->ip, ip, dest_size);
@@ -241,19 +677,36 @@ ModbusTCP_Initialize(const char* ip, int port) {
 
 void
 ModbusTCP_Destroy(ModbusTcpCtx* me) {
+    ModbusTCP_Disconnect(me);
     free(me);
 }
 
-// Connect
-bool 
-ModbusTCP_Connect(ModbusTcpCtx* me) {
+static void
+ModbusTCP_SetKeepAlive(int sock) {
+    // best effort, the connection works without keepalive
+    int option = 1;
+
+    if (setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, (const void*)&option, sizeof(int)) == -1) {
+        return;
+    }
+    option = MODBUS_TCP_KEEPALIVE_IDLE_SEC;
+    (void)setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, (const void*)&option, sizeof(int));
+    option = MODBUS_TCP_KEEPALIVE_INTVL_SEC;
+    (void)setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, (const void*)&option, sizeof(int));
+    option = MODBUS_TCP_KEEPALIVE_COUNT;
+    (void)setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, (const void*)&option, sizeof(int));
+}
+
+static int
+ModbusTCP_Open(ModbusTcpCtx* me) {
+    // non-blocking, returns 1 if connected, 0 if connecting, -1 if failed
     struct sockaddr_in addr;
     int rc = 0;
     int option;
 
-    me->socket = socket(PF_INET, SOCK_STREAM, 0);
+    me->socket = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (me->socket == -1) {
-        return false;
+        return -1;
     }
 
     option = 1;
@@ -263,65 +716,439 @@ ModbusTCP_Connect(ModbusTcpCtx* me) {
     if (rc == -1) {
         close(me->socket);
         me->socket = -1;
-        return false;
+        return -1;
     }
+    ModbusTCP_SetKeepAlive(me->socket);
 
     addr.sin_family = AF_INET;
     addr.sin_port = htons(me->port);
     addr.sin_addr.s_addr = inet_addr(me->ip);
 
     rc = connect(me->socket, (struct sockaddr*)&addr, sizeof(addr));
+    if (rc == 0) {
+        return 1;
+    }
+    if (errno == EINPROGRESS) {
+        return 0;
+    }
 
-    if (rc == -1) {
-        close(me->socket);
-        me->socket = -1;
+    close(me->socket);
+    me->socket = -1;
+    return -1;
+}
+
+static bool
+ModbusTCP_IsConnected(ModbusTcpCtx* me) {
+    // result of non-blocking connect
+    int err = 0;
+    socklen_t len = sizeof(err);
+
+    return getsockopt(me->socket, SOL_SOCKET, SO_ERROR, (void*)&err, &len) == 0
+        && err == 0;
+}
+
+static bool
+ModbusTCP_IsBackedOff(ModbusTcpCtx* me) {
+    return me->reconnectSec != 0 && ModbusTCP_MonotonicSec() < me->nextConnectTime;
+}
+
+static void
+ModbusTCP_ConnectFailed(ModbusTcpCtx* me) {
+    // connect is not tried until the reconnect interval elapses
+    if (me->reconnectSec == 0) {
+        me->reconnectSec = MODBUS_TCP_RECONNECT_MIN_SEC;
+    } else if (me->reconnectSec < MODBUS_TCP_RECONNECT_MAX_SEC) {
+        me->reconnectSec *= 2;
+        if (me->reconnectSec > MODBUS_TCP_RECONNECT_MAX_SEC) {
+            me->reconnectSec = MODBUS_TCP_RECONNECT_MAX_SEC;
+        }
+    }
+    me->nextConnectTime = ModbusTCP_MonotonicSec() + me->reconnectSec;
+}
+
+// Connect
+bool 
+ModbusTCP_Connect(ModbusTcpCtx* me) {
+    // keep the connection across the polling cycles, connect again
+    // if not connected (after the reconnect interval if failed)
+    int rc;
+
+    if (me->asyncState != ASYNC_IDLE) {
+        return false;  // in asynchronous transaction
+    }
+    if (me->socket != -1) {
+        return true;
+    }
+    if (ModbusTCP_IsBackedOff(me)) {
+        me->lastError = MODBUS_TCP_ERR_CONNECT;
         return false;
     }
 
-    return true;
+    rc = ModbusTCP_Open(me);
+    if (rc == 0
+    &&  ModbusTCP_WaitUntil(me, POLLOUT, ModbusTCP_MonotonicMs() + MODBUS_TCP_CONNECT_TIMEOUT_MS)
+    &&  ModbusTCP_IsConnected(me)) {
+        rc = 1;
+    }
+    if (rc == 1) {
+        me->reconnectSec = 0;
+        return true;
+    }
+    ModbusTCP_Fail(me, MODBUS_TCP_ERR_CONNECT);
+    ModbusTCP_ConnectFailed(me);
+    return false;
 }
 
 // Disconnect
 void 
 ModbusTCP_Disconnect(ModbusTcpCtx* me) {
-    close(me->socket);
-    me->socket = -1;
+    if (me->asyncState != ASYNC_IDLE) {
+        ModbusTCP_FailRequests(me->asyncReqs, me->asyncCount, MODBUS_TCP_ERR_CLOSED);
+        ModbusTCP_CompleteAsync(me, true);
+        return;
+    }
+    if (me->socket != -1) {
+        close(me->socket);
+        me->socket = -1;
+    }
+}
+
+// Count of requests sent ahead of the responses
+void
+ModbusTCP_SetWindow(ModbusTcpCtx* me, int window) {
+    if (window < 1) {
+        window = 1;
+    } else if (window > MODBUS_TCP_MAX_WINDOW) {
+        window = MODBUS_TCP_MAX_WINDOW;
+    }
+    me->window = window;
+}
+
+// Response timeout of each request
+void
+ModbusTCP_SetResponseTimeout(ModbusTcpCtx* me, uint32_t timeoutMs) {
+    if (timeoutMs < MODBUS_TCP_MIN_TIMEOUT_MS) {
+        timeoutMs = MODBUS_TCP_MIN_TIMEOUT_MS;
+    } else if (timeoutMs > MODBUS_TCP_MAX_TIMEOUT_MS) {
+        timeoutMs = MODBUS_TCP_MAX_TIMEOUT_MS;
+    }
+    me->responseTimeoutMs = timeoutMs;
+}
+
+// Result of the last request
+ModbusTcpError
+ModbusTCP_GetLastError(ModbusTcpCtx* me) {
+    return me->lastError;
+}
+
+static bool
+ModbusTCP_SendNextAsync(ModbusTcpCtx* me) {
+    // returns false if completed by disconnection
+    if (! ModbusTCP_SendRequests(me, me->inFlight, me->asyncReqs, me->asyncCount,
+            &me->asyncNext, &me->asyncPending, false)) {
+        return false;
+    }
+    me->deadlineMs = ModbusTCP_GetEarliestDeadline(me, me->inFlight);
+    ModbusTCP_ArmAsyncTimer();
+    return true;
+}
+
+static void
+ModbusTCP_StartTransaction(ModbusTcpCtx* me) {
+    me->asyncState = ASYNC_TRANSACTING;
+    if (0 != EventLoop_ModifyIoEvents(sAsync.eventLoop, me->reg, EventLoop_Input)) {
+        ModbusTCP_Fail(me, MODBUS_TCP_ERR_CONNECT);
+        return;
+    }
+    (void)ModbusTCP_SendNextAsync(me);
+}
+
+static void
+ModbusTCP_AsyncEventHandler(EventLoop* el, int fd, EventLoop_IoEvents events, void* context) {
+    // take the responses in order of arrival and send the next
+    // request for each, complete when all of them are answered
+    ModbusTcpCtx* me = (ModbusTcpCtx*)context;
+    ssize_t rc;
+    int aduLen;
+
+    if (me->asyncState == ASYNC_CONNECTING) {
+        if (! ModbusTCP_IsConnected(me)) {
+            ModbusTCP_ConnectFailed(me);
+            ModbusTCP_Fail(me, MODBUS_TCP_ERR_CONNECT);
+            return;
+        }
+        me->reconnectSec = 0;
+        ModbusTCP_StartTransaction(me);
+        return;
+    }
+
+    if ((events & EventLoop_Output) != 0) {
+        // resume the requests left in the send buffer
+        if (! ModbusTCP_FlushAsync(me)) {
+            return;
+        }
+        if ((events & ~EventLoop_Output) == 0) {
+            return;
+        }
+    }
+
+    rc = recv(fd, me->rxBuf + me->rxLen, sizeof(me->rxBuf) - (size_t)me->rxLen, 0);
+    if (rc <= 0) {
+        if (rc < 0 && (errno == EAGAIN || errno == EINTR)) {
+            return;
+        }
+        ModbusTCP_Fail(me, MODBUS_TCP_ERR_CLOSED);  // closed by the server, or broken
+        return;
+    }
+    me->rxLen += (int)rc;
+
+    while (0 != (aduLen = ModbusTCP_GetAduLength(me->rxBuf, me->rxLen))) {
+        int taken;
+
+        if (aduLen < 0) {
+            ModbusTCP_Fail(me, MODBUS_TCP_ERR_FRAME);  // not Modbus TCP
+            return;
+        }
+        if (aduLen > me->rxLen) {
+            break;  // wait for the rest
+        }
+        taken = ModbusTCP_TakeResponse(me, me->inFlight, me->asyncReqs, me->rxBuf);
+        if (taken == -1) {
+            ModbusTCP_Fail(me, MODBUS_TCP_ERR_SYNC);  // out of sync
+            return;
+        }
+        me->asyncSucceeded += taken;
+        me->asyncPending--;
+        me->rxLen -= aduLen;
+        memmove(me->rxBuf, me->rxBuf + aduLen, (size_t)me->rxLen);
+    }
+
+    if (me->asyncPending == 0 && me->asyncNext == me->asyncCount) {
+        ModbusTCP_CompleteAsync(me, false);
+        return;
+    }
+    (void)ModbusTCP_SendNextAsync(me);
+}
+
+static void
+ModbusTCP_AsyncTimerHandler(EventLoopTimer* timer) {
+    // give up the connections of the transactions timed out, the
+    // list is scanned again after each as the callback may change it
+    uint64_t now;
+    ModbusTcpCtx* curs;
+
+    if (ConsumeEventLoopTimerEvent(timer) != 0) {
+        return;
+    }
+    sAsync.timerMs = 0;
+
+    now = ModbusTCP_MonotonicMs();
+    do {
+        for (curs = sAsync.active; curs != NULL; curs = curs->nextActive) {
+            if (now >= curs->deadlineMs) {
+                break;
+            }
+        }
+        if (curs == NULL) {
+            break;
+        }
+        if (curs->asyncState == ASYNC_CONNECTING) {
+            ModbusTCP_ConnectFailed(curs);
+            ModbusTCP_Fail(curs, MODBUS_TCP_ERR_CONNECT);
+        } else {
+            ModbusTCP_Fail(curs, MODBUS_TCP_ERR_TIMEOUT);
+        }
+    } while (true);
+    ModbusTCP_ArmAsyncTimer();
+}
+
+// Asynchronous transaction in the event loop
+bool
+ModbusTCP_RegisterEventLoop(EventLoop* eventLoop) {
+    if (sAsync.eventLoop != NULL) {
+        return true;
+    }
+    sAsync.timer = CreateEventLoopDisarmedTimer(eventLoop, ModbusTCP_AsyncTimerHandler);
+    if (sAsync.timer == NULL) {
+        return false;
+    }
+    sAsync.eventLoop = eventLoop;
+
+    return true;
+}
+
+void
+ModbusTCP_UnregisterEventLoop(void) {
+    // discard the transactions in progress (without callback)
+    while (sAsync.active != NULL) {
+        ModbusTcpCtx* me = sAsync.active;
+
+        ModbusTCP_DetachAsync(me);
+        if (me->socket != -1) {
+            close(me->socket);
+            me->socket = -1;
+        }
+    }
+    DisposeEventLoopTimer(sAsync.timer);
+    sAsync.timer = NULL;
+    sAsync.timerMs = 0;
+    sAsync.eventLoop = NULL;
+}
+
+bool
+ModbusTCP_ReadRegistersAsync(ModbusTcpCtx* me, ModbusTcpReadRequest* reqs, int count,
+    ModbusTcpReadCallback callback, void* context) {
+    // connect (non-blocking) if not connected, then transact as
+    // ModbusTCP_ReadRegisters() does, driven by the event loop
+    int rc = 1;
+
+    if (sAsync.eventLoop == NULL || me->asyncState != ASYNC_IDLE || count <= 0
+    ||  ! ModbusTCP_CheckReadRequests(reqs, count)) {
+        return false;
+    }
+
+    for (int i = 0; i < me->window; i++) {
+        me->inFlight[i].index = -1;
+    }
+    me->asyncReqs = reqs;
+    me->asyncCount = count;
+    me->asyncNext = 0;
+    me->asyncPending = 0;
+    me->asyncSucceeded = 0;
+    me->asyncCallback = callback;
+    me->asyncContext = context;
+    me->rxLen = 0;
+    me->txLen = 0;
+
+    if (me->socket == -1) {
+        if (ModbusTCP_IsBackedOff(me)) {
+            rc = -1;
+        } else if (-1 == (rc = ModbusTCP_Open(me))) {
+            ModbusTCP_ConnectFailed(me);
+        }
+    }
+    if (rc != -1) {
+        me->reg = EventLoop_RegisterIo(sAsync.eventLoop, me->socket,
+            (rc == 0) ? EventLoop_Output : EventLoop_Input, ModbusTCP_AsyncEventHandler, me);
+        if (me->reg == NULL) {
+            ModbusTCP_Disconnect(me);
+            rc = -1;
+        }
+    }
+    if (rc == -1) {
+        ModbusTCP_FailRequests(reqs, count, MODBUS_TCP_ERR_CONNECT);
+        me->lastError = MODBUS_TCP_ERR_CONNECT;
+        callback(context, reqs, count, 0);
+        return true;
+    }
+
+    me->nextActive = sAsync.active;
+    sAsync.active = me;
+    if (rc == 0) {
+        me->asyncState = ASYNC_CONNECTING;
+        me->deadlineMs = ModbusTCP_MonotonicMs() + MODBUS_TCP_CONNECT_TIMEOUT_MS;
+        ModbusTCP_ArmAsyncTimer();
+    } else {
+        ModbusTCP_StartTransaction(me);
+    }
+
+    return true;
+}
+
+// Read status/registers
+bool
+ModbusTCP_ReadRegister(ModbusTcpCtx* me, int unitId, int regAddr, int function,
+    unsigned short* dst, int length) {
+    int count;
+    uint8_t req[MIN_REQ_LENGTH];
+    uint8_t rsp[MAX_MESSAGE_LENGTH];
+
+    if (length < 1 || length > MODBUS_MAX_READ_LENGTH(function)) {
+        return false;
+    }
+
+    (void)ModbusTCP_CreateRequestMsg(me, (uint8_t)unitId, function, regAddr, length, req);
+    if (! ModbusTCP_Transact(me, req, MODBUS_TCP_PRESET_REQ_LENGTH, rsp, &count)) {
+        return false;
+    }
+    ModbusTCP_GetReadData(me, rsp, count, dst);
+
+    return true;
 }
 
 // Read single register
 bool 
 ModbusTCP_ReadSingleRegister(ModbusTcpCtx* me, int unitId, int regAddr, unsigned short* dst) {
-    return ModbusTCP_ReadRegister(me, unitId, regAddr, FC_READ_HOLDING_REGISTER, dst);
+    return ModbusTCP_ReadRegister(me, unitId, regAddr, FC_READ_HOLDING_REGISTER, dst, 1);
 }
 
 bool
 ModbusTCP_ReadSingleInputRegister(ModbusTcpCtx* me, int unitId, int regAddr, unsigned short* dst) {
-    return ModbusTCP_ReadRegister(me, unitId, regAddr, FC_READ_INPUT_REGISTERS, dst);
+    return ModbusTCP_ReadRegister(me, unitId, regAddr, FC_READ_INPUT_REGISTERS, dst, 1);
 }
 
-// Write single register
+// Write single coil/register (FC05/FC06)
 bool
-ModbusTCP_WriteSingleRegister(ModbusTcpCtx* me, int unitId, int regAddr, unsigned short value) {
-    int function = FC_WRITE_SINGLE_REGISTER;
-    int rc;
-    int req_length;
+ModbusTCP_WriteRegister(ModbusTcpCtx* me, int unitId, int regAddr, int function, unsigned short value) {
+    int count;
     uint8_t req[MIN_REQ_LENGTH];
     uint8_t rsp[MAX_MESSAGE_LENGTH];
-    int sendSize = 0;
 
-    req_length = ModbusTCP_CreateRequestMsg(me, (uint8_t)unitId, function, regAddr, (int)value, req);
-    rc = req_length;
-
-    while (rc > 0) {
-        sendSize = send(me->socket, (const char*)req + sendSize, (size_t)rc, MSG_NOSIGNAL);
-        rc -= sendSize;
+    if (function == FC_WRITE_FORCE_SINGLE_COIL) {
+        value = (value != 0) ? 0xff00 : 0x0000;
+    } else if (function != FC_WRITE_SINGLE_REGISTER) {
+        return false;
     }
 
-    if (rc >= 0) {
-        rc = ModbusTCP_RecieveMsg(me, rsp);
-        rc = ModbusTCP_CheckResponseMsg(me, req, rsp);
-        if (rc == -1)
+    (void)ModbusTCP_CreateRequestMsg(me, (uint8_t)unitId, function, regAddr, (int)value, req);
+    return ModbusTCP_Transact(me, req, MODBUS_TCP_PRESET_REQ_LENGTH, rsp, &count);
+}
+
+bool
+ModbusTCP_WriteSingleRegister(ModbusTcpCtx* me, int unitId, int regAddr, unsigned short value) {
+    return ModbusTCP_WriteRegister(me, unitId, regAddr, FC_WRITE_SINGLE_REGISTER, value);
+}
+
+// Write several coils/registers in a row (FC15/FC16)
+bool
+ModbusTCP_WriteRegisters(ModbusTcpCtx* me, int unitId, int regAddr, int function,
+    const unsigned short* values, int count) {
+    int byteCount;
+    int written;
+    uint8_t req[MODBUS_TCP_MAX_ADU_LENGTH];
+    uint8_t rsp[MAX_MESSAGE_LENGTH];
+    uint8_t* data = &req[MODBUS_TCP_PRESET_REQ_LENGTH + 1];
+
+    if (function == FC_WRITE_MULTIPLE_COILS) {
+        if (count < 1 || count > MODBUS_MAX_WRITE_COILS) {
             return false;
+        }
+        byteCount = (count + 7) / 8;
+    } else if (function == FC_WRITE_MULTIPLE_REGISTERS) {
+        if (count < 1 || count > MODBUS_MAX_WRITE_REGISTERS) {
+            return false;
+        }
+        byteCount = count * 2;
+    } else {
+        return false;
     }
-    return rc;
+
+    // MBAP header, function, register, count, byte count and values
+    (void)ModbusTCP_CreateRequestMsg(me, (uint8_t)unitId, function, regAddr, count, req);
+    ModbusTCP_SetMbapHeader(req, (uint16_t)((req[0] << 8) | req[1]), (uint8_t)unitId,
+        MODBUS_TCP_PRESET_REQ_LENGTH - MODBUS_TCP_MBAP_LENGTH + 1 + byteCount);
+    req[MODBUS_TCP_PRESET_REQ_LENGTH] = (uint8_t)byteCount;
+    memset(data, 0, (size_t)byteCount);
+    for (int i = 0; i < count; i++) {
+        if (function == FC_WRITE_MULTIPLE_COILS) {
+            if (values[i] != 0) {
+                data[i >> 3] |= (uint8_t)(1 << (i & 7));
+            }
+        } else {
+            data[i << 1] = (uint8_t)(values[i] >> 8);
+            data[(i << 1) + 1] = (uint8_t)(values[i] & 0x00ff);
+        }
+    }
+
+    return ModbusTCP_Transact(me, req, MODBUS_TCP_PRESET_REQ_LENGTH + 1 + byteCount, rsp, &written);
 }
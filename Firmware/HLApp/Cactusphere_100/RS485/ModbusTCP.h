@@ -26,25 +26,124 @@
 #define _MODBUS_TCP_H_
 
 #include <stdbool.h>
+#include <stdint.h>
+
+// MBAP header (shared by the client and the server)
+#define MODBUS_TCP_MBAP_LENGTH      7
+#define MODBUS_TCP_MAX_ADU_LENGTH   260
+
+// max count of requests in flight on a connection
+#define MODBUS_TCP_MAX_WINDOW       16
+
+// response timeout of a request [msec]
+#define MODBUS_TCP_DEFAULT_TIMEOUT_MS   1000
+#define MODBUS_TCP_MIN_TIMEOUT_MS       10
+#define MODBUS_TCP_MAX_TIMEOUT_MS       10000
+
+// result of a request
+typedef enum {
+    MODBUS_TCP_SUCCESS = 0,
+    // the connection is closed on these errors (and connected again
+    // by the next request)
+    MODBUS_TCP_ERR_CONNECT,     // not connected (connect failed or backed off)
+    MODBUS_TCP_ERR_SEND,        // broken on sending
+    MODBUS_TCP_ERR_TIMEOUT,     // no complete response by the deadline
+    MODBUS_TCP_ERR_CLOSED,      // closed by the server, or broken on receiving
+    MODBUS_TCP_ERR_FRAME,       // not Modbus TCP (invalid MBAP header)
+    MODBUS_TCP_ERR_SYNC,        // response to no request in flight
+    // the connection is kept on these errors
+    MODBUS_TCP_ERR_EXCEPTION,   // exception response
+    MODBUS_TCP_ERR_RESPONSE     // response does not agree with the request
+} ModbusTcpError;
+
+#define MODBUS_TCP_IS_CONNECTION_ERROR(err) \
+    ((err) != MODBUS_TCP_SUCCESS && (err) < MODBUS_TCP_ERR_EXCEPTION)
 
 typedef struct ModbusTcpCtx ModbusTcpCtx;
+typedef struct EventLoop EventLoop;
+
+// read request for ModbusTCP_ReadRegisters()
+typedef struct ModbusTcpReadRequest {
+    int             unitId;     // unit identifier
+    int             regAddr;    // first register address
+    int             function;   // function code (FC01-FC04)
+    int             length;     // read register count (bit count for FC01/FC02)
+    unsigned short* dst;        // buffer for read values (length, bits are packed LSB first)
+    bool            result;     // true if read successfully
+    ModbusTcpError  error;      // reason of failure (MODBUS_TCP_SUCCESS if read)
+} ModbusTcpReadRequest;
+
+// Callback of ModbusTCP_ReadRegistersAsync()
+//   succeeded is count of the requests read successfully
+typedef void (*ModbusTcpReadCallback)(void* context,
+    ModbusTcpReadRequest* reqs, int count, int succeeded);
+
+// Set MBAP header in front of the PDU (pduLength bytes from adu[7])
+extern void ModbusTCP_SetMbapHeader(uint8_t* adu, uint16_t transactionId, uint8_t unitId, int pduLength);
+
+// Length of the ADU at the head of the buffer
+//   returns 0 if the header is not received yet, -1 if the header is invalid
+extern int ModbusTCP_GetAduLength(const uint8_t* adu, int size);
 
 // Initialization and cleanup
 extern ModbusTcpCtx* ModbusTCP_Initialize(const char* ip, int port);
 extern void ModbusTCP_Destroy(ModbusTcpCtx* me);
 
 // Connect
+//   the connection is kept until disconnected (or broken), connect
+//   is tried again after the reconnect interval if failed
 extern bool ModbusTCP_Connect(ModbusTcpCtx* me);
 
 // Disvonnect
 extern void ModbusTCP_Disconnect(ModbusTcpCtx* me);
 
+// Count of requests sent ahead of the responses (1: one by one)
+extern void ModbusTCP_SetWindow(ModbusTcpCtx* me, int window);
+
+// Response timeout of each request [msec]
+//   a request fails when its response is not complete in this time
+//   after sent, however the server trickles it
+extern void ModbusTCP_SetResponseTimeout(ModbusTcpCtx* me, uint32_t timeoutMs);
+
+// Result of the last request
+extern ModbusTcpError ModbusTCP_GetLastError(ModbusTcpCtx* me);
+
+// Read several registers, pipelined in the window of the connection
+//   responses are matched by transaction identifier (returns count of
+//   succeeded requests)
+extern int ModbusTCP_ReadRegisters(ModbusTcpCtx* me, ModbusTcpReadRequest* reqs, int count);
+
+// Asynchronous transaction in the event loop
+//   connect and transactions are non-blocking, so the servers are read
+//   concurrently; the transaction in progress is discarded by unregister
+extern bool ModbusTCP_RegisterEventLoop(EventLoop* eventLoop);
+extern void ModbusTCP_UnregisterEventLoop(void);
+
+// Read several registers as ModbusTCP_ReadRegisters(), asynchronously
+//   returns false if not registered or in transaction; otherwise the
+//   callback is called on completion, timeout or disconnection (before
+//   return if the server is unreachable)
+extern bool ModbusTCP_ReadRegistersAsync(ModbusTcpCtx* me, ModbusTcpReadRequest* reqs, int count,
+    ModbusTcpReadCallback callback, void* context);
+
+// Read status/registers (FC01-FC04)
+//   up to MODBUS_MAX_READ_LENGTH(function), bits are packed LSB first
+extern bool ModbusTCP_ReadRegister(ModbusTcpCtx* me, int unitId, int regAddr, int function,
+    unsigned short* dst, int length);
+
 // Read 1byte holding register
 extern bool ModbusTCP_ReadSingleRegister(ModbusTcpCtx* me, int unitId, int regAddr, unsigned short* dst);
 
 // Read 1byte input register 
 extern bool ModbusTCP_ReadSingleInputRegister(ModbusTcpCtx* me, int unitId, int regAddr, unsigned short* dst);
 
+// Write single coil/register (FC05/FC06)
+extern bool ModbusTCP_WriteRegister(ModbusTcpCtx* me, int unitId, int regAddr, int function, unsigned short value);
+
 // Write 1byte
 extern bool ModbusTCP_WriteSingleRegister(ModbusTcpCtx* me, int unitId, int regAddr, unsigned short value);
+
+// Write several coils/registers in a row (FC15/FC16)
+extern bool ModbusTCP_WriteRegisters(ModbusTcpCtx* me, int unitId, int regAddr, int function,
+    const unsigned short* values, int count);
 #endif  // _MODBUS_TCP_H_
@@ -24,21 +24,50 @@
 
 #include "ModbusTcpDataFetchScheduler.h"
 
+#include <stdlib.h>
 #include <string.h>
 
+#include <applibs/log.h>
+
+#include "LibCloud.h"
 #include "LibModbusTcp.h"
+#include "ModbusDevConfig.h"
 #include "ModbusTcpDev.h"
 #include "ModbusTcpFetchItem.h"
 #include "ModbusTcpFetchTargets.h"
 #include "StringBuf.h"
 #include "TelemetryItems.h"
 
-typedef struct ModbusTcpDataFetchScheduler {
+typedef struct ModbusTcpDataFetchScheduler	ModbusTcpDataFetchScheduler;
+
+// acquisition target sliced from a read request
+typedef struct ModbusTcpScanItem {
+    const ModbusTcpFetchItem*	item;
+    int	reqIndex;       // read request which covers the item
+    int	offset;         // register/bit offset of the item in the request
+} ModbusTcpScanItem;
+
+// reading of one server, finished independently of the other servers
+typedef struct ModbusTcpServerScan {
+    ModbusTcpDataFetchScheduler*	owner;
+    char	devID[MODBUS_TCP_ID_SIZE];
+    uint32_t	timeStamp;      // acquisition time of the telemetry
+    bool	isCanceled;     // configuration changed during the reading
+    ModbusTcpScanItem*	items;      // acquisition targets of the server
+    int	itemCount;
+    ModbusTcpReadRequest*	reqs;       // adjacent registers are read at once
+    int	reqCount;
+    unsigned short*	values;         // read values of all the requests
+} ModbusTcpServerScan;
+
+struct ModbusTcpDataFetchScheduler {
     DataFetchSchedulerBase	Super;
 
     // data member
     ModbusTcpFetchTargets*	mFetchTargets;  // acquisition targets of Modbus TCP
-} ModbusTcpDataFetchScheduler;
+    vector	mScans;         // ModbusTcpServerScan* of the servers being read
+    int	mPendingScans;  // count of servers not finished yet
+};
 
 //
 // DataTcpDataFetchScheduler's private procedure/method
@@ -53,15 +82,60 @@ ModbusTcpFetchTimerCallback(void* arg, const FetchItemBase* fetchTarget)
         scheduler->mFetchTargets, (const ModbusTcpFetchItem*)fetchTarget);
 }
 
+static void
+ModbusTcpServerScan_Destroy(ModbusTcpServerScan* scan)
+{
+    free(scan->items);
+    free(scan->reqs);
+    free(scan->values);
+    free(scan);
+}
+
+static ModbusTcpServerScan*
+ModbusTcpDataFetchScheduler_FindScan(ModbusTcpDataFetchScheduler* self,
+    const char* devID)
+{
+    // reading of the server in progress (canceled one is not counted)
+    ModbusTcpServerScan**	scans =
+        (ModbusTcpServerScan**)vector_get_data(self->mScans);
+
+    for (int i = 0; i < vector_size(self->mScans); i++) {
+        if (! scans[i]->isCanceled
+        &&  0 == strncmp(scans[i]->devID, devID, MODBUS_TCP_ID_SIZE)) {
+            return scans[i];
+        }
+    }
+    return NULL;
+}
+
 // Virtual method
 static void
 ModbusTcpDataFetchScheduler_DoDestroy(DataFetchSchedulerBase* me)
 {
     ModbusTcpDataFetchScheduler*	self = (ModbusTcpDataFetchScheduler*)me;
+    ModbusTcpServerScan**	scans =
+        (ModbusTcpServerScan**)vector_get_data(self->mScans);
 
+    for (int i = 0; i < vector_size(self->mScans); i++) {
+        ModbusTcpServerScan_Destroy(scans[i]);
+    }
+    vector_destroy(self->mScans);
     ModbusTcpFetchTargets_Destroy(self->mFetchTargets);
 }
 
+static void
+ModbusTcpDataFetchScheduler_DoInit(DataFetchSchedulerBase* me, vector fetchItemPtrs)
+{
+    ModbusTcpDataFetchScheduler*	self = (ModbusTcpDataFetchScheduler*)me;
+    ModbusTcpServerScan**	scans =
+        (ModbusTcpServerScan**)vector_get_data(self->mScans);
+
+    // fetch items being read are no longer valid, discard the results
+    for (int i = 0; i < vector_size(self->mScans); i++) {
+        scans[i]->isCanceled = true;
+    }
+}
+
 static void
 ModbusTcpDataFetchScheduler_ClearFetchTargets(DataFetchSchedulerBase* me)
 {
@@ -71,75 +145,242 @@ ModbusTcpDataFetchScheduler_ClearFetchTargets(DataFetchSchedulerBase* me)
 }
 
 static void
-ModbusTcpDataFetchScheduler_DoSchedule(DataFetchSchedulerBase* me)
+ModbusTcpDataFetchScheduler_AddTelemetry(DataFetchSchedulerBase* me,
+    const ModbusTcpFetchItem* item, const unsigned short* readVal)
 {
-    ModbusTcpDataFetchScheduler* self = (ModbusTcpDataFetchScheduler*)me;
-    vector	IDs;
+    ModbusValue	value;
 
-    IDs = ModbusTcpFetchTargets_GetDevIDs(self->mFetchTargets);
-    if (!vector_is_empty(IDs)) {
-        char* IDCurs = (char*)vector_get_data(IDs);
+    ModbusDecode_Execute(&item->decode, readVal, &value);
+    if (value.isFloat) {
+        StringBuf_AppendByPrintf(me->mStringBuf, "%f", value.floatVal);
+    } else if (value.isUnsigned) {
+        StringBuf_AppendByPrintf(me->mStringBuf, "%llu",
+            (unsigned long long)value.intVal);
+    } else {
+        StringBuf_AppendByPrintf(me->mStringBuf, "%lld",
+            (long long)value.intVal);
+    }
 
-        for (int i = 0, n = vector_size(IDs); i < n; i++) {
+    TelemetryItems_Add(me->mTelemetryItems,
+        item->telemetryName, StringBuf_GetStr(me->mStringBuf));
+    StringBuf_Clear(me->mStringBuf);
+}
 
-            vector	fetchItems = ModbusTcpFetchTargets_GetFetchItems(
-                self->mFetchTargets, IDCurs);
-            const ModbusTcpFetchItem** fiCurs =
-                (const ModbusTcpFetchItem**)vector_get_data(fetchItems);
+static void
+ModbusTcpDataFetchScheduler_EndServerScan(ModbusTcpDataFetchScheduler* self,
+    ModbusTcpServerScan* scan)
+{
+    // send the telemetry of the server (NULL: end of starting the servers),
+    // the acquisition ends when all the servers are finished
+    if (scan != NULL) {
+        ModbusTcpServerScan**	scans =
+            (ModbusTcpServerScan**)vector_get_data(self->mScans);
 
-            ModbusTcpDev* modbusdev = LibmodbusTcp_GetAndConnectLib(IDCurs);
+        if (0 < TelemetryItems_Count(self->Super.mTelemetryItems)) {
+            DataFetchScheduler_SendTelemetryAt(&self->Super, scan->timeStamp);
+        }
+        for (int i = 0; i < vector_size(self->mScans); i++) {
+            if (scans[i] == scan) {
+                vector_remove_at(self->mScans, i);
+                break;
+            }
+        }
+        ModbusTcpServerScan_Destroy(scan);
+    }
 
-            IDCurs += 21; // MODBUS_TCP_ID_SIZE
+    if (0 < --self->mPendingScans) {
+        return;
+    }
+    DataFetchScheduler_EndAsync(&self->Super, false);
+}
+
+static void
+ModbusTcpDataFetchScheduler_ReadCallback(void* context,
+    ModbusTcpReadRequest* reqs, int count, int succeeded)
+{
+    ModbusTcpServerScan*	scan = (ModbusTcpServerScan*)context;
+    ModbusTcpDataFetchScheduler*	self = scan->owner;
+
+    if (! scan->isCanceled) {
+        for (int j = 0; j < scan->itemCount; ++j) {
+            const ModbusTcpScanItem*	scanItem = &scan->items[j];
+            const ModbusTcpReadRequest*	req = &reqs[scanItem->reqIndex];
 
-            if (modbusdev == NULL) {
+            if (!req->result) {
+                // error!
                 continue;
             }
+            if (MODBUS_IS_BIT_READ(req->function)) {
+                unsigned short	bit =
+                    (req->dst[scanItem->offset >> 4] >> (scanItem->offset & 15)) & 1;
 
-            for (int j = 0, m = vector_size(fetchItems); j < m; ++j) {
-                const ModbusTcpFetchItem* item = *fiCurs++;
-                unsigned short value;
-
-                if (!LibmodbusTcp_ReadRegister(modbusdev, (int)item->unitID, (int)item->regAddr, &value)) {
-                    // error!
-                    continue;
-                }
-
-                if (item->asFloat)
-                {
-                    double fVal = value;
-
-                    fVal += item->offset;
-                    if (item->multiplier != 0) {
-                        fVal *= item->multiplier;
-                    }
-                    if (item->devider != 0) {
-                        fVal /= item->devider;
-                    }
-
-                    StringBuf_AppendByPrintf(me->mStringBuf, "%f", fVal);
-                }
-                else
-                {
-                    unsigned long ulVal = value;
-
-                    ulVal += item->offset;
-                    if (item->multiplier != 0) {
-                        ulVal *= item->multiplier;
-                    }
-                    if (item->devider != 0) {
-                        ulVal /= item->devider;
-                    }
-
-                    StringBuf_AppendByPrintf(me->mStringBuf, "%ld", ulVal);
-                }
-
-                TelemetryItems_Add(me->mTelemetryItems,
-                    item->telemetryName, StringBuf_GetStr(me->mStringBuf));
-                StringBuf_Clear(me->mStringBuf);
+                ModbusTcpDataFetchScheduler_AddTelemetry(&self->Super, scanItem->item, &bit);
+            } else {
+                ModbusTcpDataFetchScheduler_AddTelemetry(&self->Super, scanItem->item,
+                    &req->dst[scanItem->offset]);
             }
-            LibmodbusTcp_Disconnect(modbusdev);
         }
     }
+    ModbusTcpDataFetchScheduler_EndServerScan(self, scan);
+}
+
+static int
+ScanItem_Comparator(const void* one, const void* two)
+{
+    const ModbusTcpFetchItem*	item1 = ((const ModbusTcpScanItem*)one)->item;
+    const ModbusTcpFetchItem*	item2 = ((const ModbusTcpScanItem*)two)->item;
+
+    if (item1->unitID != item2->unitID) {
+        return (item1->unitID < item2->unitID) ? -1 : 1;
+    }
+    if (item1->funcCode != item2->funcCode) {
+        return (item1->funcCode < item2->funcCode) ? -1 : 1;
+    }
+    if (item1->regAddr != item2->regAddr) {
+        return (item1->regAddr < item2->regAddr) ? -1 : 1;
+    }
+    return 0;
+}
+
+static bool
+ModbusTcpDataFetchScheduler_InitServerScan(ModbusTcpDataFetchScheduler* self,
+    ModbusTcpServerScan* scan, vector fetchItems)
+{
+    // sort the items by (unit, function, address), then merge adjacent
+    // registers/bits of a unit into one request up to the max read length
+    const ModbusTcpFetchItem**	fiCurs =
+        (const ModbusTcpFetchItem**)vector_get_data(fetchItems);
+    int	m = vector_size(fetchItems);
+    int	valueNum = 0;
+    int	wordNum = 0;
+
+    for (int j = 0; j < m; ++j) {
+        wordNum += (int)fiCurs[j]->regCount;
+    }
+
+    scan->itemCount = m;
+    scan->reqCount  = 0;
+    scan->items  = (ModbusTcpScanItem*)malloc(sizeof(ModbusTcpScanItem) * (size_t)m);
+    scan->reqs   = (ModbusTcpReadRequest*)malloc(sizeof(ModbusTcpReadRequest) * (size_t)m);
+    scan->values = (unsigned short*)malloc(sizeof(unsigned short) * (size_t)wordNum);
+    if (scan->items == NULL || scan->reqs == NULL || scan->values == NULL) {
+        return false;
+    }
+
+    for (int j = 0; j < m; ++j) {
+        scan->items[j].item = fiCurs[j];
+    }
+    qsort(scan->items, (size_t)m, sizeof(ModbusTcpScanItem), ScanItem_Comparator);
+
+    for (int j = 0; j < m; ++j) {
+        const ModbusTcpFetchItem*	item = scan->items[j].item;
+        int	itemEnd = (int)(item->regAddr + item->regCount);
+        ModbusTcpReadRequest*	req =
+            (scan->reqCount == 0) ? NULL : &scan->reqs[scan->reqCount - 1];
+
+        if (req == NULL
+        ||  req->unitId != (int)item->unitID
+        ||  req->function != (int)item->funcCode
+        ||  (int)item->regAddr > req->regAddr + req->length
+        ||  itemEnd - req->regAddr > MODBUS_MAX_READ_LENGTH(req->function)) {
+            // start new request (bits are packed, at most regCount words per item)
+            if (req != NULL) {
+                valueNum += (MODBUS_READ_DATA_BYTES(req->function, req->length) + 1) / 2;
+            }
+            req = &scan->reqs[scan->reqCount++];
+            req->unitId   = (int)item->unitID;
+            req->regAddr  = (int)item->regAddr;
+            req->function = (int)item->funcCode;
+            req->length   = 0;
+            req->dst      = &scan->values[valueNum];
+            req->result   = false;
+        }
+        if (itemEnd > req->regAddr + req->length) {
+            // extend current request (not if the registers are covered)
+            req->length = itemEnd - req->regAddr;
+        }
+        scan->items[j].reqIndex = (int)(req - scan->reqs);
+        scan->items[j].offset   = (int)item->regAddr - req->regAddr;
+    }
+    return true;
+}
+
+static void
+ModbusTcpDataFetchScheduler_StartScans(ModbusTcpDataFetchScheduler* self)
+{
+    // start reading the servers due at once (pipelined by the server
+    // config), the telemetry of each server is sent when it finishes;
+    // a server still being read skips this period, the others are not
+    // blocked by it
+    DataFetchSchedulerBase*	me = &self->Super;
+    vector	IDs;
+    char*	IDCurs;
+    int 	n;
+
+    IDs = ModbusTcpFetchTargets_GetDevIDs(self->mFetchTargets);
+    if (vector_is_empty(IDs)) {
+        return;
+    }
+    n = vector_size(IDs);
+    if (! DataFetchScheduler_IsAsyncPending(me)) {
+        DataFetchScheduler_BeginAsync(me);
+    }
+    self->mPendingScans++;  // held until all the servers are started
+
+    IDCurs = (char*)vector_get_data(IDs);
+    for (int i = 0; i < n; i++, IDCurs += MODBUS_TCP_ID_SIZE) {
+        ModbusTcpServerScan*	scan;
+        vector	fetchItems = ModbusTcpFetchTargets_GetFetchItems(
+            self->mFetchTargets, IDCurs);
+        ModbusTcpDev* modbusdev = LibmodbusTcp_GetModbusDev(IDCurs);
+
+        if (modbusdev == NULL || vector_is_empty(fetchItems)) {
+            continue;
+        }
+        if (NULL != ModbusTcpDataFetchScheduler_FindScan(self, IDCurs)) {
+            Log_Debug("ModbusTcpDataFetchScheduler: previous acquisition of %.*s is in progress\n",
+                MODBUS_TCP_ID_SIZE, IDCurs);
+            continue;
+        }
+        scan = (ModbusTcpServerScan*)calloc(1, sizeof(ModbusTcpServerScan));
+        if (scan == NULL) {
+            continue;
+        }
+        if (! ModbusTcpDataFetchScheduler_InitServerScan(self, scan, fetchItems)
+        ||  0 != vector_add_last(self->mScans, &scan)) {
+            ModbusTcpServerScan_Destroy(scan);
+            continue;
+        }
+        scan->owner     = self;
+        scan->timeStamp = IoT_CentralLib_GetTmeStamp();
+        memcpy(scan->devID, IDCurs, MODBUS_TCP_ID_SIZE);
+
+        self->mPendingScans++;
+        if (LibmodbusTcp_ReadRegistersAsync(modbusdev, scan->reqs, scan->reqCount,
+                ModbusTcpDataFetchScheduler_ReadCallback, scan)) {
+            continue;
+        }
+        // not in the event loop, read one by one
+        if (NULL != LibmodbusTcp_GetAndConnectLib(IDCurs)) {
+            (void)LibmodbusTcp_ReadRegisters(modbusdev, scan->reqs, scan->reqCount);
+        }
+        ModbusTcpDataFetchScheduler_ReadCallback(scan, scan->reqs, scan->reqCount, 0);
+        // keep the connection for the next cycle
+    }
+    ModbusTcpDataFetchScheduler_EndServerScan(self, NULL);
+}
+
+static void
+ModbusTcpDataFetchScheduler_DoQueue(DataFetchSchedulerBase* me)
+{
+    // start the servers due while the others are being read
+    ModbusTcpDataFetchScheduler_StartScans((ModbusTcpDataFetchScheduler*)me);
+}
+
+static void
+ModbusTcpDataFetchScheduler_DoSchedule(DataFetchSchedulerBase* me)
+{
+    ModbusTcpDataFetchScheduler_StartScans((ModbusTcpDataFetchScheduler*)me);
 }
 
 DataFetchScheduler*
@@ -159,12 +400,20 @@ ModbusTcpDataFetchScheduler_New(void)
         if (NULL == newObj->mFetchTargets) {
             goto err_delete_super;
         }
+        newObj->mScans = vector_init(sizeof(ModbusTcpServerScan*));
+        if (NULL == newObj->mScans) {
+            ModbusTcpFetchTargets_Destroy(newObj->mFetchTargets);
+            goto err_delete_super;
+        }
+        newObj->mPendingScans = 0;
+        super->mQueueWhilePending = true;
     }
 
     super->DoDestroy = ModbusTcpDataFetchScheduler_DoDestroy;
-//	super->DoInit    = ModbusTcpDataFetchScheduler_DoInit;  // don't override
+    super->DoInit    = ModbusTcpDataFetchScheduler_DoInit;
     super->ClearFetchTargets = ModbusTcpDataFetchScheduler_ClearFetchTargets;
     super->DoSchedule        = ModbusTcpDataFetchScheduler_DoSchedule;
+    super->DoQueue           = ModbusTcpDataFetchScheduler_DoQueue;
 
     return super;
 err_delete_super:
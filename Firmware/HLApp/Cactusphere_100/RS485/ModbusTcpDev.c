@@ -38,7 +38,7 @@
 // ModbusTcpDev structure
 typedef struct ModbusTcpDev {
     ModbusTcpCtx* ctx;
-    char id[21]; // 255.255.255.255:1111
+    char id[MODBUS_TCP_ID_SIZE]; // 255.255.255.255:65535
 }ModbusTcpDev;
 
 // Initialization and cleanup
@@ -49,23 +49,32 @@ ModbusTcpDev_Initialize() {
 
 void
 ModbusTcpDev_Destroy(vector modbusDevVec) {
+    // (the elements are owned by modbusDevVec)
     ModbusTcpDev* modbusDev = vector_get_data(modbusDevVec);
     for (int i = 0, n = vector_size(modbusDevVec); i < n; ++i) {
         ModbusTCP_Destroy(modbusDev->ctx);
-        free(modbusDev);
         modbusDev++;
     }
 }
 
 // Create Modbus TCP
 ModbusTcpDev* 
-ModbusTcpDev_NewModbusTCP(char* ip, int port) {
+ModbusTcpDev_NewModbusTCP(char* ip, int port, int window, uint32_t timeoutMs) {
     ModbusTcpDev* newObj;
     
     newObj = (ModbusTcpDev*)malloc(sizeof(ModbusTcpDev));
+    if (newObj == NULL) {
+        return NULL;
+    }
     newObj->ctx = ModbusTCP_Initialize(ip, port);
+    if (newObj->ctx == NULL) {
+        free(newObj);
+        return NULL;
+    }
+    ModbusTCP_SetWindow(newObj->ctx, window);
+    ModbusTCP_SetResponseTimeout(newObj->ctx, timeoutMs);
 
-    sprintf(newObj->id, "%s:%d", ip, port);
+    snprintf(newObj->id, sizeof(newObj->id), "%s:%d", ip, port);
 
     return newObj;
 }
@@ -95,6 +104,31 @@ ModbusTcpDev_Disconnect(ModbusTcpDev* me) {
     ModbusTCP_Disconnect(me->ctx);
 }
 
+// Result of the last request
+ModbusTcpError
+ModbusTcpDev_GetLastError(ModbusTcpDev* me) {
+    return ModbusTCP_GetLastError(me->ctx);
+}
+
+// Read several registers
+int
+ModbusTcpDev_ReadRegisters(ModbusTcpDev* me, ModbusTcpReadRequest* reqs, int count) {
+    return ModbusTCP_ReadRegisters(me->ctx, reqs, count);
+}
+
+bool
+ModbusTcpDev_ReadRegistersAsync(ModbusTcpDev* me, ModbusTcpReadRequest* reqs, int count,
+    ModbusTcpReadCallback callback, void* context) {
+    return ModbusTCP_ReadRegistersAsync(me->ctx, reqs, count, callback, context);
+}
+
+// Read status/registers
+bool
+ModbusTcpDev_ReadRegister(ModbusTcpDev* me, int unitId, int regAddr, int function,
+    unsigned short* dst, int length) {
+    return ModbusTCP_ReadRegister(me->ctx, unitId, regAddr, function, dst, length);
+}
+
 // Read single register
 bool 
 ModbusTcpDev_ReadSingleRegister(ModbusTcpDev* me, int unitId, int regAddr, unsigned short* dst) {
@@ -106,8 +140,21 @@ ModbusTcpDev_ReadSingleInputRegister(ModbusTcpDev* me, int unitId, int regAddr,
     return ModbusTCP_ReadSingleInputRegister(me->ctx, unitId, regAddr, dst);
 }
 
+// Write single coil/register
+bool
+ModbusTcpDev_WriteRegister(ModbusTcpDev* me, int unitId, int regAddr, int function, uint16_t value) {
+    return ModbusTCP_WriteRegister(me->ctx, unitId, regAddr, function, value);
+}
+
 // Write single register
 bool
 ModbusTcpDev_WriteSingleRegister(ModbusTcpDev* me, int unitId, int regAddr, uint16_t value) {
     return ModbusTCP_WriteSingleRegister(me->ctx, unitId, regAddr, value);
 }
+
+// Write several coils/registers in a row
+bool
+ModbusTcpDev_WriteRegisters(ModbusTcpDev* me, int unitId, int regAddr, int function,
+    const unsigned short* values, int count) {
+    return ModbusTCP_WriteRegisters(me->ctx, unitId, regAddr, function, values, count);
+}
@@ -28,6 +28,10 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "vector.h"
+#include "ModbusTCP.h"
+
+// size of the device ID "ipAddr:port" (with the terminating null)
+#define MODBUS_TCP_ID_SIZE 22
 
 typedef struct ModbusTcpDev ModbusTcpDev;
 
@@ -36,7 +40,9 @@ extern vector ModbusTcpDev_Initialize(void);
 extern void ModbusTcpDev_Destroy(vector modbusDevVec);
 
 // Create Modbus TCP 
-extern ModbusTcpDev* ModbusTcpDev_NewModbusTCP(char* ip, int port);
+//   window is count of requests sent ahead of the responses,
+//   timeoutMs is response timeout of each request
+extern ModbusTcpDev* ModbusTcpDev_NewModbusTCP(char* ip, int port, int window, uint32_t timeoutMs);
 
 // Get ModbusDev*
 extern ModbusTcpDev* ModbusTcpDev_GetModbusDev(const char* id, vector modbusTcpDevVec);
@@ -47,12 +53,31 @@ extern bool ModbusTcpDev_Connect(ModbusTcpDev* me);
 // Disconnect
 extern void ModbusTcpDev_Disconnect(ModbusTcpDev* me);
 
+// Result of the last request
+extern ModbusTcpError ModbusTcpDev_GetLastError(ModbusTcpDev* me);
+
+// Read several registers (pipelined)
+extern int ModbusTcpDev_ReadRegisters(ModbusTcpDev* me, ModbusTcpReadRequest* reqs, int count);
+extern bool ModbusTcpDev_ReadRegistersAsync(ModbusTcpDev* me, ModbusTcpReadRequest* reqs, int count,
+    ModbusTcpReadCallback callback, void* context);
+
+// Read status/registers (FC01-FC04)
+extern bool ModbusTcpDev_ReadRegister(ModbusTcpDev* me, int unitId, int regAddr, int function,
+    unsigned short* dst, int length);
+
 // Read 1byte holding register
 extern bool ModbusTcpDev_ReadSingleRegister(ModbusTcpDev* me, int unitId, int regAddr, unsigned short* dst);
 
 // Read 1byte input register
 extern bool ModbusTcpDev_ReadSingleInputRegister(ModbusTcpDev* me, int unitId, int regAddr, unsigned short* dst);
 
+// Write single coil/register (FC05/FC06)
+extern bool ModbusTcpDev_WriteRegister(ModbusTcpDev* me, int unitId, int regAddr, int function, uint16_t value);
+
 // Write 1byte
 extern bool ModbusTcpDev_WriteSingleRegister(ModbusTcpDev* me, int unitId, int regAddr, uint16_t value);
+
+// Write several coils/registers in a row (FC15/FC16)
+extern bool ModbusTcpDev_WriteRegisters(ModbusTcpDev* me, int unitId, int regAddr, int function,
+    const unsigned short* values, int count);
 #endif  // _MODBUS_TCP_DEV_H_
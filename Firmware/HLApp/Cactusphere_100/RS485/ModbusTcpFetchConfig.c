@@ -28,6 +28,7 @@
 #include <stdlib.h>
 
 #include "json.h"
+#include "ModbusDevConfig.h"
 #include "ModbusTcpFetchItem.h"
 #include "TelemetryItems.h"
 
@@ -43,11 +44,19 @@ const char IpAddrKey[]                      = "ipAddr";
 const char PortKey[]                        = "port";		
 const char UnitIdKey[]                      = "unitId";	
 extern const char RegisterAddrKey[];		
+extern const char RegisterCountKey[];
+extern const char FuncCodeKey[];
 extern const char OffsetKey[];				
 extern const char IntervalKey[];			
 extern const char MultiplylKey[];		
 extern const char DeviderKey[];			
 extern const char AsFloatKey[];		 
+extern const char AsLittleKey[];
+extern const char DataTypeKey[];
+extern const char WordSwapKey[];
+extern const char ByteSwapKey[];
+extern const char BitOffsetKey[];
+extern const char BitLengthKey[];
 
 // Initialization and cleanup
 ModbusTcpFetchConfig*
@@ -108,6 +117,10 @@ ModbusTcpFetchConfig_LoadFromJSON(ModbusTcpFetchConfig* me,
 
     for (unsigned int i = 0, n = configJson->u.object.length; i < n; ++i) {
         ModbusTcpFetchItem pseudo;
+        ModbusDataType dataType = MODBUS_TYPE_COUNT;
+        bool byteSwap = false;
+        uint32_t bitOffset = 0;
+        uint32_t bitLength = 0;
         json_value* configItem = configJson->u.object.values[i].value;
         size_t	strLen = strlen(configJson->u.object.values[i].name);
 
@@ -121,17 +134,22 @@ ModbusTcpFetchConfig_LoadFromJSON(ModbusTcpFetchConfig* me,
         pseudo.port = 0;
         pseudo.unitID = 0;
         pseudo.regAddr = 0;
+        pseudo.regCount = 0;
+        pseudo.funcCode = FC_READ_HOLDING_REGISTER;
         pseudo.offset = 0;
         pseudo.intervalSec = 1;
         pseudo.multiplier = 0;
         pseudo.devider = 0;
         pseudo.asFloat = false;
+        pseudo.asLittle = false;
 
         for (unsigned int p = 0, q = configItem->u.object.length; p < q; ++p) {
             if (0 == strcmp(configItem->u.object.values[p].name, IpAddrKey)) {
                 json_value* item = configItem->u.object.values[p].value;
 
-                memcpy(pseudo.ipAddr, item->u.string.ptr, item->u.string.length);
+                if (item->u.string.length < sizeof(pseudo.ipAddr)) {
+                    memcpy(pseudo.ipAddr, item->u.string.ptr, item->u.string.length);
+                }
             }
             if (0 == strcmp(configItem->u.object.values[p].name, PortKey)) {
                 json_value* item = configItem->u.object.values[p].value;
@@ -161,6 +179,33 @@ ModbusTcpFetchConfig_LoadFromJSON(ModbusTcpFetchConfig* me,
 
                 pseudo.regAddr = (unsigned long)strtol(item->u.string.ptr, &e, 16);
             }
+            else if (0 == strcmp(configItem->u.object.values[p].name, RegisterCountKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+
+                (void)json_GetNumericValue(item, &pseudo.regCount, 16);
+            }
+            else if (0 == strcmp(configItem->u.object.values[p].name, FuncCodeKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+                uint32_t funcCode = 0;
+
+                if (item->type == json_integer) {
+                    funcCode = (uint32_t)item->u.integer;
+                }
+                else if (item->type == json_string) {
+                    char* e;
+                    funcCode = (uint32_t)strtol(item->u.string.ptr, &e, 16);
+                }
+                switch (funcCode) {
+                case FC_READ_COILS:
+                case FC_READ_DISCRETE_INPUTS:
+                case FC_READ_HOLDING_REGISTER:
+                case FC_READ_INPUT_REGISTERS:
+                    pseudo.funcCode = funcCode;
+                    break;
+                default:
+                    break;  // holding register as before
+                }
+            }
             else if (0 == strcmp(configItem->u.object.values[p].name, IntervalKey)) { 
                 json_value* item = configItem->u.object.values[p].value;
 
@@ -189,8 +234,57 @@ ModbusTcpFetchConfig_LoadFromJSON(ModbusTcpFetchConfig* me,
 
                 pseudo.asFloat = item->u.boolean;
             }
+            else if (0 == strcmp(configItem->u.object.values[p].name, AsLittleKey)
+                 ||  0 == strcmp(configItem->u.object.values[p].name, WordSwapKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+
+                pseudo.asLittle = item->u.boolean;
+            }
+            else if (0 == strcmp(configItem->u.object.values[p].name, ByteSwapKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+
+                byteSwap = item->u.boolean;
+            }
+            else if (0 == strcmp(configItem->u.object.values[p].name, DataTypeKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+
+                if (item->type == json_string) {
+                    dataType = ModbusDecode_GetDataType(item->u.string.ptr);
+                }
+            }
+            else if (0 == strcmp(configItem->u.object.values[p].name, BitOffsetKey)) {
+                json_value* item = configItem->u.object.values[p].value;
 
+                (void)json_GetNumericValue(item, &bitOffset, 10);
+            }
+            else if (0 == strcmp(configItem->u.object.values[p].name, BitLengthKey)) {
+                json_value* item = configItem->u.object.values[p].value;
+
+                (void)json_GetNumericValue(item, &bitLength, 10);
+            }
+
+        }
+
+        // compile the value decoder same as Modbus RTU (register count
+        // selects unsigned 16/32/64 bit without dataType, a coil/discrete
+        // input is one bit), the item is skipped if invalid
+        if (MODBUS_IS_BIT_READ(pseudo.funcCode)) {
+            dataType = MODBUS_TYPE_UINT16;
+            pseudo.regCount = 1;
+        } else if (dataType == MODBUS_TYPE_COUNT) {
+            dataType = (pseudo.regCount == 2) ? MODBUS_TYPE_UINT32
+                     : (pseudo.regCount == 4) ? MODBUS_TYPE_UINT64
+                     : MODBUS_TYPE_UINT16;
+            pseudo.regCount = ModbusDecode_GetWordCount(dataType);
+        } else {
+            pseudo.regCount = ModbusDecode_GetWordCount(dataType);
+        }
+        if (! ModbusDecode_Compile(&pseudo.decode, dataType,
+                pseudo.asLittle, byteSwap, bitOffset, bitLength, pseudo.asFloat,
+                pseudo.offset, pseudo.multiplier, pseudo.devider)) {
+            continue;
         }
+        pseudo.asFloat = pseudo.decode.asFloat;
         vector_add_last(me->mFetchItems, &pseudo);
     }
 
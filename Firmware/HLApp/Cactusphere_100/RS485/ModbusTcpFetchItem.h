@@ -29,17 +29,23 @@
 
 #include <stdbool.h>
 
+#include "ModbusDecode.h"
+
 typedef struct ModbusTcpFetchItem {
     char	    telemetryName[TELEMETRY_NAME_MAX_LEN + 1];  // telemetry name
     uint32_t	intervalSec;    // periodic acquisition interval (in seconds)
     char		ipAddr[16];	    // ip address
     uint32_t	port;			// port num
     uint32_t	unitID;         // unit id
-    uint32_t	regAddr;        // register address
+    uint32_t	regAddr;        // register address (bit address for FC01/FC02)
+    uint32_t	regCount;       // read register count (1 for FC01/FC02)
+    uint32_t	funcCode;       // function code
     uint16_t	offset;         // sum value
     uint32_t	multiplier;     // multiply value
     uint32_t	devider;        // divide value
     bool	    asFloat;        // true:float, false: not float 
+    bool	    asLittle;       // true:little endian, false:big endian
+    ModbusDecodeDesc	decode; // compiled value decoder
 } ModbusTcpFetchItem;
 
 #endif  // _MODBUS_FETCH_ITEM_H_
@@ -27,11 +27,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "ModbusTcpDev.h"
 #include "ModbusTcpFetchItem.h"
 #include "dictionary.h"
 
-#define MODBUS_TCP_ID_SIZE 21
-
 typedef struct ModbusTcpFetchItemsPerDev {
     char mId[MODBUS_TCP_ID_SIZE];		// id is "ipAddr:port"
     vector	mFetchItems;	            // telemetry items
@@ -161,8 +160,9 @@ ModbusTcpFetchTargets_Add(
 {
     ModbusTcpFetchItemsPerDev*	theGroup = NULL;
 
-   char id[MODBUS_TCP_ID_SIZE];
-    sprintf(id, "%s:%d", target->ipAddr, target->port);
+    char id[MODBUS_TCP_ID_SIZE];
+
+    snprintf(id, sizeof(id), "%s:%d", target->ipAddr, (int)target->port);
 
     if (! dictionary_get(&theGroup, me->mTargetsDictByDevID, &id)) {
         theGroup = ModbusTcpFetchItemsPerDev_New(id);
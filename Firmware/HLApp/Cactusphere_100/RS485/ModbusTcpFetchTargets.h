@@ -37,6 +37,7 @@ extern ModbusTcpFetchTargets*	ModbusTcpFetchTargets_New(void);
 extern void	ModbusTcpFetchTargets_Destroy(ModbusTcpFetchTargets* me);
 
 // Get current acquisition targets
+//   device IDs are MODBUS_TCP_ID_SIZE chars each
 extern vector	ModbusTcpFetchTargets_GetDevIDs(ModbusTcpFetchTargets* me);
 extern vector	ModbusTcpFetchTargets_GetFetchItems(
     ModbusTcpFetchTargets* me, char* id);
@@ -0,0 +1,575 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "ModbusTcpServer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <applibs/eventloop.h>
+#include <applibs/log.h>
+
+#include "LibModbus.h"
+#include "ModbusDevConfig.h"
+#include "ModbusTCP.h"
+
+#define MODBUS_TCP_SERVER_MAX_CLIENTS   8
+#define MODBUS_TCP_SERVER_DEFAULT_PORT  502
+#define MODBUS_TCP_SERVER_DEFAULT_AGE   5     // [sec]
+#define MODBUS_TCP_SERVER_WRITE_PRIORITY 0    // same as the write command by default
+
+// exception codes
+#define EXCEPTION_ILLEGAL_FUNCTION      0x01
+#define EXCEPTION_ILLEGAL_DATA_ADDRESS  0x02
+#define EXCEPTION_ILLEGAL_DATA_VALUE    0x03
+#define EXCEPTION_GATEWAY_PATH          0x0A
+#define EXCEPTION_GATEWAY_NO_RESPONSE   0x0B
+
+static const char ModbusTcpServerKey[] = "ModbusTcpServer";
+static const char PortKey[]            = "port";
+static const char MaxAgeKey[]          = "maxAge";
+static const char MaxClientsKey[]      = "maxClients";
+static const char ForwardKey[]         = "forward";
+
+// connection of a client
+typedef struct ModbusTcpClient {
+    int 	fd;                 // -1 if not used
+    EventRegistration*	reg;
+    int 	rxLen;
+    uint8_t	rxBuf[MODBUS_TCP_MAX_ADU_LENGTH];
+
+    // request forwarded to the slave (the ADU stays at the head of rxBuf)
+    bool	isPending;          // the slot is not reused until answered
+    int 	pendingLen;
+    ModbusReadRequest	readReq;
+    unsigned short	values[MODBUS_MAX_WRITE_COILS];
+} ModbusTcpClient;
+
+static struct {
+    // configuration
+    bool	isEnabled;
+    int 	port;
+    uint32_t	maxAgeMs;       // max age of the snapshot to answer
+    int 	maxClients;
+    bool	isForwarding;       // forward the uncached reads and the writes
+
+    EventLoop*	eventLoop;
+    int 	listenFd;
+    EventRegistration*	listenReg;
+    ModbusTcpClient	clients[MODBUS_TCP_SERVER_MAX_CLIENTS];
+} sServer = {
+    .isEnabled    = false,
+    .port         = MODBUS_TCP_SERVER_DEFAULT_PORT,
+    .maxAgeMs     = MODBUS_TCP_SERVER_DEFAULT_AGE * 1000,
+    .maxClients   = MODBUS_TCP_SERVER_MAX_CLIENTS,
+    .isForwarding = true,
+    .eventLoop    = NULL,
+    .listenFd     = -1,
+    .listenReg    = NULL,
+    .clients      = { { .fd = -1 } }
+};
+
+static void ModbusTcpServer_ProcessRequests(ModbusTcpClient* client);
+
+static int
+ModbusTcpServer_SetException(uint8_t* rsp, uint8_t exception)
+{
+    // rsp points at the function code of the response
+    rsp[0] |= MODBUS_EXCEPTION_FLAG;
+    rsp[1] = exception;
+    return 2;
+}
+
+static int
+ModbusTcpServer_SetReadData(uint8_t* rsp, int funcCode, const unsigned short* values, int length)
+{
+    // rsp points at the function code of the response
+    int 	byteCount = MODBUS_READ_DATA_BYTES(funcCode, length);
+
+    rsp[1] = (uint8_t)byteCount;
+    if (MODBUS_IS_BIT_READ(funcCode)) {
+        for (int i = 0; i < byteCount; i++) {
+            rsp[2 + i] = (uint8_t)(values[i >> 1] >> ((i & 1) << 3));
+        }
+    } else {
+        for (int i = 0; i < length; i++) {
+            rsp[2 + (i << 1)] = (uint8_t)(values[i] >> 8);
+            rsp[3 + (i << 1)] = (uint8_t)(values[i] & 0x00ff);
+        }
+    }
+
+    return 2 + byteCount;
+}
+
+static void
+ModbusTcpServer_CloseClient(ModbusTcpClient* client)
+{
+    if (client->fd < 0) {
+        return;
+    }
+    if (client->reg != NULL) {
+        EventLoop_UnregisterIo(sServer.eventLoop, client->reg);
+    }
+    close(client->fd);
+    client->fd    = -1;
+    client->reg   = NULL;
+    client->rxLen = 0;
+}
+
+static bool
+ModbusTcpServer_SendResponse(ModbusTcpClient* client, int aduLen, uint8_t* rsp, int rspPduLen)
+{
+    // answer the request ADU at the head of rxBuf and remove it
+    const uint8_t*	req = client->rxBuf;
+    int 	rspLen = MODBUS_TCP_MBAP_LENGTH + rspPduLen;
+
+    ModbusTCP_SetMbapHeader(rsp, (uint16_t)((req[0] << 8) | req[1]), req[6], rspPduLen);
+    if (rspLen != send(client->fd, rsp, (size_t)rspLen, MSG_NOSIGNAL | MSG_DONTWAIT)) {
+        ModbusTcpServer_CloseClient(client);  // client does not read
+        return false;
+    }
+    client->rxLen -= aduLen;
+    memmove(client->rxBuf, client->rxBuf + aduLen, (size_t)client->rxLen);
+
+    return true;
+}
+
+static void
+ModbusTcpServer_Resume(ModbusTcpClient* client, uint8_t* rsp, int rspPduLen)
+{
+    // answer the forwarded request, then the ones received meanwhile
+    client->isPending = false;
+    if (client->fd < 0) {
+        return;  // closed while forwarding
+    }
+    if (! ModbusTcpServer_SendResponse(client, client->pendingLen, rsp, rspPduLen)) {
+        return;
+    }
+    if (0 != EventLoop_ModifyIoEvents(sServer.eventLoop, client->reg, EventLoop_Input)) {
+        ModbusTcpServer_CloseClient(client);
+        return;
+    }
+    ModbusTcpServer_ProcessRequests(client);
+}
+
+static void
+ModbusTcpServer_ReadCallback(void* context, ModbusReadRequest* reqs, int count, int succeeded)
+{
+    ModbusTcpClient*	client = (ModbusTcpClient*)context;
+    uint8_t	rsp[MODBUS_TCP_MAX_ADU_LENGTH];
+    uint8_t*	rspPdu = &rsp[MODBUS_TCP_MBAP_LENGTH];
+    int 	rspPduLen;
+
+    rspPdu[0] = (uint8_t)reqs->function;
+    if (succeeded == 1) {
+        Libmodbus_UpdateSnapshot(client->rxBuf[6], reqs, 1, 0);
+        rspPduLen = ModbusTcpServer_SetReadData(rspPdu, reqs->function, reqs->dst, reqs->length);
+    } else {
+        rspPduLen = ModbusTcpServer_SetException(rspPdu, (reqs->exception != 0)
+            ? reqs->exception : EXCEPTION_GATEWAY_NO_RESPONSE);
+    }
+    ModbusTcpServer_Resume(client, rsp, rspPduLen);
+}
+
+static void
+ModbusTcpServer_WriteCallback(void* context, ModbusWriteStatus status, uint8_t exception)
+{
+    ModbusTcpClient*	client = (ModbusTcpClient*)context;
+    const uint8_t*	pdu = &client->rxBuf[MODBUS_TCP_MBAP_LENGTH];
+    uint8_t	rsp[MODBUS_TCP_MAX_ADU_LENGTH];
+    uint8_t*	rspPdu = &rsp[MODBUS_TCP_MBAP_LENGTH];
+    int 	count = (pdu[0] == FC_WRITE_FORCE_SINGLE_COIL || pdu[0] == FC_WRITE_SINGLE_REGISTER)
+        ? 1 : ((pdu[3] << 8) | pdu[4]);
+    int 	rspPduLen;
+
+    // reads queued ahead of the write may have refreshed the snapshot
+    Libmodbus_InvalidateSnapshot(client->rxBuf[6], (pdu[1] << 8) | pdu[2], pdu[0], count);
+
+    rspPdu[0] = pdu[0];
+    if (status == MODBUS_WRITE_SUCCESS) {
+        memcpy(&rspPdu[1], &pdu[1], 4);  // echo of address and value/count
+        rspPduLen = 5;
+    } else {
+        rspPduLen = ModbusTcpServer_SetException(rspPdu, (exception != 0) ? exception
+            : (status == MODBUS_WRITE_NO_DEVICE) ? EXCEPTION_GATEWAY_PATH
+            : EXCEPTION_GATEWAY_NO_RESPONSE);
+    }
+    ModbusTcpServer_Resume(client, rsp, rspPduLen);
+}
+
+static int
+ModbusTcpServer_Read(ModbusTcpClient* client, int devID, int funcCode,
+    const uint8_t* pdu, int pduLen, uint8_t* rsp)
+{
+    // answer from the snapshot, or forward to the slave (returns 0 if forwarded)
+    ModbusReadRequest*	req = &client->readReq;
+    int 	regAddr, length;
+
+    if (pduLen != 5) {
+        return ModbusTcpServer_SetException(rsp, EXCEPTION_ILLEGAL_DATA_VALUE);
+    }
+    regAddr = (pdu[1] << 8) | pdu[2];
+    length  = (pdu[3] << 8) | pdu[4];
+    if (length < 1 || length > MODBUS_MAX_READ_LENGTH(funcCode)) {
+        return ModbusTcpServer_SetException(rsp, EXCEPTION_ILLEGAL_DATA_VALUE);
+    }
+    if (regAddr + length > 0x10000) {
+        return ModbusTcpServer_SetException(rsp, EXCEPTION_ILLEGAL_DATA_ADDRESS);
+    }
+
+    if (Libmodbus_ReadSnapshot(devID, regAddr, funcCode, client->values, length,
+            sServer.maxAgeMs)) {
+        return ModbusTcpServer_SetReadData(rsp, funcCode, client->values, length);
+    }
+    if (! sServer.isForwarding) {
+        return ModbusTcpServer_SetException(rsp, EXCEPTION_GATEWAY_PATH);
+    }
+    memset(req, 0, sizeof(*req));
+    req->regAddr  = regAddr;
+    req->function = funcCode;
+    req->length   = length;
+    req->dst      = client->values;
+    req->frame    = NULL;
+    if (! Libmodbus_ReadRegistersAsync(Libmodbus_GetLib(devID), req, 1,
+            ModbusTcpServer_ReadCallback, client)) {
+        return ModbusTcpServer_SetException(rsp, EXCEPTION_GATEWAY_NO_RESPONSE);
+    }
+
+    return 0;
+}
+
+static int
+ModbusTcpServer_Write(ModbusTcpClient* client, int devID, int funcCode,
+    const uint8_t* pdu, int pduLen, uint8_t* rsp)
+{
+    // forward to the slave (returns 0 if forwarded)
+    unsigned short*	values = client->values;
+    int 	regAddr, count;
+
+    if (! sServer.isForwarding) {
+        return ModbusTcpServer_SetException(rsp, EXCEPTION_ILLEGAL_FUNCTION);
+    }
+    if (pduLen < 5) {
+        return ModbusTcpServer_SetException(rsp, EXCEPTION_ILLEGAL_DATA_VALUE);
+    }
+    regAddr = (pdu[1] << 8) | pdu[2];
+    switch (funcCode) {
+    case FC_WRITE_FORCE_SINGLE_COIL:
+    case FC_WRITE_SINGLE_REGISTER:
+        values[0] = (unsigned short)((pdu[3] << 8) | pdu[4]);
+        count = 1;
+        if (pduLen != 5
+        ||  (funcCode == FC_WRITE_FORCE_SINGLE_COIL
+            && values[0] != 0xFF00 && values[0] != 0x0000)) {
+            return ModbusTcpServer_SetException(rsp, EXCEPTION_ILLEGAL_DATA_VALUE);
+        }
+        break;
+    case FC_WRITE_MULTIPLE_COILS:
+        count = (pdu[3] << 8) | pdu[4];
+        if (count < 1 || count > MODBUS_MAX_WRITE_COILS
+        ||  pduLen != 6 + ((count + 7) >> 3) || pdu[5] != ((count + 7) >> 3)) {
+            return ModbusTcpServer_SetException(rsp, EXCEPTION_ILLEGAL_DATA_VALUE);
+        }
+        for (int i = 0; i < count; i++) {
+            values[i] = (unsigned short)((pdu[6 + (i >> 3)] >> (i & 7)) & 1);
+        }
+        break;
+    case FC_WRITE_MULTIPLE_REGISTERS:
+        count = (pdu[3] << 8) | pdu[4];
+        if (count < 1 || count > MODBUS_MAX_WRITE_REGISTERS
+        ||  pduLen != 6 + (count << 1) || pdu[5] != (count << 1)) {
+            return ModbusTcpServer_SetException(rsp, EXCEPTION_ILLEGAL_DATA_VALUE);
+        }
+        for (int i = 0; i < count; i++) {
+            values[i] = (unsigned short)((pdu[6 + (i << 1)] << 8) | pdu[7 + (i << 1)]);
+        }
+        break;
+    default:
+        return ModbusTcpServer_SetException(rsp, EXCEPTION_ILLEGAL_FUNCTION);
+    }
+    if (regAddr + count > 0x10000) {
+        return ModbusTcpServer_SetException(rsp, EXCEPTION_ILLEGAL_DATA_ADDRESS);
+    }
+
+    if (! Libmodbus_QueueWrite(devID, regAddr, funcCode, values, count,
+            MODBUS_TCP_SERVER_WRITE_PRIORITY, ModbusTcpServer_WriteCallback, client)) {
+        return ModbusTcpServer_SetException(rsp, EXCEPTION_GATEWAY_PATH);
+    }
+
+    return 0;
+}
+
+static int
+ModbusTcpServer_Process(ModbusTcpClient* client, int aduLen, uint8_t* rsp)
+{
+    // make the response PDU to the request ADU at the head of rxBuf
+    // (returns length of the response PDU, 0 if forwarded to the slave)
+    const uint8_t*	pdu = &client->rxBuf[MODBUS_TCP_MBAP_LENGTH];
+    int 	pduLen = aduLen - MODBUS_TCP_MBAP_LENGTH;
+    int 	devID = client->rxBuf[6];
+    int 	funcCode = pdu[0];
+
+    rsp[0] = (uint8_t)funcCode;
+    if (Libmodbus_GetLib(devID) == NULL) {
+        return ModbusTcpServer_SetException(rsp, EXCEPTION_GATEWAY_PATH);
+    }
+    switch (funcCode) {
+    case FC_READ_COILS:
+    case FC_READ_DISCRETE_INPUTS:
+    case FC_READ_HOLDING_REGISTER:
+    case FC_READ_INPUT_REGISTERS:
+        return ModbusTcpServer_Read(client, devID, funcCode, pdu, pduLen, rsp);
+    default:
+        return ModbusTcpServer_Write(client, devID, funcCode, pdu, pduLen, rsp);
+    }
+}
+
+static void
+ModbusTcpServer_ProcessRequests(ModbusTcpClient* client)
+{
+    // answer the received requests in order of arrival, stop receiving
+    // while a request is forwarded to the slave
+    uint8_t	rsp[MODBUS_TCP_MAX_ADU_LENGTH];
+    int 	aduLen, rspPduLen;
+
+    while (0 != (aduLen = ModbusTCP_GetAduLength(client->rxBuf, client->rxLen))) {
+        if (aduLen < 0) {
+            ModbusTcpServer_CloseClient(client);  // not Modbus TCP
+            return;
+        }
+        if (aduLen > client->rxLen) {
+            break;  // wait for the rest
+        }
+        rspPduLen = ModbusTcpServer_Process(client, aduLen, &rsp[MODBUS_TCP_MBAP_LENGTH]);
+        if (rspPduLen == 0) {
+            client->isPending  = true;
+            client->pendingLen = aduLen;
+            if (0 != EventLoop_ModifyIoEvents(sServer.eventLoop, client->reg, EventLoop_None)) {
+                ModbusTcpServer_CloseClient(client);
+            }
+            return;
+        }
+        if (! ModbusTcpServer_SendResponse(client, aduLen, rsp, rspPduLen)) {
+            return;
+        }
+    }
+}
+
+static void
+ModbusTcpServer_ClientEventHandler(EventLoop* el, int fd, EventLoop_IoEvents events, void* context)
+{
+    ModbusTcpClient*	client = (ModbusTcpClient*)context;
+    ssize_t	rc;
+
+    rc = recv(fd, client->rxBuf + client->rxLen,
+        sizeof(client->rxBuf) - (size_t)client->rxLen, 0);
+    if (rc <= 0) {
+        if (rc < 0 && (errno == EAGAIN || errno == EINTR)) {
+            return;
+        }
+        ModbusTcpServer_CloseClient(client);  // closed by the client
+        return;
+    }
+    client->rxLen += (int)rc;
+
+    ModbusTcpServer_ProcessRequests(client);
+}
+
+static void
+ModbusTcpServer_AcceptEventHandler(EventLoop* el, int fd, EventLoop_IoEvents events, void* context)
+{
+    ModbusTcpClient*	client = NULL;
+    int 	clientFd;
+
+    clientFd = accept(fd, NULL, NULL);
+    if (clientFd < 0) {
+        return;
+    }
+    for (int i = 0; i < sServer.maxClients; i++) {
+        if (sServer.clients[i].fd < 0 && ! sServer.clients[i].isPending) {
+            client = &sServer.clients[i];
+            break;
+        }
+    }
+    if (client == NULL) {
+        Log_Debug("WARNING: Modbus TCP server: too many clients\n");
+        close(clientFd);
+        return;
+    }
+    if (0 != fcntl(clientFd, F_SETFL, fcntl(clientFd, F_GETFL) | O_NONBLOCK)) {
+        close(clientFd);
+        return;
+    }
+    client->fd    = clientFd;
+    client->rxLen = 0;
+    client->reg   = EventLoop_RegisterIo(el, clientFd, EventLoop_Input,
+        ModbusTcpServer_ClientEventHandler, client);
+    if (client->reg == NULL) {
+        ModbusTcpServer_CloseClient(client);
+    }
+}
+
+static void
+ModbusTcpServer_Stop(void)
+{
+    for (int i = 0; i < MODBUS_TCP_SERVER_MAX_CLIENTS; i++) {
+        ModbusTcpServer_CloseClient(&sServer.clients[i]);
+    }
+    if (sServer.listenReg != NULL) {
+        EventLoop_UnregisterIo(sServer.eventLoop, sServer.listenReg);
+        sServer.listenReg = NULL;
+    }
+    if (sServer.listenFd >= 0) {
+        close(sServer.listenFd);
+        sServer.listenFd = -1;
+    }
+}
+
+static bool
+ModbusTcpServer_Start(void)
+{
+    struct sockaddr_in	addr;
+    int 	option = 1;
+
+    if (sServer.eventLoop == NULL || ! sServer.isEnabled) {
+        return true;  // started at registration/configuration
+    }
+    sServer.listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sServer.listenFd < 0) {
+        goto err;
+    }
+    setsockopt(sServer.listenFd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons((uint16_t)sServer.port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (0 != bind(sServer.listenFd, (const struct sockaddr*)&addr, sizeof(addr))
+    ||  0 != listen(sServer.listenFd, MODBUS_TCP_SERVER_MAX_CLIENTS)) {
+        goto err;
+    }
+    sServer.listenReg = EventLoop_RegisterIo(sServer.eventLoop, sServer.listenFd,
+        EventLoop_Input, ModbusTcpServer_AcceptEventHandler, NULL);
+    if (sServer.listenReg == NULL) {
+        goto err;
+    }
+
+    return true;
+err:
+    Log_Debug("ERROR: Modbus TCP server: unable to listen on port %d: %d (%s)\n",
+        sServer.port, errno, strerror(errno));
+    ModbusTcpServer_Stop();
+    return false;
+}
+
+// Start/stop serving in the event loop
+bool
+ModbusTcpServer_RegisterEventLoop(EventLoop* eventLoop)
+{
+    for (int i = 0; i < MODBUS_TCP_SERVER_MAX_CLIENTS; i++) {
+        sServer.clients[i].fd  = -1;
+        sServer.clients[i].reg = NULL;
+        sServer.clients[i].isPending = false;
+    }
+    sServer.eventLoop = eventLoop;
+
+    return ModbusTcpServer_Start();
+}
+
+void
+ModbusTcpServer_UnregisterEventLoop(void)
+{
+    if (sServer.eventLoop == NULL) {
+        return;
+    }
+    ModbusTcpServer_Stop();
+    sServer.eventLoop = NULL;
+}
+
+// Apply "ModbusTcpServer" of ModbusDevConfig
+bool
+ModbusTcpServer_LoadFromJSON(const json_value* json)
+{
+    const json_value*	configJson = NULL;
+    int 	port = MODBUS_TCP_SERVER_DEFAULT_PORT;
+    uint32_t	maxAge = MODBUS_TCP_SERVER_DEFAULT_AGE;
+    int 	maxClients = MODBUS_TCP_SERVER_MAX_CLIENTS;
+    bool	isForwarding = true;
+    bool	ret = true;
+
+    if (json != NULL && json->type == json_object) {
+        for (unsigned int i = 0, n = json->u.object.length; i < n; ++i) {
+            if (0 == strcmp(ModbusTcpServerKey, json->u.object.values[i].name)) {
+                configJson = json->u.object.values[i].value;
+                break;
+            }
+        }
+    }
+    if (configJson != NULL && configJson->type == json_object) {
+        for (unsigned int i = 0, n = configJson->u.object.length; i < n; ++i) {
+            const char*	name = configJson->u.object.values[i].name;
+            json_value*	item = configJson->u.object.values[i].value;
+            uint32_t	value;
+
+            if (0 == strcmp(name, PortKey)) {
+                if (json_GetNumericValue(item, &value, 10) && 0 < value && value <= 0xFFFF) {
+                    port = (int)value;
+                } else {
+                    ret = false;
+                }
+            } else if (0 == strcmp(name, MaxAgeKey)) {
+                if (json_GetNumericValue(item, &value, 10) && value <= 3600) {
+                    maxAge = value;
+                } else {
+                    ret = false;
+                }
+            } else if (0 == strcmp(name, MaxClientsKey)) {
+                if (json_GetNumericValue(item, &value, 10)
+                &&  0 < value && value <= MODBUS_TCP_SERVER_MAX_CLIENTS) {
+                    maxClients = (int)value;
+                } else {
+                    ret = false;
+                }
+            } else if (0 == strcmp(name, ForwardKey)) {
+                json_GetBoolValue(item, &isForwarding);
+            }
+        }
+    }
+
+    // restart to apply new configuration
+    ModbusTcpServer_Stop();
+    sServer.isEnabled    = (configJson != NULL && configJson->type == json_object);
+    sServer.port         = port;
+    sServer.maxAgeMs     = maxAge * 1000;
+    sServer.maxClients   = maxClients;
+    sServer.isForwarding = isForwarding;
+
+    return ModbusTcpServer_Start() && ret;
+}
@@ -0,0 +1,49 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Atmark Techno, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _MODBUS_TCP_SERVER_H_
+#define _MODBUS_TCP_SERVER_H_
+
+#ifndef _STDBOOL_H
+#include <stdbool.h>
+#endif
+
+#include "json.h"
+
+typedef struct EventLoop	EventLoop;
+
+// Modbus TCP server (gateway to the RS-485 slaves)
+//   unit identifier of a request is the slave device ID, reads are
+//   answered from the register snapshot and the others are forwarded
+//   to the slave through the request queue of RTApp (answered when the
+//   slave responds, the later requests of the client wait for it)
+
+// Start/stop serving in the event loop
+extern bool	ModbusTcpServer_RegisterEventLoop(EventLoop* eventLoop);
+extern void	ModbusTcpServer_UnregisterEventLoop(void);
+
+// Apply "ModbusTcpServer" of ModbusDevConfig (stops the server if not present)
+extern bool	ModbusTcpServer_LoadFromJSON(const json_value* json);
+
+#endif  // _MODBUS_TCP_SERVER_H_
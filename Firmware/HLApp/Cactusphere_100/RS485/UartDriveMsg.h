@@ -31,11 +31,23 @@
 
 // constants
 #define MAX_UART_WRITE_LEN	256
+#define MAX_UART_SCAN_LEN	960  // max length of frames/results in a scan list
+#define MAX_UART_POLL_ENTRIES	128  // max count of entries in a poll schedule
+#define MAX_UART_POLL_WRITE_LEN	16   // max length of request frame of a poll entry
+#define MAX_UART_STATS_SLAVES	16   // max count of slaves in transaction statistics
+#define UART_STATS_LATENCY_BINS	8    // count of bins of response time histogram
+
+// upper bound of each bin of the histogram [msec] (the last bin is 500 or more)
+#define UART_STATS_LATENCY_LIMITS	{ 5, 10, 20, 50, 100, 200, 500 }
 
 // request code
 enum {
     UART_REQ_WRITE_AND_READ = 1,  // send request and receive response aganist opposing device
     UART_REQ_SET_PARAMS     = 2,  // setting UART parameters
+    UART_REQ_SCAN_LIST      = 3,  // send requests and receive responses of several frames in a row
+    UART_REQ_POLL_CONFIG    = 4,  // download poll schedule which RTApp runs by itself
+    UART_REQ_POLL_FETCH     = 5,  // take out results of poll schedule
+    UART_REQ_GET_STATS      = 6,  // take out (and clear) transaction statistics
     UART_REQ_VERSION        = 255,// RTApp Version
 };
 
@@ -43,19 +55,32 @@ enum {
 // message structure
 //
 // header
+//   seq is echoed in the header of the response
 typedef struct UART_DriverMsgHdr {
+    uint32_t	seq;
     uint32_t	requestCode;
     uint32_t	messageLen;
 } UART_DriverMsgHdr;
 
 // body
+    // line parameters of the requests on the bus
+    //   RTApp sets them before the transaction, so that they are kept
+    //   whatever it does between the requests (e.g. poll schedule)
+typedef struct UART_LineParams {
+    uint32_t	baudRate;  // 0: current parameters (UART_REQ_SET_PARAMS)
+    uint8_t 	parity;
+    uint8_t 	stop;
+    uint16_t	reserved;
+} UART_LineParams;
+
     // UART_REQ_WRITE_AND_READ
 typedef struct UART_MsgWriteAndRead {
+    UART_LineParams	line;
     uint16_t	writeLen;
     uint16_t	readLen;
     uint32_t	writeData[1];  // writeLen
 //
-// (sizeof(writeLen) + sizeof(readLen) + writeLen) == messageLen
+// (sizeof(line) + sizeof(writeLen) + sizeof(readLen) + writeLen) == messageLen
 // writeLen must (<= MAX_UART_WRITE_LEN)
 //
 } UART_MsgWriteAndRead;
@@ -68,6 +93,63 @@ typedef struct UART_MsgSetParams {
 // sizeof(UART_MsgSetParams) == messageLen
 //
 } UART_MsgSetParams;
+    // UART_REQ_SCAN_LIST
+typedef struct UART_MsgScanList {
+    UART_LineParams	line;
+    uint16_t	frameCount;
+    uint16_t	timeoutMs;  // response timeout of each frame [msec] (0: default)
+    uint32_t	frames[1];  // UART_ScanFrame * frameCount
+//
+// (sizeof(line) + sizeof(frameCount) + sizeof(timeoutMs) + total size of frames) == messageLen
+// total size of frames must (<= MAX_UART_SCAN_LEN)
+//
+} UART_MsgScanList;
+
+// frame of UART_REQ_SCAN_LIST
+typedef struct UART_ScanFrame {
+    uint16_t	writeLen;
+    uint16_t	readLen;
+    uint8_t 	writeData[4];  // writeLen
+//
+// size of a frame is UART_SCAN_FRAME_SIZE(writeLen)
+// writeLen must (<= MAX_UART_WRITE_LEN)
+//
+} UART_ScanFrame;
+
+    // UART_REQ_POLL_CONFIG
+typedef struct UART_MsgPollConfig {
+    uint16_t	entryCount;
+    uint16_t	flags;      // UART_POLL_CONFIG_xxx
+    uint32_t	entries[1]; // UART_PollEntry * entryCount
+//
+// (sizeof(entryCount) + sizeof(flags) + total size of entries) == messageLen
+// total size of entries must (<= MAX_UART_SCAN_LEN), so a schedule is
+// downloaded by several messages (the first one without APPEND flag,
+// the last one with START flag)
+//
+} UART_MsgPollConfig;
+
+// flags of UART_MsgPollConfig
+enum {
+    UART_POLL_CONFIG_APPEND = 0x0001,  // add to the entries downloaded before
+    UART_POLL_CONFIG_START  = 0x0002,  // start polling (stop if no entry)
+};
+
+// entry of UART_REQ_POLL_CONFIG
+typedef struct UART_PollEntry {
+    uint32_t	baudRate;    // UART line parameters of the slave
+    uint32_t	intervalMs;  // polling interval [msec]
+    uint8_t 	parity;
+    uint8_t 	stop;
+    uint16_t	timeoutMs;   // upper bound of response timeout [msec] (0: default), RTApp adapts it to the slave
+    uint16_t	writeLen;
+    uint16_t	readLen;
+    uint8_t 	writeData[4];  // writeLen
+//
+// size of an entry is UART_POLL_ENTRY_SIZE(writeLen)
+// writeLen must (<= MAX_UART_POLL_WRITE_LEN)
+//
+} UART_PollEntry;
 
 // union of messages
 typedef struct UART_DriverMsg {
@@ -75,9 +157,23 @@ typedef struct UART_DriverMsg {
     union {
         UART_MsgWriteAndRead    writeAndReadReq;
         UART_MsgSetParams       setParams;
+        UART_MsgScanList        scanListReq;
+        UART_MsgPollConfig      pollConfigReq;
     } body;
 } UART_DriverMsg;
 
+// header of every response (followed by the response message if status is OK)
+typedef struct UART_ReturnHdr {
+    uint32_t	seq;     // seq of the request
+    uint32_t	status;  // UART_STATUS_*
+} UART_ReturnHdr;
+
+enum {
+    UART_STATUS_OK = 0,
+    UART_STATUS_INVALID,  // unknown or broken request
+    UART_STATUS_FAILED,   // request not done
+};
+
 // return message
 typedef struct UART_ReturnMsg {
     uint32_t	returnCode;
@@ -87,6 +183,105 @@ typedef struct UART_ReturnMsg {
     } message;
 } UART_ReturnMsg;
 
+// response message for UART_REQ_SCAN_LIST
+//   frameCount may be less than the request if RTApp stopped the scan
+//   for the next request (HLApp sends the rest of the frames again)
+typedef struct UART_ScanListReturnMsg {
+    uint16_t	frameCount;
+    uint16_t	reserved;
+    uint32_t	results[1];  // UART_ScanResult * frameCount
+} UART_ScanListReturnMsg;
+
+// result of each frame of UART_REQ_SCAN_LIST
+typedef struct UART_ScanResult {
+    uint8_t 	status;   // UART_SCAN_xxx
+    uint8_t 	reserved;
+    uint16_t	readLen;  // received length
+    uint16_t	elapsedMs;  // time from the end of request to the end of response [msec]
+    uint16_t	reserved2;
+    uint8_t 	readData[4];  // readLen
+//
+// size of a result is UART_SCAN_RESULT_SIZE(readLen)
+//
+} UART_ScanResult;
+
+// status of UART_ScanResult
+enum {
+    UART_SCAN_OK        = 0,  // response received
+    UART_SCAN_TIMEOUT   = 1,  // no (or short) response
+    UART_SCAN_NOT_READY = 2,  // UART parameters are not set
+    UART_SCAN_OVERFLOW  = 3,  // result does not fit in the response message
+    UART_SCAN_EXCEPTION = 4,  // exception response received (readData holds it)
+    UART_SCAN_SHORT     = 5,  // response shorter than readLen
+};
+
+// response message for UART_REQ_POLL_FETCH
+typedef struct UART_PollFetchReturnMsg {
+    uint16_t	resultCount;
+    uint16_t	remaining;  // count of results left in RTApp
+    uint32_t	nowMs;      // RTApp tick count when sent back [msec]
+    uint32_t	dropped;    // count of results dropped by buffer overflow
+    uint32_t	results[1]; // UART_PollResult * resultCount
+//
+// total size of results is (<= MAX_UART_SCAN_LEN)
+//
+} UART_PollFetchReturnMsg;
+
+// result of UART_REQ_POLL_FETCH (status and readData same as UART_ScanResult)
+typedef struct UART_PollResult {
+    uint16_t	entryIndex;   // index in the downloaded entries
+    uint8_t 	status;       // UART_SCAN_xxx
+    uint8_t 	reserved;
+    uint32_t	timestampMs;  // RTApp tick count at the end of response [msec]
+    uint16_t	readLen;
+    uint16_t	elapsedMs;
+    uint8_t 	readData[4];  // readLen
+//
+// size of a result is UART_POLL_RESULT_SIZE(readLen)
+//
+} UART_PollResult;
+
+// transaction statistics of a slave (UART_REQ_GET_STATS)
+typedef struct UART_SlaveStats {
+    uint8_t 	devId;
+    uint8_t 	reserved;
+    uint16_t	reserved2;
+    uint32_t	requestCount;
+    uint32_t	timeoutCount;    // no response
+    uint32_t	shortCount;      // response shorter than expected
+    uint32_t	exceptionCount;  // exception response
+    uint32_t	crcErrorCount;   // response of expected length with CRC error
+    uint32_t	latency[UART_STATS_LATENCY_BINS];  // histogram of response time
+} UART_SlaveStats;
+
+// response message for UART_REQ_GET_STATS
+//   counted since the previous UART_REQ_GET_STATS, requests to the
+//   slaves which do not fit in the table are counted only as untracked
+typedef struct UART_StatsReturnMsg {
+    uint16_t	slaveCount;
+    uint16_t	reserved;
+    uint32_t	periodMs;   // time since the previous UART_REQ_GET_STATS [msec]
+    uint32_t	untracked;  // count of requests to the slaves out of the table
+    uint32_t	reconfigCount;  // count of UART reprogramming for the line parameters
+    UART_SlaveStats	slaves[MAX_UART_STATS_SLAVES];  // slaveCount
+} UART_StatsReturnMsg;
+
+// size of UART_StatsReturnMsg of slaveCount
+#define UART_STATS_RETURN_SIZE(slaveCount) \
+    (sizeof(uint32_t) * 4 + sizeof(UART_SlaveStats) * (slaveCount))
+
+// size of UART_ScanFrame/UART_ScanResult (aligned to 4 bytes)
+#define UART_SCAN_FRAME_SIZE(writeLen) \
+    ((sizeof(uint16_t) * 2 + (writeLen) + 3) & ~3U)
+#define UART_SCAN_RESULT_SIZE(readLen) \
+    ((sizeof(uint16_t) * 4 + (readLen) + 3) & ~3U)
+
+// size of UART_PollEntry/UART_PollResult (aligned to 4 bytes)
+#define UART_POLL_ENTRY_SIZE(writeLen) \
+    ((sizeof(uint32_t) * 2 + sizeof(uint16_t) * 4 + (writeLen) + 3) & ~3U)
+#define UART_POLL_RESULT_SIZE(readLen) \
+    ((sizeof(uint32_t) * 2 + sizeof(uint16_t) * 2 + (readLen) + 3) & ~3U)
+
 // macro for UART_REQ_WRITE_AND_READ
 #define UART_MsgWriteAndRead_WriteDataPtr(msgBody) \
     (unsigned char*)&(msgBody->writeData)
@@ -26,6 +26,8 @@
 
 #include <string.h>
 
+#include <applibs/log.h>
+
 #include "LibCloud.h"
 #include "StringBuf.h"
 #include "TelemetryItems.h"
@@ -60,6 +62,12 @@ DataFetchSchedulerBase_DoSchedule(DataFetchSchedulerBase* me)
     // do nothing
 }
 
+static void
+DataFetchSchedulerBase_DoQueue(DataFetchSchedulerBase* me)
+{
+    // do nothing
+}
+
 // Initialization and cleanup
 void
 DataFetchScheduler_Init(DataFetchScheduler* me, vector fetchItemPtrs)
@@ -91,26 +99,16 @@ DataFetchScheduler_Destroy(DataFetchScheduler* me)
     free(me);
 }
 
-// Periodic operation (per 1[sec])
+// Send telemetry items acquired at timeStamp (by specialized class)
 void
-DataFetchScheduler_Schedule(DataFetchScheduler* me)
+DataFetchScheduler_SendTelemetryAt(DataFetchScheduler* me, uint32_t timeStamp)
 {
-    // Do data acquisition by specialized class and send it as telemetry.
     // If nettwork is down, store the acquired data to cache and send it after recovery. 
     const char* telemtryStr;
 
-    me->ClearFetchTargets(me);
-    TelemetryItems_Clear(me->mTelemetryItems);
-    StringBuf_Clear(me->mStringBuf);
-
-    FetchTimers_UpdateTimers(me->mFetchTimers);
-
-    me->DoSchedule(me);
-
     telemtryStr = TelemetryItems_ToJson(me->mTelemetryItems);
     if (0 != strcmp(telemtryStr, "{}")) {
         bool	isNetworkAlive = IoT_CentralLib_CheckConnection();
-        uint32_t	timeStamp = IoT_CentralLib_GetTmeStamp();
 
         if (! IsAuthenticationDone()) {
             isNetworkAlive = false;
@@ -127,7 +125,7 @@ DataFetchScheduler_Schedule(DataFetchScheduler* me)
                 }
             }
 
-            if (! IoT_CentralLib_SendTelemetry(telemtryStr, &timeStamp)) {
+            if (! IoT_CentralLib_SendTelemetryAt(telemtryStr, timeStamp)) {
                 isNetworkAlive = IoT_CentralLib_CheckConnection();
                 if (isNetworkAlive) {
                     // !!error
@@ -146,6 +144,44 @@ do_cache:
     }
 }
 
+static void
+DataFetchScheduler_SendTelemetry(DataFetchScheduler* me)
+{
+    DataFetchScheduler_SendTelemetryAt(me, IoT_CentralLib_GetTmeStamp());
+}
+
+// Periodic operation (per 1[sec])
+void
+DataFetchScheduler_Schedule(DataFetchScheduler* me)
+{
+    // Do data acquisition by specialized class and send it as telemetry.
+    if (me->mIsAsyncPending) {
+        // previous acquisition is not finished yet, hand the due
+        // targets to the specialized class or skip this period
+        if (me->mQueueWhilePending) {
+            me->ClearFetchTargets(me);
+            FetchTimers_UpdateTimers(me->mFetchTimers);
+            me->DoQueue(me);
+        } else {
+            Log_Debug("DataFetchScheduler: previous acquisition is in progress\n");
+        }
+        return;
+    }
+
+    me->ClearFetchTargets(me);
+    TelemetryItems_Clear(me->mTelemetryItems);
+    StringBuf_Clear(me->mStringBuf);
+
+    FetchTimers_UpdateTimers(me->mFetchTimers);
+
+    me->mIsAsyncStarted = false;
+    me->DoSchedule(me);
+
+    if (! me->mIsAsyncStarted) {
+        DataFetchScheduler_SendTelemetry(me);
+    }
+}
+
 // For specialized class
 DataFetchSchedulerBase*
 DataFetchScheduler_InitOnNew(DataFetchSchedulerBase* me,
@@ -168,6 +204,10 @@ DataFetchScheduler_InitOnNew(DataFetchSchedulerBase* me,
     me->DoInit            = DataFetchSchedulerBase_DoInit;
     me->ClearFetchTargets = DataFetchSchedulerBase_ClearFetchTargets;
     me->DoSchedule        = DataFetchSchedulerBase_DoSchedule;
+    me->DoQueue           = DataFetchSchedulerBase_DoQueue;
+    me->mIsAsyncPending   = false;
+    me->mIsAsyncStarted   = false;
+    me->mQueueWhilePending = false;
 
     return me;
 err_delete_telemetryItems:
@@ -178,3 +218,28 @@ err:
     free(me);
     return NULL;
 }
+
+// Asynchronous data acquisition (by specialized class)
+void
+DataFetchScheduler_BeginAsync(DataFetchScheduler* me)
+{
+    me->mIsAsyncPending = true;
+    me->mIsAsyncStarted = true;
+}
+
+void
+DataFetchScheduler_EndAsync(DataFetchScheduler* me, bool sendTelemetry)
+{
+    me->mIsAsyncPending = false;
+    if (sendTelemetry) {
+        DataFetchScheduler_SendTelemetry(me);
+    } else {
+        TelemetryItems_Clear(me->mTelemetryItems);
+    }
+}
+
+bool
+DataFetchScheduler_IsAsyncPending(DataFetchScheduler* me)
+{
+    return me->mIsAsyncPending;
+}
@@ -25,6 +25,13 @@
 #ifndef _DATA_FETCH_SCHEDULER_H_
 #define _DATA_FETCH_SCHEDULER_H_
 
+#ifndef _STDBOOL_H
+#include <stdbool.h>
+#endif
+#ifndef _STDINT_H
+#include <stdint.h>
+#endif
+
 #ifndef CONTAINERS_VECTOR_H
 #include <vector.h>
 #endif
@@ -46,11 +53,15 @@ struct DataFetchSchedulerBase {
     void	(*DoInit)(DataFetchSchedulerBase* me, vector fetchItemPtrs);
     void	(*ClearFetchTargets)(DataFetchSchedulerBase* me);
     void	(*DoSchedule)(DataFetchSchedulerBase* me);
+    void	(*DoQueue)(DataFetchSchedulerBase* me);
 
 // data member
     FetchTimers*    mFetchTimers;       // timers for data acquistion
     TelemetryItems* mTelemetryItems;    // vector of telemetry item
     StringBuf*      mStringBuf;         // for string processing
+    bool            mIsAsyncPending;    // acquisition is in progress asynchronously
+    bool            mIsAsyncStarted;    // DoSchedule() started asynchronous acquisition
+    bool            mQueueWhilePending; // DoQueue() takes the due targets while pending
 };
 
 // alias type
@@ -69,4 +80,16 @@ extern DataFetchSchedulerBase*	DataFetchScheduler_InitOnNew(
     DataFetchSchedulerBase* me,
     FetchTimerCallback ftCallback, IO_Feature feature);
 
+// Asynchronous data acquisition (by specialized class)
+//   call BeginAsync() in DoSchedule() and EndAsync() on completion,
+//   the telemetry is sent at EndAsync(); set mQueueWhilePending to
+//   receive the targets due during the acquisition by DoQueue()
+extern void	DataFetchScheduler_BeginAsync(DataFetchScheduler* me);
+extern void	DataFetchScheduler_EndAsync(DataFetchScheduler* me, bool sendTelemetry);
+extern bool	DataFetchScheduler_IsAsyncPending(DataFetchScheduler* me);
+
+// Send telemetry items acquired at timeStamp (IoT_CentralLib_GetTmeStamp())
+extern void	DataFetchScheduler_SendTelemetryAt(
+    DataFetchScheduler* me, uint32_t timeStamp);
+
 #endif  // _DATA_FETCH_SCHEDULER_H_
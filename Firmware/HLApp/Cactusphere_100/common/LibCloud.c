@@ -241,6 +241,13 @@ IoT_CentralLib_SendTelemetry(const char* jsonStr, uint32_t* outTimestamp)
     return IoT_CentralLib_DoSendTelemetry(jsonStr, timeStamp);
 }
 
+bool
+IoT_CentralLib_SendTelemetryAt(const char* jsonStr, uint32_t timeStamp)
+{
+    // send telemetry data acquired at timeStamp (IoT_CentralLib_GetTmeStamp())
+    return IoT_CentralLib_DoSendTelemetry(jsonStr, timeStamp);
+}
+
 // Telemetry data caching during network down
 bool
 IoT_CentralLib_CheckConnection(void)
@@ -42,6 +42,8 @@ extern void IoT_CentralLib_Cleanup(void);
 // Send telemetry data
 extern bool	IoT_CentralLib_SendTelemetry(
     const char* jsonStr, uint32_t* outTimestamp);
+extern bool	IoT_CentralLib_SendTelemetryAt(
+    const char* jsonStr, uint32_t timeStamp);
 
 // Telemetry data caching during network down
 extern bool	IoT_CentralLib_CheckConnection(void);
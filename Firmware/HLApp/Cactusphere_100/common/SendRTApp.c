@@ -30,13 +30,20 @@
 #include <stdio.h>
 #include <string.h>
 #include <signal.h>
+#include <stdint.h>
+#include <time.h>
 #include <sys/time.h>
 #include <sys/socket.h>
 
+#include <stdlib.h>
+
 #include <applibs/application.h>
+#include <applibs/eventloop.h>
 #include <applibs/log.h>
 
 #include "cactusphere_product.h"
+#include "eventloop_timer_utilities.h"
+#include "vector.h"
 
 #if (APP_PRODUCT_ID == PRODUCT_ATMARK_TECHNO_DIN)
 static const char rtAppComponentId[] = "c01e5fe8-6c61-4d14-beff-38492b1502b6";  // for DI
@@ -46,6 +53,40 @@ static const char rtAppComponentId[] = "c8b178fe-5942-4584-826c-51856ac5e4ff";
 
 static int sSockFd = -1;
 
+// asynchronous request
+//   RTApp answers the requests in order, echoing the seq of the request
+//   (the first 4 bytes of the request message, set by SendRTApp) in the
+//   header of the response. The requests are sent one by one in order of
+//   the queue, except the urgent ones sent at once. A request timed out
+//   is given up at once, its late response is told by the seq and dropped.
+#define MAX_RX_MESSAGE_SIZE	1024
+
+// header of the response of asynchronous request
+typedef struct ResponseHdr {
+    uint32_t	seq;
+    uint32_t	status;  // 0: OK, otherwise the request failed
+} ResponseHdr;
+
+typedef struct PendingRequest {
+    unsigned char*	txMessage;
+    long	txMessageSize;
+    long	rxMessageSize;
+    int 	timeoutMs;
+    SendRTApp_ResponseCallback	callback;
+    void*	context;
+    uint32_t	seq;
+    bool	isUrgent;
+    bool	isSent;
+    uint64_t	deadlineMs;  // monotonic, valid if sent
+} PendingRequest;
+
+static EventLoop*	sEventLoop = NULL;
+static EventRegistration*	sSockReg = NULL;
+static EventLoopTimer*	sDeadlineTimer = NULL;
+static vector	sPendingRequests = NULL;  // vector of PendingRequest (sent ones first)
+static unsigned char	sRxBuf[MAX_RX_MESSAGE_SIZE];
+static uint32_t	sSeq = 0;  // seq of the request sent last
+
 // Initialization and cleanup
 bool
 SendRTApp_InitHandlers(void)
@@ -77,6 +118,7 @@ void SendRTApp_CloseHandlers(void)
         if (close(sSockFd) != 0) {
             Log_Debug("ERROR: Could not close fd %s: %s (%d).\n", "Socket", strerror(errno), errno);
         }
+        sSockFd = -1;
     }
 }
 
@@ -103,6 +145,10 @@ SendRTApp_SendMessageToRTCoreAndReadMessage(
 {
     int bytesReceived;
 
+    if (sEventLoop != NULL) {
+        Log_Debug("ERROR: blocking request to RTApp of asynchronous requests\n");
+        return false;
+    }
     if (! SendRTApp_SendMessageToRTCore(txMessage, txMessageSize)) {
         return false;
     }
@@ -115,3 +161,275 @@ SendRTApp_SendMessageToRTCoreAndReadMessage(
 
     return true;
 }
+
+//
+// Asynchronous request
+//
+static uint64_t
+SendRTApp_MonotonicMs(void)
+{
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)(ts.tv_nsec / 1000000);
+}
+
+static void
+SendRTApp_ArmDeadline(void)
+{
+    // one-shot at the earliest deadline of the requests sent
+    const PendingRequest*	reqs = (const PendingRequest*)vector_get_data(sPendingRequests);
+    uint64_t	deadlineMs = UINT64_MAX;
+    uint64_t	now;
+    uint64_t	delayMs;
+    struct timespec	delay;
+
+    for (int i = 0; i < vector_size(sPendingRequests) && reqs[i].isSent; i++) {
+        if (reqs[i].deadlineMs < deadlineMs) {
+            deadlineMs = reqs[i].deadlineMs;
+        }
+    }
+    if (deadlineMs == UINT64_MAX) {
+        DisarmEventLoopTimer(sDeadlineTimer);
+        return;
+    }
+    now = SendRTApp_MonotonicMs();
+    delayMs = (deadlineMs > now) ? deadlineMs - now : 1;  // 0 disarms
+    delay.tv_sec  = (time_t)(delayMs / 1000);
+    delay.tv_nsec = (long)(delayMs % 1000) * 1000000;
+    SetEventLoopTimerOneShot(sDeadlineTimer, &delay);
+}
+
+static void
+SendRTApp_PopAt(int index, PendingRequest* outReq)
+{
+    vector_get_at(outReq, sPendingRequests, index);
+    vector_remove_at(sPendingRequests, index);
+    free(outReq->txMessage);
+    outReq->txMessage = NULL;
+}
+
+static void
+SendRTApp_StartNext(void)
+{
+    // send the requests not sent yet, the urgent ones even if another
+    // is in flight (RTApp cuts the scan list in progress short)
+    // (a request not sent times out at once, the callback is not
+    // called before the request returns)
+    PendingRequest*	reqs = (PendingRequest*)vector_get_data(sPendingRequests);
+
+    for (int i = 0; i < vector_size(sPendingRequests); i++) {
+        if (reqs[i].isSent) {
+            continue;
+        }
+        if (! reqs[i].isUrgent && i != 0) {
+            break;  // waiting for the response of the request in flight
+        }
+        reqs[i].seq = ++sSeq;
+        memcpy(reqs[i].txMessage, &reqs[i].seq, sizeof(reqs[i].seq));
+        reqs[i].isSent = true;
+        reqs[i].deadlineMs = SendRTApp_MonotonicMs();
+        if (send(sSockFd, reqs[i].txMessage, (size_t)reqs[i].txMessageSize, 0) == -1) {
+            Log_Debug("ERROR: Unable to send message: %d (%s)\n", errno, strerror(errno));
+            continue;
+        }
+        reqs[i].deadlineMs += (uint64_t)reqs[i].timeoutMs;
+    }
+    SendRTApp_ArmDeadline();
+}
+
+static void
+SendRTApp_DispatchResponse(const unsigned char* rxMessage, long rxMessageSize)
+{
+    // the requests sent ahead of the one answered are not answered any more
+    const ResponseHdr*	hdr = (const ResponseHdr*)rxMessage;
+    const PendingRequest*	reqs = (const PendingRequest*)vector_get_data(sPendingRequests);
+    PendingRequest	req;
+    int 	index;
+
+    if (rxMessageSize < (long)sizeof(ResponseHdr)) {
+        return;  // broken response
+    }
+    for (index = 0; index < vector_size(sPendingRequests) && reqs[index].isSent; index++) {
+        if (reqs[index].seq == hdr->seq) {
+            break;
+        }
+    }
+    if (index == vector_size(sPendingRequests) || ! reqs[index].isSent) {
+        return;  // late response of the request given up
+    }
+    for (; index > 0; index--) {
+        SendRTApp_PopAt(0, &req);
+        req.callback(req.context, NULL, 0);
+    }
+    SendRTApp_PopAt(0, &req);
+    if (hdr->status != 0) {
+        req.callback(req.context, NULL, 0);
+        return;
+    }
+    rxMessage += sizeof(ResponseHdr);
+    rxMessageSize -= (long)sizeof(ResponseHdr);
+    req.callback(req.context, rxMessage,
+        (rxMessageSize < req.rxMessageSize) ? rxMessageSize : req.rxMessageSize);
+}
+
+static void
+SendRTApp_SocketEventHandler(EventLoop* el, int fd, EventLoop_IoEvents events, void* context)
+{
+    int	bytesReceived = recv(sSockFd, sRxBuf, sizeof(sRxBuf), MSG_DONTWAIT);
+
+    if (bytesReceived == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            Log_Debug("ERROR: Unable to receive message: %d (%s)\n", errno, strerror(errno));
+        }
+        return;
+    }
+    SendRTApp_DispatchResponse(sRxBuf, bytesReceived);
+    SendRTApp_StartNext();
+}
+
+static void
+SendRTApp_DeadlineEventHandler(EventLoopTimer* timer)
+{
+    // give up the requests timed out
+    uint64_t	now;
+    int 	i = 0;
+
+    if (ConsumeEventLoopTimerEvent(timer) != 0) {
+        return;
+    }
+    now = SendRTApp_MonotonicMs();
+    while (i < vector_size(sPendingRequests)) {
+        const PendingRequest*	req = (const PendingRequest*)vector_get_data(sPendingRequests) + i;
+        PendingRequest	timedOut;
+
+        if (! req->isSent) {
+            break;
+        }
+        if (now < req->deadlineMs) {
+            i++;
+            continue;
+        }
+        SendRTApp_PopAt(i, &timedOut);
+        timedOut.callback(timedOut.context, NULL, 0);
+    }
+    SendRTApp_StartNext();
+}
+
+bool
+SendRTApp_RegisterEventLoop(EventLoop* eventLoop)
+{
+    if (sSockFd < 0) {
+        return false;
+    }
+    sPendingRequests = vector_init(sizeof(PendingRequest));
+    if (sPendingRequests == NULL) {
+        return false;
+    }
+    sDeadlineTimer = CreateEventLoopDisarmedTimer(eventLoop, SendRTApp_DeadlineEventHandler);
+    if (sDeadlineTimer == NULL) {
+        goto err;
+    }
+    sSockReg = EventLoop_RegisterIo(eventLoop, sSockFd, EventLoop_Input,
+        SendRTApp_SocketEventHandler, NULL);
+    if (sSockReg == NULL) {
+        Log_Debug("ERROR: Unable to register socket event: %d (%s)\n", errno, strerror(errno));
+        DisposeEventLoopTimer(sDeadlineTimer);
+        sDeadlineTimer = NULL;
+        goto err;
+    }
+    sEventLoop = eventLoop;
+
+    return true;
+err:
+    vector_destroy(sPendingRequests);
+    sPendingRequests = NULL;
+    return false;
+}
+
+void
+SendRTApp_UnregisterEventLoop(void)
+{
+    // the requests outstanding fail, the requests made by their
+    // callbacks fail at once
+    if (sEventLoop == NULL) {
+        return;
+    }
+    EventLoop_UnregisterIo(sEventLoop, sSockReg);
+    DisposeEventLoopTimer(sDeadlineTimer);
+    sSockReg = NULL;
+    sDeadlineTimer = NULL;
+    sEventLoop = NULL;
+    while (! vector_is_empty(sPendingRequests)) {
+        PendingRequest	req;
+
+        SendRTApp_PopAt(0, &req);
+        req.callback(req.context, NULL, 0);
+    }
+    vector_destroy(sPendingRequests);
+    sPendingRequests = NULL;
+}
+
+static bool
+SendRTApp_Enqueue(
+    const unsigned char* txMessage, long txMessageSize, long rxMessageSize,
+    int timeoutMs, SendRTApp_ResponseCallback callback, void* context, bool isUrgent)
+{
+    // urgent request goes after the requests sent and the other urgent ones
+    const PendingRequest*	reqs;
+    PendingRequest	newReq;
+    int 	index = 0;
+
+    if (sEventLoop == NULL || txMessageSize < (long)sizeof(uint32_t)) {
+        return false;
+    }
+    newReq.txMessage = (unsigned char*)malloc((size_t)txMessageSize);
+    if (newReq.txMessage == NULL) {
+        return false;
+    }
+    memcpy(newReq.txMessage, txMessage, (size_t)txMessageSize);
+    newReq.txMessageSize = txMessageSize;
+    newReq.rxMessageSize = rxMessageSize;
+    newReq.timeoutMs     = timeoutMs;
+    newReq.callback      = callback;
+    newReq.context       = context;
+    newReq.seq           = 0;
+    newReq.isUrgent      = isUrgent;
+    newReq.isSent        = false;
+    newReq.deadlineMs    = 0;
+
+    reqs = (const PendingRequest*)vector_get_data(sPendingRequests);
+    if (isUrgent) {
+        while (index < vector_size(sPendingRequests)
+        &&  (reqs[index].isSent || reqs[index].isUrgent)) {
+            index++;
+        }
+    } else {
+        index = vector_size(sPendingRequests);
+    }
+    if (0 != vector_add_at(sPendingRequests, index, &newReq)) {
+        free(newReq.txMessage);
+        return false;
+    }
+    SendRTApp_StartNext();
+
+    return true;
+}
+
+bool
+SendRTApp_SendMessageToRTCoreAsync(
+    const unsigned char* txMessage, long txMessageSize, long rxMessageSize,
+    int timeoutMs, SendRTApp_ResponseCallback callback, void* context)
+{
+    return SendRTApp_Enqueue(txMessage, txMessageSize, rxMessageSize,
+        timeoutMs, callback, context, false);
+}
+
+bool
+SendRTApp_SendUrgentMessageToRTCoreAsync(
+    const unsigned char* txMessage, long txMessageSize, long rxMessageSize,
+    int timeoutMs, SendRTApp_ResponseCallback callback, void* context)
+{
+    return SendRTApp_Enqueue(txMessage, txMessageSize, rxMessageSize,
+        timeoutMs, callback, context, true);
+}
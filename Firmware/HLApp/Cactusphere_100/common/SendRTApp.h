@@ -29,15 +29,40 @@
 #include <stdbool.h>
 #endif
 
+typedef struct EventLoop	EventLoop;
+
+// Callback of asynchronous request
+//   rxMessage is NULL if the request failed or timed out, and is valid
+//   only while the callback
+typedef void (*SendRTApp_ResponseCallback)(void* context,
+    const unsigned char* rxMessage, long rxMessageSize);
+
 // Initialization and cleanup
 extern bool SendRTApp_InitHandlers(void);
 extern void SendRTApp_CloseHandlers(void);
 
 // Send request message to RTApp (and receve response)
+//   not for RTApp of asynchronous requests, blocking request fails
+//   once EventLoop is registered
 extern bool SendRTApp_SendMessageToRTCore(
     const unsigned char* txMessage, long txMessageSize);
 extern bool SendRTApp_SendMessageToRTCoreAndReadMessage(
     const unsigned char* txMessage, long txMessageSize,
     unsigned char* rxMessage, long rxMessageSize);
 
+// Asynchronous request (response is received in EventLoop)
+//   the first 4 bytes of txMessage are for the seq set by SendRTApp,
+//   the callback is not called before the request returns, the requests
+//   outstanding fail (callback with NULL) on unregistration.
+//   Urgent request is sent even while another request is in flight
+//   (RTApp cuts the scan list in progress short)
+extern bool SendRTApp_RegisterEventLoop(EventLoop* eventLoop);
+extern void SendRTApp_UnregisterEventLoop(void);
+extern bool SendRTApp_SendMessageToRTCoreAsync(
+    const unsigned char* txMessage, long txMessageSize, long rxMessageSize,
+    int timeoutMs, SendRTApp_ResponseCallback callback, void* context);
+extern bool SendRTApp_SendUrgentMessageToRTCoreAsync(
+    const unsigned char* txMessage, long txMessageSize, long rxMessageSize,
+    int timeoutMs, SendRTApp_ResponseCallback callback, void* context);
+
 #endif  // _TELEMETRYITEMS_H_
@@ -134,3 +134,16 @@ StringBuf_AppendByPrintf(StringBuf* me, const char* fmt, ...)
 
     StringBuf_Append(me, me->mPrintfBuf);
 }
+
+void
+StringBuf_AppendJSONString(StringBuf* me, const char* str)
+{
+    StringBuf_AppendChar(me, '"');
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\') {
+            StringBuf_AppendChar(me, '\\');
+        }
+        StringBuf_AppendChar(me, *str);
+    }
+    StringBuf_AppendChar(me, '"');
+}
@@ -45,4 +45,7 @@ extern void	StringBuf_AppendChar(StringBuf* me, char c);
 extern void	StringBuf_Append(StringBuf* me, const char* str);
 extern void	StringBuf_AppendByPrintf(StringBuf* me, const char* fmt, ...);
 
+// Append string as JSON string (quoted, '"' and '\\' are escaped)
+extern void	StringBuf_AppendJSONString(StringBuf* me, const char* str);
+
 #endif  // _STRING_BUF_H_
@@ -138,9 +138,16 @@ static volatile sig_atomic_t exitCode = ExitCode_Success;
 #include "ModbusFetchConfig.h"
 #include "LibModbus.h"
 #include "ModbusDataFetchScheduler.h"
+#include "ModbusDiagnostics.h"
+#include "ModbusTcpServer.h"
+#include "StringBuf.h"
+#ifdef MODBUS_CRC_BENCHMARK
+#include "ModbusCRC.h"
+#endif  // MODBUS_CRC_BENCHMARK
 #endif  // USE_MODBUS
 
 #ifdef USE_MODBUS_TCP
+#include "LibModbusTcp.h"
 #include "ModbusTcpConfigMgr.h"
 #include "ModbusTcpFetchConfig.h"
 #endif // USE_MODBUS_TCP
@@ -419,6 +426,9 @@ int main(int argc, char *argv[])
 #ifdef USE_MODBUS
     mTelemetrySchedulerArr[MODBUS_RTU] = Factory_CreateScheduler(MODBUS_RTU);
     ModbusConfigMgr_Initialize();
+#ifdef MODBUS_CRC_BENCHMARK
+    ModbusCRC_Benchmark();
+#endif  // MODBUS_CRC_BENCHMARK
 #endif  // USE_MODBUS
 #ifdef USE_MODBUS_TCP
     mTelemetrySchedulerArr[MODBUS_TCP] = Factory_CreateScheduler(MODBUS_TCP);
@@ -465,12 +475,18 @@ int main(int argc, char *argv[])
         }
     }
 
+    // fail outstanding requests to RTApp while their owners are alive
+    SendRTApp_UnregisterEventLoop();
+
     TelemetryItems_CleanupDictionary();
 #ifdef USE_MODBUS
+    ModbusDiagnostics_UnregisterEventLoop();
+    ModbusTcpServer_UnregisterEventLoop();
     ModbusConfigMgr_Cleanup();
 #endif  // USE_MODBUS
 
 #ifdef USE_MODBUS_TCP
+    LibmodbusTcp_UnregisterEventLoop();
     ModbusTcpConfigMgr_Cleanup();
 #endif  // USE_MODBUS_TCP
 
@@ -873,6 +889,27 @@ static ExitCode InitPeripheralsAndHandlers(void)
         return ExitCode_SetUpSysEvent_EventLoop;
     }
 
+#ifdef USE_MODBUS
+    // receive responses from RTApp in event loop
+    if (! SendRTApp_RegisterEventLoop(eventLoop)) {
+        Log_Debug("WARNING: RTApp requests are not processed.\n");
+    }
+    // serve the slaves to Modbus TCP clients (if configured)
+    if (! ModbusTcpServer_RegisterEventLoop(eventLoop)) {
+        Log_Debug("WARNING: Modbus TCP server is not started.\n");
+    }
+    // collect transaction statistics of RS-485 bus
+    if (! ModbusDiagnostics_RegisterEventLoop(eventLoop)) {
+        Log_Debug("WARNING: Modbus diagnostics is not collected.\n");
+    }
+#endif  // USE_MODBUS
+#ifdef USE_MODBUS_TCP
+    // read Modbus TCP servers concurrently in event loop
+    if (! LibmodbusTcp_RegisterEventLoop(eventLoop)) {
+        Log_Debug("WARNING: Modbus TCP servers are read one by one.\n");
+    }
+#endif  // USE_MODBUS_TCP
+
     SetupWatchdog();
     struct timespec watchdogKickPeriod = {.tv_sec = 0, .tv_nsec = 500 * 1000 * 1000};
     watchdogLoopTimer =
@@ -934,6 +971,21 @@ static void ClosePeripheralsAndHandlers(void)
     EventLoop_Close(eventLoop);
 }
 
+#ifdef USE_MODBUS
+/// <summary>
+///     Send RTApp version got by Libmodbus_GetRTAppVersionAsync().
+/// </summary>
+static void RTAppVersionCallback(void* context, const char* rtAppVersion)
+{
+    static char propertyStr[280] = { 0 };
+
+    if (rtAppVersion != NULL) {
+        snprintf(propertyStr, sizeof(propertyStr), "{ \"%s\": \"%s\" }", "RTAppVersion", rtAppVersion);
+        IoT_CentralLib_SendProperty(propertyStr);
+    }
+}
+#endif  // USE_MODBUS
+
 /// <summary>
 ///     Sets the IoT Hub authentication state for the app
 ///     The SAS Token expires which will set the authentication state
@@ -976,17 +1028,19 @@ static void HubConnectionStatusCallback(IOTHUB_CLIENT_CONNECTION_STATUS result,
             snprintf(propertyStr, sizeof(propertyStr), EventMsgTemplate, "HLAppVersion", HLAPP_VERSION);
             IoT_CentralLib_SendProperty(propertyStr);
             // RTApp
-            char rtAppVersion[256] = { 0 };
-            bool ret = false;
 #if defined USE_DI
-            ret = DI_Lib_ReadRTAppVersion(rtAppVersion);
-#elif defined USE_MODBUS
-            ret = Libmodbus_GetRTAppVersion(rtAppVersion);
-#endif
-            if (ret) {
+            char rtAppVersion[256] = { 0 };
+
+            if (DI_Lib_ReadRTAppVersion(rtAppVersion)) {
                 snprintf(propertyStr, sizeof(propertyStr), EventMsgTemplate, "RTAppVersion", rtAppVersion);
                 IoT_CentralLib_SendProperty(propertyStr);
             }
+#elif defined USE_MODBUS
+            // (sent when RTApp answers)
+            if (! Libmodbus_GetRTAppVersionAsync(RTAppVersionCallback, NULL)) {
+                Log_Debug("ERROR: RTApp version is not requested.\n");
+            }
+#endif
 
             sphereStatus.isEepromReadSuccess = true;
             ChangeLedStatus(LED_ON);
@@ -1414,6 +1468,28 @@ static void TwinCallback(DEVICE_TWIN_UPDATE_STATE updateState, const unsigned ch
     }
 }
 
+#ifdef USE_MODBUS
+/// <summary>
+///     Report the result of Modbus write command (and of each write for
+///     batched write command).
+/// </summary>
+static void ModbusWriteResultCallback(const char* response, const char* results)
+{
+    StringBuf* reportedProperties = StringBuf_New();
+
+    if (NULL == reportedProperties) {
+        return;
+    }
+    StringBuf_AppendByPrintf(reportedProperties, "{ \"ModbusWriteRegisterResult\": %s", response);
+    if (NULL != results) {
+        StringBuf_AppendByPrintf(reportedProperties, ", \"ModbusWriteResults\": %s", results);
+    }
+    StringBuf_Append(reportedProperties, " }");
+    IoT_CentralLib_SendProperty(StringBuf_GetStr(reportedProperties));
+    StringBuf_Destroy(reportedProperties);
+}
+#endif  // USE_MODBUS
+
 static int CommandCallback(const char* method_name, const unsigned char* payload, size_t size,
     unsigned char** response, size_t* response_size, void* userContextCallback) {
 
@@ -1425,18 +1501,57 @@ static int CommandCallback(const char* method_name, const unsigned char* payload
     char reportedPropertiesString[100];
 
 #ifdef USE_MODBUS
-    static const char* ReportMsgTemplate = "{ \"ModbusWriteRegisterResult\": \"%s\" }";
+    static const char* ReportMsgTemplate = "{ \"ModbusWriteRegisterResult\": %s }";
+    static const char ModbusSlaveHealthKey[] = "ModbusSlaveHealth";
+    static const char ModbusDiagnosticsKey[] = "ModbusDiagnostics";
+
+    if (0 == strcmp(method_name, ModbusSlaveHealthKey)) {
+        // health of each slave device (as a string of JSON)
+        StringBuf* healthJson = StringBuf_New();
+        StringBuf* healthStr = StringBuf_New();
+
+        if (NULL != healthJson && NULL != healthStr) {
+            Libmodbus_AppendHealthJSON(healthJson);
+            StringBuf_AppendJSONString(healthStr, StringBuf_GetStr(healthJson));
+
+            *response_size = StringBuf_GetLength(healthStr);
+            *response = malloc(*response_size);
+            if (NULL != *response) {
+                (void)memcpy(*response, StringBuf_GetStr(healthStr), *response_size);
+            }
+        }
+        StringBuf_Destroy(healthStr);
+        StringBuf_Destroy(healthJson);
+        goto end;
+    }
+    if (0 == strcmp(method_name, ModbusDiagnosticsKey)) {
+        // transaction statistics of the bus and each slave (as a string of JSON)
+        StringBuf* diagJson = StringBuf_New();
 
-    ModbusOneshotcommand(payload, size, deviceMethodResponse);
+        if (NULL != diagJson) {
+            ModbusDiagnostics_AppendJSONString(diagJson);
 
-    // send result
+            *response_size = StringBuf_GetLength(diagJson);
+            *response = malloc(*response_size);
+            if (NULL != *response) {
+                (void)memcpy(*response, StringBuf_GetStr(diagJson), *response_size);
+            }
+            StringBuf_Destroy(diagJson);
+        }
+        goto end;
+    }
+
+    // the writes are run by the write queue, the result is reported
+    // by ModbusWriteResultCallback()
+    if (! ModbusOneshotcommand(payload, size, deviceMethodResponse, ModbusWriteResultCallback)) {
+        snprintf(reportedPropertiesString, sizeof(reportedPropertiesString), ReportMsgTemplate, deviceMethodResponse);
+        IoT_CentralLib_SendProperty(reportedPropertiesString);
+    }
     *response_size = strlen(deviceMethodResponse);
     *response = malloc(*response_size);
     if (NULL != response) {
         (void)memcpy(*response, deviceMethodResponse, *response_size);
     }
-    snprintf(reportedPropertiesString, sizeof(reportedPropertiesString), ReportMsgTemplate, deviceMethodResponse);
-    IoT_CentralLib_SendProperty(reportedPropertiesString);
 #endif
 
 #ifdef USE_DI
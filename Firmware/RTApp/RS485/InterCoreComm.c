@@ -34,16 +34,23 @@
 static BufferHeader*	sOutboundBuf = NULL;
 static BufferHeader*	sInboundBuf  = NULL;
 static uint32_t	sRingBufSize;
-static unsigned char	sRecvBuf[MAX_UART_WRITE_LEN * 2];  // 512
+static unsigned char	sRecvBuf[MAX_UART_WRITE_LEN * 4];  // 1024
 static UART_DriverMsg*	sDriverMsgBuf = NULL;
+static uint32_t	sRequestSeq = 0;  // seq of the request received last
 
 static bool
-InterCoreComm_SendData(const uint8_t* data, uint16_t len)
+InterCoreComm_SendData(uint32_t status, const uint8_t* data, uint16_t len)
 {
-    memcpy(sRecvBuf + 20, data, len);
+    // response header (seq of the request) and the data
+    UART_ReturnHdr	retHdr = { .seq = sRequestSeq, .status = status };
+
+    if (len > 0) {
+        memmove(sRecvBuf + 20 + sizeof(retHdr), data, len);
+    }
+    memcpy(sRecvBuf + 20, &retHdr, sizeof(retHdr));
 
     return (0 == EnqueueData(sInboundBuf, sOutboundBuf, sRingBufSize,
-        sRecvBuf, 20 + len));
+        sRecvBuf, 20 + sizeof(retHdr) + len));
 }
 
 // Initialization
@@ -59,23 +66,13 @@ InterCoreComm_Initialize()
     return true;
 }
 
-// Wait and receive request from HLApp
-const UART_DriverMsg*
-InterCoreComm_WaitAndRecvRequest()
+static const UART_DriverMsg*
+InterCoreComm_CheckRequest(uint32_t dataSize)
 {
-    uint32_t	dataSize;
-    UART_DriverMsgHdr*	msgHdr;
+    UART_DriverMsgHdr*	msgHdr = &sDriverMsgBuf->header;
 
-    // wait request message arrives while sleep
-    while (true) {
-        dataSize = sizeof(sRecvBuf);
-        if (0 == DequeueData(sOutboundBuf, sInboundBuf,
-                sRingBufSize, sRecvBuf, &dataSize)) {
-            break;
-        }
-        TimerUtil_SleepUntilIntr();
-    }
-    msgHdr = &sDriverMsgBuf->header;
+    // keep seq for the response (the buffer is overwritten by it)
+    sRequestSeq = (dataSize >= 20 + sizeof(uint32_t)) ? msgHdr->seq : 0;
 
     // check the received message's integrity
     if (dataSize <= sizeof(UART_DriverMsgHdr)) {
@@ -83,7 +80,7 @@ InterCoreComm_WaitAndRecvRequest()
     }
     switch (msgHdr->requestCode) {
     case UART_REQ_WRITE_AND_READ:
-        if (msgHdr->messageLen != ((sizeof(uint16_t) * 2) +
+        if (msgHdr->messageLen != (sizeof(UART_LineParams) + (sizeof(uint16_t) * 2) +
                 sDriverMsgBuf->body.writeAndReadReq.writeLen)) {
             return NULL;  // invalid length
         }
@@ -93,6 +90,58 @@ InterCoreComm_WaitAndRecvRequest()
             return NULL;  // invalid length
         }
         break;
+    case UART_REQ_SCAN_LIST:
+        {
+            const UART_MsgScanList*	scanList = &sDriverMsgBuf->body.scanListReq;
+            const uint8_t*	frames = (const uint8_t*)scanList->frames;
+            uint32_t	framesLen = 0;
+
+            if (msgHdr->messageLen < sizeof(UART_LineParams) + sizeof(uint16_t) * 2
+            ||  msgHdr->messageLen > sizeof(UART_LineParams) + sizeof(uint16_t) * 2 + MAX_UART_SCAN_LEN) {
+                return NULL;  // invalid length
+            }
+            for (int i = 0; i < scanList->frameCount; i++) {
+                const UART_ScanFrame*	frame =
+                    (const UART_ScanFrame*)(frames + framesLen);
+
+                if (framesLen + sizeof(uint16_t) * 2 > MAX_UART_SCAN_LEN
+                ||  frame->writeLen > MAX_UART_WRITE_LEN) {
+                    return NULL;  // invalid frame
+                }
+                framesLen += UART_SCAN_FRAME_SIZE(frame->writeLen);
+            }
+            if (msgHdr->messageLen != sizeof(UART_LineParams) + sizeof(uint16_t) * 2 + framesLen) {
+                return NULL;  // invalid length
+            }
+        }
+        break;
+    case UART_REQ_POLL_CONFIG:
+        {
+            const UART_MsgPollConfig*	pollConfig = &sDriverMsgBuf->body.pollConfigReq;
+            const uint8_t*	entries = (const uint8_t*)pollConfig->entries;
+            uint32_t	entriesLen = 0;
+
+            if (msgHdr->messageLen < sizeof(uint16_t) * 2
+            ||  msgHdr->messageLen > sizeof(uint16_t) * 2 + MAX_UART_SCAN_LEN) {
+                return NULL;  // invalid length
+            }
+            for (int i = 0; i < pollConfig->entryCount; i++) {
+                const UART_PollEntry*	entry =
+                    (const UART_PollEntry*)(entries + entriesLen);
+
+                if (entriesLen + UART_POLL_ENTRY_SIZE(0) > MAX_UART_SCAN_LEN
+                ||  entry->writeLen > MAX_UART_POLL_WRITE_LEN) {
+                    return NULL;  // invalid entry
+                }
+                entriesLen += UART_POLL_ENTRY_SIZE(entry->writeLen);
+            }
+            if (msgHdr->messageLen != sizeof(uint16_t) * 2 + entriesLen) {
+                return NULL;  // invalid length
+            }
+        }
+        break;
+    case UART_REQ_POLL_FETCH:
+    case UART_REQ_GET_STATS:
     case UART_REQ_VERSION:
         if (msgHdr->messageLen != 0) {
             return NULL;  // invalid length
@@ -105,18 +154,67 @@ InterCoreComm_WaitAndRecvRequest()
     return sDriverMsgBuf;
 }
 
+// Wait and receive request from HLApp
+const UART_DriverMsg*
+InterCoreComm_WaitAndRecvRequest()
+{
+    uint32_t	dataSize;
+
+    // wait request message arrives while sleep
+    while (true) {
+        dataSize = sizeof(sRecvBuf);
+        if (0 == DequeueData(sOutboundBuf, sInboundBuf,
+                sRingBufSize, sRecvBuf, &dataSize)) {
+            break;
+        }
+        TimerUtil_SleepUntilIntr();
+    }
+
+    return InterCoreComm_CheckRequest(dataSize);
+}
+
+// Receive request from HLApp if arrived (NULL if no request or invalid)
+const UART_DriverMsg*
+InterCoreComm_RecvRequest(bool* outReceived)
+{
+    uint32_t	dataSize = sizeof(sRecvBuf);
+
+    *outReceived = (0 == DequeueData(sOutboundBuf, sInboundBuf,
+        sRingBufSize, sRecvBuf, &dataSize));
+    if (! *outReceived) {
+        return NULL;
+    }
+
+    return InterCoreComm_CheckRequest(dataSize);
+}
+
+// Check whether the next request has arrived
+bool
+InterCoreComm_IsRequestPending()
+{
+    return *(volatile uint32_t*)&sInboundBuf->writePosition
+        != sOutboundBuf->readPosition;
+}
+
 // Send UART received data to HLApp
 bool
 InterCoreComm_SendReadData(const uint8_t* data, uint16_t len)
 {
-    if (len > sizeof(sRecvBuf) - 20) {
+    if (len > sizeof(sRecvBuf) - 20 - sizeof(UART_ReturnHdr)) {
         return false;
     }
-    return InterCoreComm_SendData(data, len);
+    return InterCoreComm_SendData(UART_STATUS_OK, data, len);
 }
 
 bool
 InterCoreComm_SendIntValue(int val)
 {
-    return InterCoreComm_SendData((uint8_t*)&val, sizeof(val));
+    return InterCoreComm_SendData(UART_STATUS_OK, (uint8_t*)&val, sizeof(val));
+}
+
+// Send error response to HLApp (request not done)
+bool
+InterCoreComm_SendError(uint32_t status)
+{
+    return InterCoreComm_SendData(status, NULL, 0);
 }
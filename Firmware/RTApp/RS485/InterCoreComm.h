@@ -42,8 +42,18 @@ extern bool	InterCoreComm_Initialize();
 // Wait and receive request from HLApp
 extern const UART_DriverMsg*	InterCoreComm_WaitAndRecvRequest();
 
+// Receive request from HLApp without waiting
+//   outReceived is set to false if no request arrived
+extern const UART_DriverMsg*	InterCoreComm_RecvRequest(bool* outReceived);
+
+// Check whether the next request has arrived (without receiving it)
+extern bool	InterCoreComm_IsRequestPending();
+
 // Send UART received data to HLApp
 extern bool	InterCoreComm_SendReadData(const uint8_t* data, uint16_t len);
 extern bool	InterCoreComm_SendIntValue(int val);
 
+// Send error response to HLApp (status is UART_STATUS_INVALID/FAILED)
+extern bool	InterCoreComm_SendError(uint32_t status);
+
 #endif  // _INTER_CORE_COMM_H_
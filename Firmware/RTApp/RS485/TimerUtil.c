@@ -26,6 +26,15 @@
 
 #include "mt3620-timer.h"
 
+// GPT3 (free running counter)
+static const uintptr_t	GPT_BASE = 0x21030000;
+#define GPT3_CTRL	0x50
+#define GPT3_INIT	0x54
+#define GPT3_CNT	0x58
+#define GPT3_CTRL_EN	(1 << 0)
+#define GPT3_CTRL_OSC_CNT_1US_SHIFT	16
+#define GPT3_OSC_CNT_1US	25  // 26[MHz] / (25 + 1) = 1[MHz]
+
 static uint32_t	sTickCount = 0;
 
 static void
@@ -43,6 +52,12 @@ TimerUtil_Initialize()
     Gpt_Init();
     Gpt_LaunchTimerMs(TimerGpt0, 10, TimerCallback);
 
+    // free running counter at 1 [MHz]
+    WriteReg32(GPT_BASE, GPT3_CTRL, 0);
+    WriteReg32(GPT_BASE, GPT3_INIT, 0);
+    WriteReg32(GPT_BASE, GPT3_CTRL,
+        (GPT3_OSC_CNT_1US << GPT3_CTRL_OSC_CNT_1US_SHIFT) | GPT3_CTRL_EN);
+
     return true;
 }
 
@@ -59,3 +74,10 @@ TimerUtil_GetTickCount()
 {
     return sTickCount;
 }
+
+// free running counter (count/usec)
+uint32_t
+TimerUtil_GetMicroCount()
+{
+    return ReadReg32(GPT_BASE, GPT3_CNT);
+}
@@ -41,4 +41,7 @@ extern void	TimerUtil_SleepUntilIntr();
 // tick count (count/msec)
 extern uint32_t	TimerUtil_GetTickCount();
 
+// free running counter (count/usec)
+extern uint32_t	TimerUtil_GetMicroCount();
+
 #endif  // _TIMER_UTIL_H_
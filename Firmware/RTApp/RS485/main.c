@@ -36,11 +36,12 @@
 #include "mt3620-timer.h"
 
 #include "InterCoreComm.h"
+#include "ModbusCRC.h"
 #include "TimerUtil.h"
 #include "UartDriveMsg.h"
 
 
-const int TIMEOUT = 400; // 400[ms]
+const uint32_t TIMEOUT_US = 400000; // 400[ms] (until the first byte of response)
 
 #define OK  1
 #define NG  -1
@@ -65,8 +66,20 @@ typedef unsigned int u32;
 #define UART_LCR_PEN    		(1 << 3)
 #define UART_LCR_STB_SHIFT		(2)
 #define UART_LCR_WLS_SHIFT		(0)
+#define UART_IER				(0x4)
+#define UART_IIR				(0x8)
+#define UART_FCR				(0x8)
+#define UART_LSR				(0x14)
+#define UART_IER_ERBFI			(1 << 0)
+#define UART_FCR_FIFOE			(1 << 0)
+#define UART_FCR_CLRR			(1 << 1)
+#define UART_FCR_CLRT			(1 << 2)
+#define UART_LSR_DR				(1 << 0)
 
-#define RX_BUFFER_SIZE 10
+#define UART_ISU3_IRQ			59  // ISU3 UART interrupt
+#define UART_PRIORITY			2
+
+#define RX_BUFFER_SIZE 256  // max Modbus RTU ADU size
 
 extern uint32_t StackTop; // &StackTop == end of TCM
 
@@ -75,6 +88,80 @@ static _Noreturn void DefaultExceptionHandler(void);
 // ISU3 UART Base Address
 static const uintptr_t UART_BASE = 0x380a0500;
 
+// silent interval between frames (3.5 characters) [usec]
+static uint32_t sSilentIntervalUs = 0;
+
+// receive ring buffer (filled by Uart_HandleIrqIsu3)
+#define RX_RING_SIZE 512  // must be power of 2
+static volatile uint8_t sRxRing[RX_RING_SIZE];
+static volatile uint32_t sRxHead = 0;      // written by interrupt handler
+static uint32_t sRxTail = 0;               // read by main loop
+static volatile uint32_t sRxLastTime = 0;  // time of the last received byte [usec]
+static uint32_t sTxLastTime = 0;           // time of the last transmitted byte [usec]
+
+// response buffer for UART_REQ_SCAN_LIST
+static uint32_t sScanRetBuf[(sizeof(uint16_t) * 2 + MAX_UART_SCAN_LEN) / sizeof(uint32_t)];
+
+// current UART line parameters
+static bool sUartReady = false;
+static u32 sLineBaudRate = 0;
+static u8 sLineParity = 0;
+static u8 sLineStop = 0;
+
+// poll schedule (UART_REQ_POLL_CONFIG), run by the main loop
+typedef struct PollEntry {
+    u32 baudRate;
+    u32 intervalMs;
+    u8 parity;
+    u8 stop;
+    u16 timeoutMs;
+    u16 writeLen;
+    u16 readLen;
+    u8 writeData[MAX_UART_POLL_WRITE_LEN];
+    u32 nextDueMs;  // tick count to poll next
+    u8 slaveIndex;  // index of sPollSlaves
+} PollEntry;
+
+static PollEntry sPollEntries[MAX_UART_POLL_ENTRIES];
+static int sPollEntryCount = 0;
+static bool sPollRunning = false;
+
+// health of the slaves of poll schedule, the response timeout follows
+// the response time of the slave, a slave not answering is backed off
+// (polled once per backoff interval until it answers)
+#define POLL_FAIL_CYCLES        3       // transactions without response until backoff
+#define POLL_BACKOFF_MIN_MS     2000
+#define POLL_BACKOFF_MAX_MS     300000
+#define POLL_TIMEOUT_MIN_MS     50
+#define POLL_TIMEOUT_MARGIN_MS  30
+#define POLL_LATENCY_WEIGHT     8       // weight of smoothing the response time
+
+typedef struct PollSlave {
+    u8 devId;
+    u8 failCount;       // transactions without response in a row
+    bool hasLatency;    // avgElapsedMs is measured
+    u16 avgElapsedMs;   // smoothed response time
+    u32 backoffMs;      // 0 if answering
+    u32 probeDueMs;     // tick count to poll the slave backed off
+} PollSlave;
+
+static PollSlave sPollSlaves[MAX_UART_POLL_ENTRIES];
+static int sPollSlaveCount = 0;
+
+// results of poll schedule waiting for UART_REQ_POLL_FETCH (UART_PollResult)
+#define POLL_RESULT_BUF_SIZE 8192
+static uint32_t sPollResultBuf[POLL_RESULT_BUF_SIZE / sizeof(uint32_t)];
+static uint32_t sPollResultLen = 0;
+static uint32_t sPollResultCount = 0;
+static uint32_t sPollDropped = 0;
+
+// response buffer for UART_REQ_POLL_FETCH
+static uint32_t sPollRetBuf[(sizeof(uint32_t) * 3 + MAX_UART_SCAN_LEN) / sizeof(uint32_t)];
+
+// transaction statistics (UART_REQ_GET_STATS), cleared when taken out
+static UART_StatsReturnMsg sStats;
+static uint32_t sStatsStartMs = 0;  // tick count when cleared
+
 
 static
 void Uart_Init(void)
@@ -175,42 +262,551 @@ Uart_WritePoll(const char *msg, int len)
     }
 }
 
-static bool
-Uart_ReadPoll(uint8_t *buffer, int len) {
-    int val;
-    int counter = 0;
-    int recvTime = TimerUtil_GetTickCount();
-
-    // read 1 byte at a time while waiting for data register fill
+static void
+Uart_HandleIrqIsu3(void)
+{
+    // move received bytes into the ring buffer
     //
     // LSR (offset 0x14)'s bit 0 denotes the status of the data read register
-    memset(buffer, 0, len);
-    for (int i = 0; i < len; i++) {
-        while (0 == (ReadReg32(UART_BASE, 0x14) & 0x01)) {
-            if (TimerUtil_GetTickCount() - recvTime > TIMEOUT) {
-                return false;  // timed out
+    (void)ReadReg32(UART_BASE, UART_IIR);
+    while (ReadReg32(UART_BASE, UART_LSR) & UART_LSR_DR) {
+        uint8_t val = (uint8_t)ReadReg32(UART_BASE, 0x00);
+
+        if (sRxHead - sRxTail < RX_RING_SIZE) {
+            sRxRing[sRxHead % RX_RING_SIZE] = val;
+            sRxHead++;
+        }
+        sRxLastTime = TimerUtil_GetMicroCount();
+    }
+}
+
+static void
+Uart_EnableRxIntr(void)
+{
+    // enable FIFO and received data interrupt (after UART parameters are set)
+    WriteReg32(UART_BASE, UART_FCR, UART_FCR_FIFOE | UART_FCR_CLRR | UART_FCR_CLRT);
+    WriteReg32(UART_BASE, UART_IER, UART_IER_ERBFI);
+    SetNvicPriority(UART_ISU3_IRQ, UART_PRIORITY);
+    EnableNvicInterrupt(UART_ISU3_IRQ);
+}
+
+static void
+Uart_WakeUp(void)
+{
+    // do nothing (just wake up from TimerUtil_SleepUntilIntr())
+}
+
+static bool
+Uart_IsExceptionFrame(const uint8_t* buffer, int len)
+{
+    // exception response: address, function | 0x80, exception code and CRC
+    return len == 5 && (buffer[1] & 0x80) && ModbusCRC_Check(buffer, 3);
+}
+
+static int
+Uart_ReadFrame(uint8_t *buffer, int maxLen, uint32_t timeoutUs) {
+    // receive a response frame, the end of the frame is detected by
+    // maxLen bytes received, an exception response or the silent
+    // interval of 3.5 characters (returns received length, 0 if no
+    // response in timeoutUs)
+    int len = 0;
+    uint32_t startTime = TimerUtil_GetMicroCount();
+
+    memset(buffer, 0, maxLen);
+    for (;;) {
+        uint32_t lastTime, now;
+
+        while (sRxTail != sRxHead && len < maxLen) {
+            uint8_t val = sRxRing[sRxTail % RX_RING_SIZE];
+
+            sRxTail++;
+            if (val != 0 || len > 0) {  // skip noise at turning around the line
+                buffer[len++] = val;
             }
         }
-        val = (uint8_t)ReadReg32(UART_BASE, 0x00);
-        if (val != 0) {
-            buffer[counter++] = val;
-        } else if (val == 0 && counter > 0) {
-            buffer[counter++] = val;
+        if (len >= maxLen || Uart_IsExceptionFrame(buffer, len)) {
+            return len;
+        }
+
+        lastTime = sRxLastTime;
+        now = TimerUtil_GetMicroCount();
+        if (len == 0) {
+            if (now - startTime >= timeoutUs) {
+                return 0;  // timed out
+            }
+        } else if (now - lastTime >= sSilentIntervalUs) {
+            return len;  // end of frame
+        } else {
+            Gpt_LaunchTimerMs(TimerGpt1,
+                (sSilentIntervalUs - (now - lastTime)) / 1000 + 1, Uart_WakeUp);
         }
-        recvTime = TimerUtil_GetTickCount();
+        TimerUtil_SleepUntilIntr();
+    }
+}
+
+static void
+Uart_DataSkip() {
+    // discard unknown received data
+    uint32_t prevBasePri = BlockIrqs();
+
+    sRxTail = sRxHead;
+    RestoreIrqs(prevBasePri);
+}
+
+static uint32_t
+Uart_CalcSilentInterval(u32 baudrate, u8 parity, u8 stop)
+{
+    // time of 3.5 characters (start + data + parity + stop) in [usec],
+    // fixed to 1750[usec] above 19200[bps] by Modbus over serial line spec
+    u32 bits = 1 + 8 + (parity ? 1 : 0) + stop;
+
+    if (baudrate > 19200) {
+        return 1750;
+    }
+    return (uint32_t)((uint64_t)bits * 3500000 / baudrate);
+}
+
+static void
+Uart_WaitSilentInterval(void)
+{
+    // keep 3.5 characters from the last transmitted or received byte
+    for (;;) {
+        uint32_t now = TimerUtil_GetMicroCount();
+
+        if (now - sTxLastTime >= sSilentIntervalUs
+        &&  now - sRxLastTime >= sSilentIntervalUs) {
+            break;
+        }
+    }
+}
+
+static int
+Uart_WriteAndRead(const uint8_t* writeData, int writeLen, uint8_t* readBuf, int readLen,
+    uint32_t timeoutUs)
+{
+    Uart_WaitSilentInterval();
+    Uart_DataSkip();  // read out unknown received data
+
+    // send request to the opposing device via RS-485
+    Mt3620_Gpio_Write(21, true);  // DE (enable)
+    Mt3620_Gpio_Write(23, true);  // RE_N (disable)
+    Uart_WritePoll((const char*)writeData, writeLen);
+    sTxLastTime = TimerUtil_GetMicroCount();
+
+    // receive response from the opposing device
+    Mt3620_Gpio_Write(21, false);
+    Mt3620_Gpio_Write(23, false);
+
+    return Uart_ReadFrame(readBuf, readLen, timeoutUs);
+}
+
+static void
+Stats_Add(uint8_t devId, uint8_t status, const uint8_t* readBuf, uint16_t readLen,
+    uint16_t elapsedMs)
+{
+    // count a transaction of the slave (response time is of the responses)
+    static const uint16_t latencyLimits[] = UART_STATS_LATENCY_LIMITS;
+    UART_SlaveStats* slave = NULL;
+    int bin;
+
+    for (int i = 0; i < sStats.slaveCount; i++) {
+        if (sStats.slaves[i].devId == devId) {
+            slave = &sStats.slaves[i];
+            break;
+        }
+    }
+    if (slave == NULL) {
+        if (sStats.slaveCount >= MAX_UART_STATS_SLAVES) {
+            sStats.untracked++;
+            return;
+        }
+        slave = &sStats.slaves[sStats.slaveCount++];
+        memset(slave, 0, sizeof(*slave));
+        slave->devId = devId;
+    }
+
+    slave->requestCount++;
+    switch (status) {
+    case UART_SCAN_TIMEOUT:
+        slave->timeoutCount++;
+        return;
+    case UART_SCAN_EXCEPTION:
+        slave->exceptionCount++;
+        break;
+    case UART_SCAN_SHORT:
+        slave->shortCount++;
+        break;
+    default:
+        if (readLen <= 2 || ! ModbusCRC_Check(readBuf, readLen - 2)) {
+            slave->crcErrorCount++;
+        }
+        break;
+    }
+    for (bin = 0; bin < UART_STATS_LATENCY_BINS - 1 && elapsedMs >= latencyLimits[bin]; bin++) {
+        ;
+    }
+    slave->latency[bin]++;
+}
+
+static uint16_t
+Stats_Prepare(void)
+{
+    // fill in the period of sStats (returns the length to send back)
+    sStats.periodMs = TimerUtil_GetTickCount() - sStatsStartMs;
+    sStats.reserved = 0;
+
+    return (uint16_t)UART_STATS_RETURN_SIZE(sStats.slaveCount);
+}
+
+static void
+Stats_Clear(void)
+{
+    sStats.slaveCount = 0;
+    sStats.untracked  = 0;
+    sStats.reconfigCount = 0;
+    sStatsStartMs = TimerUtil_GetTickCount();
+}
+
+static uint8_t
+Uart_ExchangeFrame(const uint8_t* writeData, int writeLen, uint8_t* readBuf, int readLen,
+    uint32_t timeoutUs, uint16_t* outReadLen, uint16_t* outElapsedMs)
+{
+    // send a request frame and receive its response (returns UART_SCAN_xxx)
+    int len = Uart_WriteAndRead(writeData, writeLen, readBuf, readLen, timeoutUs);
+
+    uint8_t status;
+
+    *outReadLen   = 0;
+    *outElapsedMs = 0;
+    if (len == 0) {
+        status = UART_SCAN_TIMEOUT;
+    } else {
+        *outReadLen   = (uint16_t)len;
+        *outElapsedMs = (uint16_t)((sRxLastTime - sTxLastTime) / 1000);
+        if (Uart_IsExceptionFrame(readBuf, len)) {
+            status = UART_SCAN_EXCEPTION;
+        } else if (len < readLen) {
+            status = UART_SCAN_SHORT;
+        } else {
+            status = UART_SCAN_OK;
+        }
+    }
+    Stats_Add(writeData[0], status, readBuf, *outReadLen, *outElapsedMs);
+
+    return status;
+}
+
+static uint32_t
+Uart_ResponseTimeoutUs(uint16_t timeoutMs)
+{
+    // requested response timeout (up to TIMEOUT_US)
+    if (timeoutMs != 0 && timeoutMs * 1000 < TIMEOUT_US) {
+        return timeoutMs * 1000;
+    }
+    return TIMEOUT_US;
+}
+
+static uint16_t
+Uart_ScanList(const UART_MsgScanList* scanList, bool isReady)
+{
+    // send each request frame and receive its response back-to-back,
+    // stop after the current frame if the next request (e.g. write) has
+    // arrived, so that it waits for one transaction at most
+    UART_ScanListReturnMsg*	retMsg  = (UART_ScanListReturnMsg*)sScanRetBuf;
+    const uint8_t*	frames  = (const uint8_t*)scanList->frames;
+    uint8_t*	results = (uint8_t*)retMsg->results;
+    uint32_t	frameOffset  = 0;
+    uint32_t	resultOffset = 0;
+    uint32_t	timeoutUs    = Uart_ResponseTimeoutUs(scanList->timeoutMs);
+    int 	i;
+
+    for (i = 0; i < scanList->frameCount; i++) {
+        const UART_ScanFrame*	frame  = (const UART_ScanFrame*)(frames + frameOffset);
+        UART_ScanResult*	result = (UART_ScanResult*)(results + resultOffset);
+
+        result->reserved  = 0;
+        result->readLen   = 0;
+        result->elapsedMs = 0;
+        result->reserved2 = 0;
+        if (! isReady) {
+            result->status = UART_SCAN_NOT_READY;
+        } else if (frame->readLen > RX_BUFFER_SIZE
+               ||  resultOffset + UART_SCAN_RESULT_SIZE(frame->readLen) > MAX_UART_SCAN_LEN) {
+            result->status = UART_SCAN_OVERFLOW;
+        } else {
+            result->status = Uart_ExchangeFrame(frame->writeData, frame->writeLen,
+                result->readData, frame->readLen, timeoutUs,
+                &result->readLen, &result->elapsedMs);
+        }
+        frameOffset  += UART_SCAN_FRAME_SIZE(frame->writeLen);
+        resultOffset += UART_SCAN_RESULT_SIZE(result->readLen);
+        if (isReady && InterCoreComm_IsRequestPending()) {
+            i++;
+            break;
+        }
+    }
+    retMsg->frameCount = (uint16_t)i;
+    retMsg->reserved   = 0;
+
+    return (uint16_t)(sizeof(uint16_t) * 2 + resultOffset);
+}
+
+static void
+Uart_SetLineParams(u32 baudrate, u8 parity, u8 stop)
+{
+    // initialize UART with the line parameters
+    // (reprogram UART only if the line parameters are changed)
+    if (sUartReady
+    &&  sLineBaudRate == baudrate
+    &&  sLineParity == parity
+    &&  sLineStop == stop) {
+        return;
+    }
+    Uart_Init();
+    mtk_hdl_uart_set_params(baudrate, parity, stop);
+    Uart_EnableRxIntr();
+    sSilentIntervalUs = Uart_CalcSilentInterval(baudrate, parity, stop);
+    sLineBaudRate = baudrate;
+    sLineParity = parity;
+    sLineStop = stop;
+    sUartReady = true;
+    sStats.reconfigCount++;
+}
+
+static bool
+Uart_ApplyLineParams(const UART_LineParams* line)
+{
+    // set the line parameters of the request (0: keep the current ones),
+    // returns false if UART is not initialized yet
+    if (line->baudRate != 0) {
+        Uart_SetLineParams(line->baudRate, line->parity, line->stop);
+    }
+
+    return sUartReady;
+}
+
+static int
+Poll_FindSlave(u8 devId)
+{
+    // index of the slave in sPollSlaves (added if not found)
+    int i;
+
+    for (i = 0; i < sPollSlaveCount; i++) {
+        if (sPollSlaves[i].devId == devId) {
+            return i;
+        }
+    }
+    memset(&sPollSlaves[i], 0, sizeof(PollSlave));
+    sPollSlaves[i].devId = devId;
+    sPollSlaveCount++;
+
+    return i;
+}
+
+static uint32_t
+Poll_ResponseTimeoutUs(const PollEntry* entry, const PollSlave* slave)
+{
+    // a few times the response time of the slave, up to the requested one
+    uint32_t limitUs = Uart_ResponseTimeoutUs(entry->timeoutMs);
+    uint32_t timeoutUs;
+
+    if (! slave->hasLatency) {
+        return limitUs;
+    }
+    timeoutUs = ((uint32_t)slave->avgElapsedMs * 3 + POLL_TIMEOUT_MARGIN_MS) * 1000;
+    if (timeoutUs < POLL_TIMEOUT_MIN_MS * 1000) {
+        timeoutUs = POLL_TIMEOUT_MIN_MS * 1000;
+    }
+
+    return (timeoutUs < limitUs) ? timeoutUs : limitUs;
+}
+
+static void
+Poll_UpdateSlave(PollSlave* slave, uint8_t status, uint16_t elapsedMs, uint32_t now)
+{
+    if (status == UART_SCAN_OK || status == UART_SCAN_EXCEPTION || status == UART_SCAN_SHORT) {
+        // answered
+        if (slave->hasLatency) {
+            slave->avgElapsedMs = (u16)((int32_t)slave->avgElapsedMs
+                + ((int32_t)elapsedMs - (int32_t)slave->avgElapsedMs) / POLL_LATENCY_WEIGHT);
+        } else {
+            slave->avgElapsedMs = elapsedMs;
+            slave->hasLatency = true;
+        }
+        slave->failCount = 0;
+        slave->backoffMs = 0;
+        return;
+    }
+    if (status != UART_SCAN_TIMEOUT) {
+        return;
+    }
+
+    // wait for the requested timeout from now on, back off if it goes on
+    slave->hasLatency = false;
+    if (slave->failCount < POLL_FAIL_CYCLES) {
+        slave->failCount++;
+    }
+    if (slave->failCount < POLL_FAIL_CYCLES) {
+        return;
+    }
+    if (slave->backoffMs == 0) {
+        slave->backoffMs = POLL_BACKOFF_MIN_MS;
+    } else if (slave->backoffMs < POLL_BACKOFF_MAX_MS / 2) {
+        slave->backoffMs *= 2;
+    } else {
+        slave->backoffMs = POLL_BACKOFF_MAX_MS;
+    }
+    slave->probeDueMs = now + slave->backoffMs;
+}
+
+static bool
+Poll_Configure(const UART_MsgPollConfig* pollConfig)
+{
+    // store the entries of poll schedule, start polling at the last message
+    const uint8_t* entries = (const uint8_t*)pollConfig->entries;
+    uint32_t entryOffset = 0;
+
+    if (! (pollConfig->flags & UART_POLL_CONFIG_APPEND)) {
+        sPollRunning = false;
+        sPollEntryCount = 0;
+        sPollResultLen = 0;
+        sPollResultCount = 0;
+        sPollDropped = 0;
+    }
+    if (sPollEntryCount + pollConfig->entryCount > MAX_UART_POLL_ENTRIES) {
+        sPollEntryCount = 0;
+        return false;
+    }
+    for (int i = 0; i < pollConfig->entryCount; i++) {
+        const UART_PollEntry* entry = (const UART_PollEntry*)(entries + entryOffset);
+        PollEntry* dst = &sPollEntries[sPollEntryCount++];
+
+        dst->baudRate   = entry->baudRate;
+        dst->intervalMs = (entry->intervalMs != 0) ? entry->intervalMs : 1;
+        dst->parity     = entry->parity;
+        dst->stop       = entry->stop;
+        dst->timeoutMs  = entry->timeoutMs;
+        dst->writeLen   = entry->writeLen;
+        dst->readLen    = (entry->readLen <= RX_BUFFER_SIZE) ? entry->readLen : RX_BUFFER_SIZE;
+        memcpy(dst->writeData, entry->writeData, entry->writeLen);
+        entryOffset += UART_POLL_ENTRY_SIZE(entry->writeLen);
+    }
+    if (pollConfig->flags & UART_POLL_CONFIG_START) {
+        uint32_t now = TimerUtil_GetTickCount();
+
+        sPollSlaveCount = 0;
+        for (int i = 0; i < sPollEntryCount; i++) {
+            sPollEntries[i].nextDueMs = now;
+            sPollEntries[i].slaveIndex = (u8)Poll_FindSlave(sPollEntries[i].writeData[0]);
+        }
+        sPollRunning = (sPollEntryCount != 0);
     }
 
     return true;
 }
 
 static void
-Uart_DataSkip() {
-    uint8_t dummy;
+Poll_AddResult(int entryIndex, uint8_t status, const uint8_t* readData,
+    uint16_t readLen, uint16_t elapsedMs)
+{
+    // append a result to the buffer (dropped if the buffer is full)
+    UART_PollResult* result = (UART_PollResult*)((uint8_t*)sPollResultBuf + sPollResultLen);
+
+    if (sPollResultLen + UART_POLL_RESULT_SIZE(readLen) > sizeof(sPollResultBuf)) {
+        sPollDropped++;
+        return;
+    }
+    result->entryIndex  = (uint16_t)entryIndex;
+    result->status      = status;
+    result->reserved    = 0;
+    result->timestampMs = TimerUtil_GetTickCount();
+    result->readLen     = readLen;
+    result->elapsedMs   = elapsedMs;
+    memcpy(result->readData, readData, readLen);
+    sPollResultLen += UART_POLL_RESULT_SIZE(readLen);
+    sPollResultCount++;
+}
+
+static bool
+Poll_RunDue(void)
+{
+    // poll the most overdue entry (returns false if nothing is due),
+    // skip the slaves backed off until their probe is due
+    uint32_t now = TimerUtil_GetTickCount();
+    PollEntry* target = NULL;
+    PollSlave* slave;
+    uint8_t rxBuffer[RX_BUFFER_SIZE];
+    uint16_t readLen, elapsedMs;
+    uint8_t status;
+
+    if (! sPollRunning) {
+        return false;
+    }
+    for (int i = 0; i < sPollEntryCount; i++) {
+        PollEntry* entry = &sPollEntries[i];
+        const PollSlave* entrySlave = &sPollSlaves[entry->slaveIndex];
+
+        if (entrySlave->backoffMs != 0 && (int32_t)(now - entrySlave->probeDueMs) < 0) {
+            continue;
+        }
+        if ((int32_t)(now - entry->nextDueMs) >= 0
+        &&  (target == NULL || (int32_t)(target->nextDueMs - entry->nextDueMs) > 0)) {
+            target = entry;
+        }
+    }
+    if (target == NULL) {
+        return false;
+    }
+
+    slave = &sPollSlaves[target->slaveIndex];
+
+    Uart_SetLineParams(target->baudRate, target->parity, target->stop);
+    status = Uart_ExchangeFrame(target->writeData, target->writeLen,
+        rxBuffer, target->readLen, Poll_ResponseTimeoutUs(target, slave),
+        &readLen, &elapsedMs);
+    Poll_AddResult((int)(target - sPollEntries), status, rxBuffer, readLen, elapsedMs);
+
+    // keep the sampling period, skip the periods already missed
+    target->nextDueMs += target->intervalMs;
+    now = TimerUtil_GetTickCount();
+    Poll_UpdateSlave(slave, status, elapsedMs, now);
+    if ((int32_t)(now - target->nextDueMs) >= 0) {
+        target->nextDueMs = now + target->intervalMs;
+    }
+
+    return true;
+}
 
-    while (1 == (ReadReg32(UART_BASE, 0x14) & 0x01)) {
-        dummy = (uint8_t)ReadReg32(UART_BASE, 0x00);
-        (void)dummy;
+static uint16_t
+Poll_Fetch(void)
+{
+    // take out the results as many as fit in the response message
+    UART_PollFetchReturnMsg* retMsg = (UART_PollFetchReturnMsg*)sPollRetBuf;
+    const uint8_t* results = (const uint8_t*)sPollResultBuf;
+    uint32_t len = 0;
+    uint16_t count = 0;
+
+    while (len < sPollResultLen) {
+        const UART_PollResult* result = (const UART_PollResult*)(results + len);
+        uint32_t size = UART_POLL_RESULT_SIZE(result->readLen);
+
+        if (len + size > MAX_UART_SCAN_LEN) {
+            break;
+        }
+        len += size;
+        count++;
     }
+    memcpy(retMsg->results, results, len);
+    memmove(sPollResultBuf, results + len, sPollResultLen - len);
+    sPollResultLen -= len;
+    sPollResultCount -= count;
+
+    retMsg->resultCount = count;
+    retMsg->remaining   = (uint16_t)sPollResultCount;
+    retMsg->nowMs       = TimerUtil_GetTickCount();
+    retMsg->dropped     = sPollDropped;
+
+    return (uint16_t)(sizeof(uint32_t) * 3 + len);
 }
 
 static _Noreturn void RTCoreMain(void);
@@ -241,7 +837,9 @@ __attribute__((used)) = {
 
     [INT_TO_EXC(0)] = (uintptr_t)DefaultExceptionHandler,
     [INT_TO_EXC(1)] = (uintptr_t)Gpt_HandleIrq1,
-    [INT_TO_EXC(2)... INT_TO_EXC(INTERRUPT_COUNT - 1)] = (uintptr_t)DefaultExceptionHandler };
+    [INT_TO_EXC(2)... INT_TO_EXC(UART_ISU3_IRQ - 1)] = (uintptr_t)DefaultExceptionHandler,
+    [INT_TO_EXC(UART_ISU3_IRQ)] = (uintptr_t)Uart_HandleIrqIsu3,
+    [INT_TO_EXC(UART_ISU3_IRQ + 1)... INT_TO_EXC(INTERRUPT_COUNT - 1)] = (uintptr_t)DefaultExceptionHandler };
 
 static _Noreturn void
 DefaultExceptionHandler(void)
@@ -255,7 +853,6 @@ static _Noreturn void
 RTCoreMain(void)
 {
     uint8_t rxBuffer[RX_BUFFER_SIZE];
-    bool initializeUart = false;
 
     // SCB->VTOR = ExceptionVectorTable
     WriteReg32(SCB_BASE, 0x08, (uint32_t)ExceptionVectorTable);
@@ -295,29 +892,32 @@ RTCoreMain(void)
 
     // main loop
     for (;;) {
-        // wait and receive a request message from HLApp and process it
-        const UART_DriverMsg* msg = InterCoreComm_WaitAndRecvRequest();
-
+        // receive a request message from HLApp and process it,
+        // poll the slaves by poll schedule while no request
+        bool received;
+        const UART_DriverMsg* msg = InterCoreComm_RecvRequest(&received);
+
+        if (! received) {
+            if (! Poll_RunDue()) {
+                TimerUtil_SleepUntilIntr();
+            }
+            continue;
+        }
         if (msg != NULL) {
             UART_ReturnMsg    retMsg;
 
             switch (msg->header.requestCode) {
             case UART_REQ_WRITE_AND_READ:
-                if (initializeUart) {
-                    Uart_DataSkip();  // read out unknown received data
-
-                    // send request to the opposing device via RS-485
-                    Mt3620_Gpio_Write(21, true);  // DE (enable)
-                    Mt3620_Gpio_Write(23, true);  // RE_N (disable)
-                    Uart_WritePoll((const char*)msg->body.writeAndReadReq.writeData,
-                        msg->body.writeAndReadReq.writeLen);
-
-                    // receive response from the opposing device
-                    Mt3620_Gpio_Write(21, false);
-                    Mt3620_Gpio_Write(23, false);
+                if (Uart_ApplyLineParams(&msg->body.writeAndReadReq.line)
+                && msg->body.writeAndReadReq.readLen <= RX_BUFFER_SIZE) {
+                    uint16_t readLen, elapsedMs;
 
                     // send back the response to HLApp
-                    if (! Uart_ReadPoll(rxBuffer, msg->body.writeAndReadReq.readLen)) {
+                    // (shorter response is padded with 0)
+                    if (UART_SCAN_TIMEOUT == Uart_ExchangeFrame((const uint8_t*)msg->body.writeAndReadReq.writeData,
+                            msg->body.writeAndReadReq.writeLen,
+                            rxBuffer, msg->body.writeAndReadReq.readLen, TIMEOUT_US,
+                            &readLen, &elapsedMs)) {
                         memset(rxBuffer, 0, msg->body.writeAndReadReq.readLen);
                         if (InterCoreComm_SendReadData(rxBuffer, msg->body.writeAndReadReq.readLen)) {
  //                           int i = -1;
@@ -326,23 +926,60 @@ RTCoreMain(void)
  //                       int i = 1;
                     }
                 //
-                // NOTE: It should make time for equal of transmitting 3.5 characters 
-                //       according to Modbus RTU specification.
-                //       (in case of 9600bps, about 3[ms])
+                // NOTE: Time for transmitting 3.5 characters is kept
+                //       by Uart_WriteAndRead() according to Modbus RTU
+                //       specification. (in case of 9600bps, about 4[ms])
+                } else if (! InterCoreComm_SendError(UART_STATUS_FAILED)) {
+                    ;
+                }
+                break;
+            case UART_REQ_SCAN_LIST:
+                {
+                    uint16_t retLen = Uart_ScanList(&msg->body.scanListReq,
+                        Uart_ApplyLineParams(&msg->body.scanListReq.line));
+
+                    if (! InterCoreComm_SendReadData((uint8_t*)sScanRetBuf, retLen)) {
+                        ;
+                    }
                 }
                 break;
             case UART_REQ_SET_PARAMS:
                 // initialize UART with requested params, then send back the status code
                 // status code is
                 //   0: error, 1: OK
-                Uart_Init();
-                mtk_hdl_uart_set_params(msg->body.setParams.baudRate,
+                Uart_SetLineParams(msg->body.setParams.baudRate,
                     msg->body.setParams.parity, msg->body.setParams.stop);
-                initializeUart = true;
                 if (! InterCoreComm_SendIntValue(1)) {
 //                    int i = 0;
                 }
                 break;
+            case UART_REQ_POLL_CONFIG:
+                // store poll schedule, then send back the status code
+                //   0: error (too many entries), 1: OK
+                if (! InterCoreComm_SendIntValue(
+                        Poll_Configure(&msg->body.pollConfigReq) ? 1 : 0)) {
+                    ;
+                }
+                break;
+            case UART_REQ_POLL_FETCH:
+                {
+                    uint16_t retLen = Poll_Fetch();
+
+                    if (! InterCoreComm_SendReadData((uint8_t*)sPollRetBuf, retLen)) {
+                        ;
+                    }
+                }
+                break;
+            case UART_REQ_GET_STATS:
+                {
+                    uint16_t retLen = Stats_Prepare();
+
+                    if (! InterCoreComm_SendReadData((uint8_t*)&sStats, retLen)) {
+                        ;
+                    }
+                    Stats_Clear();
+                }
+                break;
             case UART_REQ_VERSION:
                 memset(retMsg.message.version, 0x00, sizeof(retMsg.message.version));
                 strncpy(retMsg.message.version, RTAPP_VERSION, strlen(RTAPP_VERSION) + 1);
@@ -353,8 +990,13 @@ RTCoreMain(void)
                 }
                 break;
             default:
+                if (! InterCoreComm_SendError(UART_STATUS_INVALID)) {
+                    ;
+                }
                 break;
             }
+        } else if (! InterCoreComm_SendError(UART_STATUS_INVALID)) {
+            ;  // unknown or broken request
         }
     }
 }